@@ -1,14 +1,23 @@
 using System;
 using System.Threading;
 using System.Collections;
+using System.Collections.Generic;
 using System.Runtime.InteropServices;
 
+using Mono.Debugger.Architectures;
+
 namespace Mono.Debugger.Backend
 {
 	internal class BreakpointManager : IDisposable
 	{
 		IntPtr _manager;
 		Hashtable index_hash;
+		Hashtable thread_groups;
+		Hashtable page_watches;
+		Hashtable page_protection;
+		TableReference table_ref;
+		List<PageProtection> pending_protection;
+		Process process;
 
 		[DllImport("monodebuggerserver")]
 		static extern IntPtr mono_debugger_breakpoint_manager_new ();
@@ -26,10 +35,40 @@ namespace Mono.Debugger.Backend
 		static extern IntPtr mono_debugger_breakpoint_manager_lookup_by_id (IntPtr manager, int id);
 
 		[DllImport("monodebuggerserver")]
-		static extern void mono_debugger_breakpoint_manager_lock ();
+		static extern bool mono_debugger_breakpoint_manager_set_threads (IntPtr manager, int id, int count, int[] threads);
+
+		[DllImport("monodebuggerserver")]
+		static extern bool mono_debugger_breakpoint_manager_set_actions (IntPtr manager, int id, byte[] actions, int size);
+
+		[DllImport("monodebuggerserver")]
+		static extern int mono_debugger_breakpoint_manager_read_trace_frames (IntPtr manager, byte[] buffer, int size);
+
+		[DllImport("monodebuggerserver")]
+		static extern void mono_debugger_breakpoint_manager_get_trace_status (IntPtr manager, out int frames, out int used, out int size, out int dropped);
+
+		[DllImport("monodebuggerserver")]
+		static extern int mono_debugger_breakpoint_manager_get_next_id ();
 
 		[DllImport("monodebuggerserver")]
-		static extern void mono_debugger_breakpoint_manager_unlock ();
+		static extern void mono_debugger_breakpoint_manager_insert_watch_range (IntPtr manager, int id, long start, int size, Inferior.HardwareBreakpointType type);
+
+		[DllImport("monodebuggerserver")]
+		static extern bool mono_debugger_breakpoint_manager_remove_watch_range (IntPtr manager, int id);
+
+		[DllImport("monodebuggerserver")]
+		static extern Inferior.HardwareBreakpointType mono_debugger_breakpoint_manager_get_watch_type (IntPtr manager, long start, long end);
+
+		[DllImport("monodebuggerserver")]
+		static extern void mono_debugger_breakpoint_manager_set_watch_suspended (IntPtr manager, bool suspended);
+
+		[DllImport("monodebuggerserver")]
+		static extern int mono_debugger_breakpoint_manager_get_page_size (IntPtr manager);
+
+		[DllImport("monodebuggerserver")]
+		static extern void mono_debugger_breakpoint_manager_lock (IntPtr manager);
+
+		[DllImport("monodebuggerserver")]
+		static extern void mono_debugger_breakpoint_manager_unlock (IntPtr manager);
 
 		[DllImport("monodebuggerserver")]
 		static extern int mono_debugger_breakpoint_info_get_id (IntPtr info);
@@ -37,35 +76,76 @@ namespace Mono.Debugger.Backend
 		[DllImport("monodebuggerserver")]
 		static extern bool mono_debugger_breakpoint_info_get_is_enabled (IntPtr info);
 
+		[DllImport("monodebuggerserver")]
+		static extern long mono_debugger_breakpoint_info_get_address (IntPtr info);
+
+		[DllImport("monodebuggerserver")]
+		static extern int mono_debugger_breakpoint_info_get_hit_count (IntPtr info);
+
+		[DllImport("monodebuggerserver")]
+		static extern int mono_debugger_breakpoint_info_get_ignore_count (IntPtr info);
+
 		public BreakpointManager ()
 		{
 			index_hash = new Hashtable ();
+			thread_groups = new Hashtable ();
+			page_watches = new Hashtable ();
+			page_protection = new Hashtable ();
+			table_ref = new TableReference ();
+			pending_protection = new List<PageProtection> ();
 			_manager = mono_debugger_breakpoint_manager_new ();
 		}
 
 		public BreakpointManager (BreakpointManager old)
 		{
-			Lock ();
+			old.Lock ();
 
-			index_hash = new Hashtable ();
+			index_hash = old.index_hash;
+			page_watches = old.page_watches;
+			page_protection = old.page_protection;
+			table_ref = old.table_ref;
+			Interlocked.Increment (ref table_ref.Count);
+
+			thread_groups = new Hashtable ();
+			pending_protection = new List<PageProtection> ();
 			_manager = mono_debugger_breakpoint_manager_clone (old.Manager);
 
-			foreach (int index in old.index_hash.Keys) {
-				BreakpointEntry entry = (BreakpointEntry) old.index_hash [index];
-				index_hash.Add (index, entry);
-			}
+			old.Unlock ();
+		}
+
+		//
+		// After a fork, the child shares `index_hash', `page_watches' and
+		// `page_protection' with its parent - just like the server shares the
+		// native breakpoint table - and only copies them when either of them
+		// inserts or removes a breakpoint.  Most children exec() right away, so
+		// they never need their own copy.
+		//
+		protected class TableReference
+		{
+			public int Count = 1;
+		}
+
+		void unshare ()
+		{
+			if (Thread.VolatileRead (ref table_ref.Count) == 1)
+				return;
 
-			Unlock ();
+			index_hash = (Hashtable) index_hash.Clone ();
+			page_watches = (Hashtable) page_watches.Clone ();
+			page_protection = (Hashtable) page_protection.Clone ();
+
+			Interlocked.Decrement (ref table_ref.Count);
+			table_ref = new TableReference ();
 		}
 
 		protected void Lock ()
 		{
-			mono_debugger_breakpoint_manager_lock ();
+			mono_debugger_breakpoint_manager_lock (_manager);
 		}
 
 		protected void Unlock ()
 		{
-			mono_debugger_breakpoint_manager_unlock ();
+			mono_debugger_breakpoint_manager_unlock (_manager);
 		}
 
 		internal IntPtr Manager {
@@ -111,6 +191,10 @@ namespace Mono.Debugger.Backend
 		{
 			Lock ();
 			try {
+				// The server doesn't have a BreakpointInfo for these.
+				if (page_watches.Contains (breakpoint))
+					return true;
+
 				IntPtr info = mono_debugger_breakpoint_manager_lookup_by_id (
 					_manager, breakpoint);
 				if (info == IntPtr.Zero)
@@ -122,6 +206,119 @@ namespace Mono.Debugger.Backend
 			}
 		}
 
+		//
+		// The server counts the breakpoint's hits itself, including the ones it
+		// ignored without reporting them to us.
+		//
+		public bool GetHitCount (int breakpoint, out int hit_count, out int ignore_count)
+		{
+			Lock ();
+			try {
+				IntPtr info = mono_debugger_breakpoint_manager_lookup_by_id (
+					_manager, breakpoint);
+				if (info == IntPtr.Zero) {
+					hit_count = ignore_count = 0;
+					return false;
+				}
+
+				hit_count = mono_debugger_breakpoint_info_get_hit_count (info);
+				ignore_count = mono_debugger_breakpoint_info_get_ignore_count (info);
+				return true;
+			} finally {
+				Unlock ();
+			}
+		}
+
+		//
+		// The number of hits of all of `bpt's locations.
+		//
+		public int GetHitCount (Breakpoint bpt)
+		{
+			Lock ();
+			try {
+				int total = 0;
+				foreach (int index in index_hash.Keys) {
+					BreakpointEntry entry = (BreakpointEntry) index_hash [index];
+					if (entry.Handle.Breakpoint != bpt)
+						continue;
+
+					int hit_count, ignore_count;
+					if (GetHitCount (index, out hit_count, out ignore_count))
+						total += hit_count;
+				}
+				return total;
+			} finally {
+				Unlock ();
+			}
+		}
+
+		//
+		// The number of hits the server still ignores, summed over all of `bpt's
+		// locations; each of them has its own hit count and ignore count.
+		//
+		public int GetIgnoreCount (Breakpoint bpt)
+		{
+			Lock ();
+			try {
+				int total = 0;
+				foreach (int index in index_hash.Keys) {
+					BreakpointEntry entry = (BreakpointEntry) index_hash [index];
+					if (entry.Handle.Breakpoint != bpt)
+						continue;
+
+					int hit_count, ignore_count;
+					if (GetHitCount (index, out hit_count, out ignore_count) &&
+					    (ignore_count > hit_count))
+						total += ignore_count - hit_count;
+				}
+				return total;
+			} finally {
+				Unlock ();
+			}
+		}
+
+		//
+		// Let the server ignore the next `count' hits of each of `bpt's locations.
+		// The trampoline is rewritten in place, so this is safe while other threads
+		// are running through it.
+		//
+		public void UpdateIgnoreCount (Inferior inferior, Breakpoint bpt, int count)
+		{
+			Lock ();
+			try {
+				foreach (int index in index_hash.Keys) {
+					BreakpointEntry entry = (BreakpointEntry) index_hash [index];
+					if ((entry.Handle.Breakpoint != bpt) ||
+					    (bpt.Type != EventType.Breakpoint))
+						continue;
+
+					IntPtr info = mono_debugger_breakpoint_manager_lookup_by_id (
+						_manager, index);
+					if (info == IntPtr.Zero)
+						continue;
+
+					TargetAddress address = new TargetAddress (
+						inferior.AddressDomain,
+						mono_debugger_breakpoint_info_get_address (info));
+					int ignore_count = mono_debugger_breakpoint_info_get_hit_count (info) + count;
+
+					try {
+						BreakpointCondition condition = bpt.Condition;
+						inferior.SetBreakpointCondition (
+							index, address,
+							condition != null ? condition.GetCode (inferior.Architecture) : null,
+							ignore_count);
+					} catch (TargetException ex) {
+						Report.Debug (DebugFlags.SSE,
+							      "Can't set ignore count on breakpoint {0} at {1}: {2}",
+							      index, address, ex.Message);
+					}
+				}
+			} finally {
+				Unlock ();
+			}
+		}
+
 		public int InsertBreakpoint (Inferior inferior, BreakpointHandle handle,
 					     TargetAddress address, int domain)
 		{
@@ -137,28 +334,22 @@ namespace Mono.Debugger.Backend
 						"Already have breakpoint {0} at address {1}.",
 						old.Breakpoint.Index, address);
 
-				int dr_index = -1;
 				switch (handle.Breakpoint.Type) {
 				case EventType.Breakpoint:
 					index = inferior.InsertBreakpoint (address);
+					set_condition (inferior, handle, index, address);
 					break;
 
 				case EventType.WatchRead:
-					index = inferior.InsertHardwareWatchPoint (
-						address, Inferior.HardwareBreakpointType.READ,
-						out dr_index);
-					break;
-
 				case EventType.WatchWrite:
-					index = inferior.InsertHardwareWatchPoint (
-						address, Inferior.HardwareBreakpointType.WRITE,
-						out dr_index);
+					index = insert_watch_point (inferior, handle, address);
 					break;
 
 				default:
 					throw new InternalError ();
 				}
 
+				unshare ();
 				index_hash.Add (index, new BreakpointEntry (handle, domain));
 				return index;
 			} finally {
@@ -166,6 +357,251 @@ namespace Mono.Debugger.Backend
 			}
 		}
 
+		//
+		// Insert several software breakpoints with a single call into the
+		// native server.
+		//
+		public int[] InsertBreakpoints (Inferior inferior, BreakpointHandle[] handles,
+						TargetAddress[] addresses, int domain)
+		{
+			Lock ();
+			try {
+				Hashtable seen = new Hashtable ();
+				for (int i = 0; i < handles.Length; i++) {
+					if (seen.Contains (addresses [i].Address))
+						throw new TargetException (
+							TargetError.AlreadyHaveBreakpoint,
+							"Already have breakpoint at address {0}.",
+							addresses [i]);
+					seen.Add (addresses [i].Address, i);
+
+					int index;
+					bool is_enabled;
+					BreakpointHandle old = LookupBreakpoint (
+						addresses [i], out index, out is_enabled);
+					if (old != null)
+						throw new TargetException (
+							TargetError.AlreadyHaveBreakpoint,
+							"Already have breakpoint {0} at address {1}.",
+							old.Breakpoint.Index, addresses [i]);
+					if (handles [i].Breakpoint.Type != EventType.Breakpoint)
+						throw new InternalError ();
+				}
+
+				int[] indices = inferior.InsertBreakpoints (addresses);
+				unshare ();
+				for (int i = 0; i < indices.Length; i++) {
+					set_condition (inferior, handles [i], indices [i], addresses [i]);
+					index_hash [indices [i]] = new BreakpointEntry (handles [i], domain);
+				}
+				return indices;
+			} finally {
+				Unlock ();
+			}
+		}
+
+		//
+		// Hand the breakpoint's thread filter, condition, ignore count and tracepoint
+		// actions to the server, so it can resume the target without a round-trip
+		// through us.  This is only an optimization; we still check them ourselves if
+		// the server can't do it.
+		//
+		void set_condition (Inferior inferior, BreakpointHandle handle,
+				    int index, TargetAddress address)
+		{
+			BreakpointCondition condition = handle.Breakpoint.Condition;
+			int ignore_count = handle.Breakpoint.IgnoreCount;
+			bool has_thread_filter = set_thread_filter (inferior, handle, index);
+			bool is_tracepoint = set_tracepoint_actions (inferior, handle, index);
+			if ((condition == null) && (ignore_count == 0) && !has_thread_filter &&
+			    !is_tracepoint)
+				return;
+
+			try {
+				inferior.SetBreakpointCondition (
+					index, address,
+					condition != null ? condition.GetCode (inferior.Architecture) : null,
+					ignore_count);
+			} catch (TargetException ex) {
+				Report.Debug (DebugFlags.SSE,
+					      "Can't set condition on breakpoint {0} at {1}: {2}",
+					      index, address, ex.Message);
+			}
+		}
+
+		bool set_tracepoint_actions (Inferior inferior, BreakpointHandle handle, int index)
+		{
+			Tracepoint tracepoint = handle.Breakpoint as Tracepoint;
+			if (tracepoint == null)
+				return false;
+
+			byte[] actions = tracepoint.GetActionCode (inferior.Architecture);
+			if (!mono_debugger_breakpoint_manager_set_actions (_manager, index, actions, actions.Length))
+				throw new InternalError ();
+			return true;
+		}
+
+		bool set_thread_filter (Inferior inferior, BreakpointHandle handle, int index)
+		{
+			ThreadGroup group = handle.Breakpoint.ThreadGroup;
+			if ((group == null) || group.IsSystem)
+				return false;
+
+			if (process == null)
+				process = inferior.Process;
+
+			if (!thread_groups.Contains (group)) {
+				group.ThreadsChangedEvent += thread_group_changed;
+				thread_groups.Add (group, true);
+			}
+
+			update_thread_filter (index, group);
+			return true;
+		}
+
+		void update_thread_filter (int index, ThreadGroup group)
+		{
+			ArrayList pids = new ArrayList ();
+			foreach (int id in group.Threads) {
+				SingleSteppingEngine engine = process.ThreadManager.GetEngine (id);
+				if (engine == null)
+					continue;
+				if (engine.PID <= 0) {
+					// Don't know its LWP yet, so let all threads stop there.
+					mono_debugger_breakpoint_manager_set_threads (_manager, index, 0, null);
+					return;
+				}
+				pids.Add (engine.PID);
+			}
+
+			mono_debugger_breakpoint_manager_set_threads (
+				_manager, index, pids.Count, (int[]) pids.ToArray (typeof (int)));
+		}
+
+		void thread_group_changed (ThreadGroup group)
+		{
+			lock (this) {
+				if (disposed)
+					return;
+
+				Lock ();
+				try {
+					foreach (int index in index_hash.Keys) {
+						BreakpointEntry entry = (BreakpointEntry) index_hash [index];
+						if (entry.Handle.Breakpoint.ThreadGroup == group)
+							update_thread_filter (index, group);
+					}
+				} finally {
+					Unlock ();
+				}
+			}
+		}
+
+		//
+		// Tracepoints
+		//
+
+		public TraceStatus GetTraceStatus ()
+		{
+			int frames, used, size, dropped;
+			mono_debugger_breakpoint_manager_get_trace_status (
+				_manager, out frames, out used, out size, out dropped);
+			return new TraceStatus (frames, used, size, dropped);
+		}
+
+		//
+		// Remove all frames from the server's trace buffer.  Must match the
+		// TraceFrameHeader and TracepointActionOpcode layouts in breakpoints.h.
+		//
+		public TraceFrame[] ReadTraceFrames (Architecture arch, AddressDomain domain)
+		{
+			List<TraceFrame> frames = new List<TraceFrame> ();
+
+			Lock ();
+			try {
+				TraceStatus status = GetTraceStatus ();
+				if (status.Frames == 0)
+					return frames.ToArray ();
+
+				byte[] buffer = new byte [status.Used];
+				int length = mono_debugger_breakpoint_manager_read_trace_frames (
+					_manager, buffer, buffer.Length);
+
+				int pos = 0;
+				while (pos < length) {
+					int size = BitConverter.ToInt32 (buffer, pos);
+					int id = BitConverter.ToInt32 (buffer, pos + 4);
+					int lwp = BitConverter.ToInt32 (buffer, pos + 8);
+
+					int tracepoint = -1;
+					if (index_hash.Contains (id))
+						tracepoint = ((BreakpointEntry) index_hash [id]).Handle.Breakpoint.Index;
+
+					frames.Add (read_trace_frame (
+						arch, domain, buffer, pos + 16, pos + size, tracepoint, lwp));
+					pos += size;
+				}
+			} finally {
+				Unlock ();
+			}
+
+			return frames.ToArray ();
+		}
+
+		static TraceFrame read_trace_frame (Architecture arch, AddressDomain domain,
+						    byte[] buffer, int pos, int end,
+						    int tracepoint, int lwp)
+		{
+			string[] names = null;
+			long[] registers = null;
+			List<TraceMemoryBlock> memory = new List<TraceMemoryBlock> ();
+
+			while (pos < end) {
+				byte opcode = buffer [pos++];
+
+				if (opcode == 1) {
+					int count = BitConverter.ToInt32 (buffer, pos);
+					pos += 4;
+
+					//
+					// Only keep the registers which actually exist on this
+					// architecture; the i386 backend still reserves slots
+					// for r8 - r15 in the register dump.
+					//
+					int known = Math.Min (count, arch.RegisterNames.Length);
+					List<string> name_list = new List<string> ();
+					List<long> value_list = new List<long> ();
+					for (int i = 0; i < known; i++) {
+						if ((arch.RegisterNames [i] == null) ||
+						    (arch.RegisterSizes [i] < 0))
+							continue;
+						name_list.Add (arch.RegisterNames [i]);
+						value_list.Add (BitConverter.ToInt64 (buffer, pos + i * 8));
+					}
+					names = name_list.ToArray ();
+					registers = value_list.ToArray ();
+					pos += count * 8;
+				} else if (opcode == 2) {
+					long address = BitConverter.ToInt64 (buffer, pos);
+					int size = BitConverter.ToInt32 (buffer, pos + 8);
+					pos += 12;
+
+					byte[] data = null;
+					if (size > 0) {
+						data = new byte [size];
+						Array.Copy (buffer, pos, data, 0, size);
+						pos += size;
+					}
+
+					memory.Add (new TraceMemoryBlock (
+						new TargetAddress (domain, address), data));
+				} else
+					throw new InternalError ();
+			}
+
+			return new TraceFrame (tracepoint, lwp, names, registers, memory.ToArray ());
+		}
+
 		public void RemoveBreakpoint (Inferior inferior, BreakpointHandle handle)
 		{
 			Lock ();
@@ -173,18 +609,376 @@ namespace Mono.Debugger.Backend
 				int[] indices = new int [index_hash.Count];
 				index_hash.Keys.CopyTo (indices, 0);
 
+				bool removed = false;
 				for (int i = 0; i < indices.Length; i++) {
 					BreakpointEntry entry = (BreakpointEntry) index_hash [indices [i]];
 					if (entry.Handle != handle)
 						continue;
-					inferior.RemoveBreakpoint (indices [i]);
+					remove_breakpoint (inferior, indices [i]);
+					unshare ();
 					index_hash.Remove (indices [i]);
+					removed = true;
 				}
+
+				if (removed)
+					inferior.FreeRetiredTrampolines ();
 			} finally {
 				Unlock ();
 			}
 		}
 
+		void remove_breakpoint (Inferior inferior, int index)
+		{
+			PageWatch watch = (PageWatch) page_watches [index];
+			if (watch == null) {
+				inferior.RemoveBreakpoint (index);
+				return;
+			}
+
+			unshare ();
+			page_watches.Remove (index);
+			mono_debugger_breakpoint_manager_remove_watch_range (_manager, index);
+			update_page_protection (inferior, watch.Start, watch.Size);
+			forget_page_protection (watch.Start, watch.Size);
+		}
+
+		//
+		// Page-protection watchpoints
+		//
+		// There are only four debug registers, so if we run out of them or the range
+		// is too large for one, we mprotect() the pages covering the watched range
+		// instead.  The server then reports each access to these pages with a
+		// CHILD_WATCH_FAULT and we re-execute it with the page unprotected.
+		//
+		// The mprotect() calls need to be done in the target, so we only compute them
+		// here and let the SingleSteppingEngine run them.
+		//
+
+		// Must match <sys/mman.h>.
+		const int PROT_READ = 1;
+		const int PROT_WRITE = 2;
+		const int PROT_EXEC = 4;
+
+		internal struct PageProtection
+		{
+			public readonly TargetAddress Start;
+			public readonly int Size;
+			public readonly int Protection;
+
+			public PageProtection (TargetAddress start, int size, int protection)
+			{
+				this.Start = start;
+				this.Size = size;
+				this.Protection = protection;
+			}
+
+			public override string ToString ()
+			{
+				return String.Format ("PageProtection ({0}:{1:x}:{2})", Start, Size, Protection);
+			}
+		}
+
+		protected class PageWatch
+		{
+			public readonly TargetAddress Start;
+			public readonly int Size;
+
+			public PageWatch (TargetAddress start, int size)
+			{
+				this.Start = start;
+				this.Size = size;
+			}
+		}
+
+		int insert_watch_point (Inferior inferior, BreakpointHandle handle, TargetAddress address)
+		{
+			Inferior.HardwareBreakpointType type = handle.Breakpoint.Type == EventType.WatchRead ?
+				Inferior.HardwareBreakpointType.READ : Inferior.HardwareBreakpointType.WRITE;
+
+			AddressBreakpoint abpt = handle.Breakpoint as AddressBreakpoint;
+			int size = abpt != null ? abpt.Size : 0;
+
+			// The server calls mprotect() via call_method_1(), which only passes the
+			// arguments in registers on x86_64.
+			bool can_protect = inferior.Architecture is Architecture_X86_64;
+
+			if (size == 0) {
+				try {
+					int dr_index;
+					int dr_id = inferior.InsertHardwareWatchPoint (address, type, out dr_index);
+					set_watch_filter (inferior, handle, dr_id);
+					return dr_id;
+				} catch (TargetException ex) {
+					// Only the server can compare the values.
+					if ((ex.Type != TargetError.DebugRegisterOccupied) || !can_protect ||
+					    ((abpt != null) && abpt.ChangesOnly))
+						throw;
+				}
+
+				size = inferior.TargetAddressSize;
+			} else if (!can_protect)
+				throw new TargetException (TargetError.NotImplemented,
+							   "Can't watch more than {0} bytes on this architecture.",
+							   inferior.TargetAddressSize);
+
+			// The server runs mprotect() on the faulting thread's stack, where it'd
+			// just fault again.
+			foreach (TargetMemoryArea area in inferior.GetThreadStackAreas ()) {
+				if ((address.Address < area.End.Address) &&
+				    (address.Address + size > area.Start.Address))
+					throw new TargetException (TargetError.NotImplemented,
+								   "Can't watch {0} on a thread's stack " +
+								   "without a debug register.", address);
+			}
+
+			unshare ();
+			record_page_protection (inferior, address, size);
+
+			int index = mono_debugger_breakpoint_manager_get_next_id ();
+			mono_debugger_breakpoint_manager_insert_watch_range (
+				_manager, index, address.Address, size, type);
+
+			try {
+				update_page_protection (inferior, address, size);
+			} catch {
+				mono_debugger_breakpoint_manager_remove_watch_range (_manager, index);
+				forget_page_protection (address, size);
+				throw;
+			}
+
+			page_watches.Add (index, new PageWatch (address, size));
+			return index;
+		}
+
+		//
+		// Let the server check whether the value changed and evaluate the condition,
+		// so rewriting a frequently written location with the same value doesn't
+		// stop the target.
+		//
+		void set_watch_filter (Inferior inferior, BreakpointHandle handle, int index)
+		{
+			AddressBreakpoint abpt = handle.Breakpoint as AddressBreakpoint;
+			BreakpointCondition condition = handle.Breakpoint.Condition;
+			bool changes_only = (abpt != null) && abpt.ChangesOnly;
+			if (!changes_only && (condition == null))
+				return;
+
+			bool ok;
+			try {
+				ok = inferior.SetWatchFilter (
+					index, changes_only ? inferior.TargetAddressSize : 0,
+					condition != null ? condition.GetCode (inferior.Architecture) : null);
+			} catch {
+				inferior.RemoveBreakpoint (index);
+				throw;
+			}
+
+			if (!ok && changes_only) {
+				inferior.RemoveBreakpoint (index);
+				throw new TargetException (TargetError.NotImplemented,
+							   "Can't watch for value changes on this target.");
+			}
+		}
+
+		//
+		// The target's own protection of the pages covering [start, start + size),
+		// taken from its memory maps.  Once we protected a page, the maps show our
+		// protection, so this must be done before the first watch on it is inserted.
+		//
+		// The cached maps are only refreshed on a miss, so they may not show an
+		// mprotect() the target did since; re-read them once for the new pages.
+		//
+		void record_page_protection (Inferior inferior, TargetAddress start, int size)
+		{
+			int page_size = mono_debugger_breakpoint_manager_get_page_size (_manager);
+			long first = start.Address & ~((long) page_size - 1);
+			long end = start.Address + size;
+
+			Hashtable protection = new Hashtable ();
+			for (long page = first; page < end; page += page_size) {
+				if (page_protection.Contains (page))
+					continue;
+
+				if (protection.Count == 0)
+					inferior.InvalidateMemoryMaps ();
+				protection.Add (page, read_protection (inferior, page));
+			}
+
+			foreach (DictionaryEntry entry in protection)
+				page_protection.Add (entry.Key, entry.Value);
+		}
+
+		//
+		// Forget the pages covering [start, start + size) which aren't watched anymore.
+		//
+		void forget_page_protection (TargetAddress start, int size)
+		{
+			int page_size = mono_debugger_breakpoint_manager_get_page_size (_manager);
+			long first = start.Address & ~((long) page_size - 1);
+			long end = start.Address + size;
+
+			for (long page = first; page < end; page += page_size) {
+				Inferior.HardwareBreakpointType type = mono_debugger_breakpoint_manager_get_watch_type (
+					_manager, page, page + page_size);
+				if (type == Inferior.HardwareBreakpointType.NONE)
+					page_protection.Remove (page);
+			}
+		}
+
+		int get_protection (Inferior inferior, long page)
+		{
+			if (page_protection.Contains (page))
+				return (int) page_protection [page];
+
+			return read_protection (inferior, page);
+		}
+
+		static int read_protection (Inferior inferior, long address)
+		{
+			TargetMemoryArea area = inferior.FindMemoryArea (
+				new TargetAddress (inferior.AddressDomain, address));
+			if (area == null) {
+				if (inferior.GetMemoryMaps () == null)
+					throw new TargetException (TargetError.NotImplemented,
+								   "Can't read the target's memory maps.");
+				throw new TargetException (TargetError.MemoryAccess,
+							   "Address {0:x} is not mapped.", address);
+			}
+
+			int prot = PROT_READ;
+			if ((area.Flags & TargetMemoryFlags.ReadOnly) == 0)
+				prot |= PROT_WRITE;
+			if ((area.Flags & TargetMemoryFlags.Executable) != 0)
+				prot |= PROT_EXEC;
+			return prot;
+		}
+
+		PageProtection get_page_protection (Inferior inferior, long page, int page_size)
+		{
+			int prot = get_protection (inferior, page);
+
+			switch (mono_debugger_breakpoint_manager_get_watch_type (_manager, page, page + page_size)) {
+			case Inferior.HardwareBreakpointType.READ:
+				prot = 0;
+				break;
+			case Inferior.HardwareBreakpointType.WRITE:
+				prot &= ~PROT_WRITE;
+				break;
+			}
+
+			return new PageProtection (
+				new TargetAddress (inferior.AddressDomain, page), page_size, prot);
+		}
+
+		//
+		// Recompute the protection of all pages covering [start, start + size) and
+		// queue the mprotect() calls, merging adjacent pages with the same protection.
+		//
+		void update_page_protection (Inferior inferior, TargetAddress start, int size)
+		{
+			int page_size = mono_debugger_breakpoint_manager_get_page_size (_manager);
+			long first = start.Address & ~((long) page_size - 1);
+			long end = start.Address + size;
+
+			PageProtection current = new PageProtection ();
+			for (long page = first; page < end; page += page_size) {
+				PageProtection prot = get_page_protection (inferior, page, page_size);
+
+				if ((current.Size > 0) && (current.Protection == prot.Protection) &&
+				    (current.Start.Address + current.Size == page)) {
+					current = new PageProtection (
+						current.Start, current.Size + page_size, current.Protection);
+					continue;
+				}
+
+				if (current.Size > 0)
+					pending_protection.Add (current);
+				current = prot;
+			}
+
+			if (current.Size > 0)
+				pending_protection.Add (current);
+		}
+
+		//
+		// Returns the queued mprotect() calls and clears the queue.
+		//
+		public PageProtection[] GetPageProtectionChanges ()
+		{
+			Lock ();
+			try {
+				PageProtection[] changes = pending_protection.ToArray ();
+				pending_protection.Clear ();
+				return changes;
+			} finally {
+				Unlock ();
+			}
+		}
+
+		//
+		// The target touched a protected page at `address'.  Returns the mprotect()
+		// calls to temporarily unprotect it, so the access can be re-executed, and to
+		// protect it again afterwards.
+		//
+		public void SuspendPageWatch (Inferior inferior, TargetAddress address,
+					      out PageProtection[] unprotect,
+					      out PageProtection[] protect)
+		{
+			Lock ();
+			try {
+				int page_size = mono_debugger_breakpoint_manager_get_page_size (_manager);
+				long page = address.Address & ~((long) page_size - 1);
+
+				List<PageProtection> before = new List<PageProtection> ();
+				List<PageProtection> after = new List<PageProtection> ();
+
+				// The access may continue on the next page.
+				for (int i = 0; i < 2; i++, page += page_size) {
+					if ((i > 0) && (mono_debugger_breakpoint_manager_get_watch_type (
+						_manager, page, page + page_size) == Inferior.HardwareBreakpointType.NONE))
+						break;
+
+					before.Add (new PageProtection (
+						new TargetAddress (inferior.AddressDomain, page), page_size,
+						get_protection (inferior, page)));
+					after.Add (get_page_protection (inferior, page, page_size));
+				}
+
+				unprotect = before.ToArray ();
+				protect = after.ToArray ();
+			} finally {
+				Unlock ();
+			}
+		}
+
+		//
+		// Whether the access at `address' which faulted on one of the protected
+		// pages is actually inside page watch `index'.
+		//
+		public bool IsPageWatchHit (int index, TargetAddress address)
+		{
+			Lock ();
+			try {
+				PageWatch watch = (PageWatch) page_watches [index];
+				if (watch == null)
+					return false;
+
+				return (address.Address >= watch.Start.Address) &&
+					(address.Address < watch.Start.Address + watch.Size);
+			} finally {
+				Unlock ();
+			}
+		}
+
+		//
+		// While we run mprotect() in the target, the server reports any SIGSEGV as a
+		// real one.
+		//
+		public void SetPageWatchSuspended (bool suspended)
+		{
+			mono_debugger_breakpoint_manager_set_watch_suspended (_manager, suspended);
+		}
+
 		public void InitializeAfterFork (Inferior inferior)
 		{
 			Lock ();
@@ -199,7 +993,7 @@ namespace Mono.Debugger.Backend
 
 					if (!entry.Handle.Breakpoint.ThreadGroup.IsGlobal) {
 						try {
-							inferior.RemoveBreakpoint (idx);
+							remove_breakpoint (inferior, idx);
 						} catch (Exception ex) {
 							Report.Error ("Removing breakpoint {0} failed: {1}",
 								      idx, ex);
@@ -218,9 +1012,11 @@ namespace Mono.Debugger.Backend
 				int[] indices = new int [index_hash.Count];
 				index_hash.Keys.CopyTo (indices, 0);
 
+				disable_breakpoints (inferior, indices);
+
 				for (int i = 0; i < indices.Length; i++) {
 					try {
-						inferior.RemoveBreakpoint (indices [i]);
+						remove_breakpoint (inferior, indices [i]);
 					} catch (Exception ex) {
 						Report.Error ("Removing breakpoint {0} failed: {1}",
 							      indices [i], ex);
@@ -231,6 +1027,48 @@ namespace Mono.Debugger.Backend
 			}
 		}
 
+		//
+		// Restore the original instructions of all these breakpoints with as few
+		// writes as possible; removing them afterwards doesn't touch the target.
+		//
+		void disable_breakpoints (Inferior inferior, int[] indices)
+		{
+			List<int> breakpoints = new List<int> ();
+			foreach (int index in indices) {
+				if (!page_watches.Contains (index))
+					breakpoints.Add (index);
+			}
+
+			try {
+				inferior.SetBreakpointsEnabled (breakpoints.ToArray (), false);
+			} catch (TargetException ex) {
+				Report.Debug (DebugFlags.SSE,
+					      "Can't disable breakpoints: {0}", ex.Message);
+			}
+		}
+
+		//
+		// Remove the page-protection watchpoints, but leave everything else alone;
+		// used when detaching, where the pages must be unprotected while we can still
+		// call mprotect() in the target.
+		//
+		public void RemovePageWatches (Inferior inferior)
+		{
+			Lock ();
+			try {
+				int[] indices = new int [page_watches.Count];
+				page_watches.Keys.CopyTo (indices, 0);
+
+				for (int i = 0; i < indices.Length; i++) {
+					remove_breakpoint (inferior, indices [i]);
+					unshare ();
+					index_hash.Remove (indices [i]);
+				}
+			} finally {
+				Unlock ();
+			}
+		}
+
 		public void DomainUnload (Inferior inferior, int domain)
 		{
 			Lock ();
@@ -242,7 +1080,8 @@ namespace Mono.Debugger.Backend
 					BreakpointEntry entry = (BreakpointEntry) index_hash [indices [i]];
 					if (entry.Domain != domain)
 						continue;
-					inferior.RemoveBreakpoint (indices [i]);
+					remove_breakpoint (inferior, indices [i]);
+					unshare ();
 					index_hash.Remove (indices [i]);
 				}
 			} finally {
@@ -274,6 +1113,12 @@ namespace Mono.Debugger.Backend
 
 				disposed = true;
 
+				foreach (ThreadGroup group in thread_groups.Keys)
+					group.ThreadsChangedEvent -= thread_group_changed;
+				thread_groups.Clear ();
+
+				Interlocked.Decrement (ref table_ref.Count);
+
 				mono_debugger_breakpoint_manager_free (_manager);
 				_manager = IntPtr.Zero;
 			}
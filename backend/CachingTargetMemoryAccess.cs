@@ -0,0 +1,381 @@
+using System;
+using System.Text;
+using ST = System.Threading;
+using System.Collections.Generic;
+
+namespace Mono.Debugger.Backend
+{
+	// <summary>
+	//   A TargetAccess which caches the target's memory page-wise while its
+	//   process is stopped and forwards everything else to the target it wraps.
+	// </summary>
+	// <remarks>
+	//   The language backends read lots of small, overlapping fields of the same
+	//   objects while formatting them; this serves them from one large read per
+	//   page.  The cache is flushed each time any target is resumed or memory is
+	//   modified, see Invalidate(); while any of the process' threads is running,
+	//   all reads go straight to the target.
+	// </remarks>
+	internal class CachingTargetMemoryAccess : TargetAccess
+	{
+		public const int PageSize = 4096;
+
+		// Larger reads bypass the cache.
+		const int MaxCachedRead = PageSize;
+		const int MaxPages = 256;
+
+		static int generation;
+
+		Inferior target;
+		Dictionary<long,byte[]> pages;
+		int cache_generation;
+
+		public CachingTargetMemoryAccess (Inferior target)
+		{
+			this.target = target;
+			this.pages = new Dictionary<long,byte[]> ();
+			this.cache_generation = generation;
+		}
+
+		public TargetMemoryAccess Target {
+			get { return target; }
+		}
+
+		// <summary>
+		//   Whether reads are cached right now.  Any of the process' threads
+		//   may write to the memory we cached, so this is only the case while
+		//   all of them are stopped.
+		// </summary>
+		public bool CanCache {
+			get { return target.Process.IsStopped; }
+		}
+
+		// <summary>
+		//   Flush all caches; called each time a target is resumed or its memory
+		//   is modified.
+		// </summary>
+		public static void Invalidate ()
+		{
+			ST.Interlocked.Increment (ref generation);
+		}
+
+		void check_generation ()
+		{
+			int current = ST.Thread.VolatileRead (ref generation);
+			if ((current != cache_generation) || (pages.Count >= MaxPages)) {
+				pages.Clear ();
+				cache_generation = current;
+			}
+		}
+
+		//
+		// Returns the cached page containing `address' or null if it can't be
+		// read in one piece; the caller then reads directly from the target.
+		//
+		byte[] get_page (long address, out int offset)
+		{
+			long start = address & ~((long) PageSize - 1);
+			offset = (int) (address - start);
+
+			if (!CanCache)
+				return null;
+
+			check_generation ();
+
+			byte[] page;
+			if (pages.TryGetValue (start, out page))
+				return page;
+
+			try {
+				page = target.ReadBuffer (new TargetAddress (AddressDomain, start), PageSize);
+			} catch (TargetException) {
+				page = null;
+			}
+
+			pages.Add (start, page);
+			return page;
+		}
+
+		//
+		// Returns the page and offset if the `size' bytes at `address' are
+		// cached in a single page.
+		//
+		byte[] find (TargetAddress address, int size, out int offset)
+		{
+			byte[] page = get_page (address.Address, out offset);
+			if ((page == null) || (offset + size > PageSize))
+				return null;
+			return page;
+		}
+
+		public override TargetMemoryInfo TargetMemoryInfo {
+			get { return target.TargetMemoryInfo; }
+		}
+
+		public override AddressDomain AddressDomain {
+			get { return target.AddressDomain; }
+		}
+
+		public override int TargetIntegerSize {
+			get { return target.TargetIntegerSize; }
+		}
+
+		public override int TargetLongIntegerSize {
+			get { return target.TargetLongIntegerSize; }
+		}
+
+		public override int TargetAddressSize {
+			get { return target.TargetAddressSize; }
+		}
+
+		public override bool IsBigEndian {
+			get { return target.IsBigEndian; }
+		}
+
+		public override byte ReadByte (TargetAddress address)
+		{
+			lock (pages) {
+				int offset;
+				byte[] page = find (address, 1, out offset);
+				if (page != null)
+					return page [offset];
+			}
+
+			return target.ReadByte (address);
+		}
+
+		public override int ReadInteger (TargetAddress address)
+		{
+			lock (pages) {
+				int offset;
+				byte[] page = find (address, 4, out offset);
+				if (page != null)
+					return BitConverter.ToInt32 (page, offset);
+			}
+
+			return target.ReadInteger (address);
+		}
+
+		public override long ReadLongInteger (TargetAddress address)
+		{
+			lock (pages) {
+				int offset;
+				byte[] page = find (address, 8, out offset);
+				if (page != null)
+					return BitConverter.ToInt64 (page, offset);
+			}
+
+			return target.ReadLongInteger (address);
+		}
+
+		public override TargetAddress ReadAddress (TargetAddress address)
+		{
+			long value;
+			switch (TargetAddressSize) {
+			case 4:
+				value = (uint) ReadInteger (address);
+				break;
+
+			case 8:
+				value = ReadLongInteger (address);
+				break;
+
+			default:
+				throw new TargetMemoryException (
+					"Unknown target address size " + TargetAddressSize);
+			}
+
+			if (value == 0)
+				return TargetAddress.Null;
+			else
+				return new TargetAddress (AddressDomain, value);
+		}
+
+		public override string ReadString (TargetAddress address)
+		{
+			return ReadString (address, Int32.MaxValue);
+		}
+
+		public override string ReadString (TargetAddress address, int max_length)
+		{
+			StringBuilder sb = new StringBuilder ();
+
+			lock (pages) {
+				TargetAddress current = address;
+				while (sb.Length < max_length) {
+					int offset;
+					byte[] page = get_page (current.Address, out offset);
+					if (page == null)
+						return target.ReadString (address, max_length);
+
+					int count = Math.Min (PageSize - offset, max_length - sb.Length);
+					int end = Array.IndexOf (page, (byte) 0, offset, count);
+					int length = end < 0 ? count : end - offset;
+
+					for (int i = 0; i < length; i++)
+						sb.Append ((char) page [offset + i]);
+
+					if (end >= 0)
+						break;
+
+					current += count;
+				}
+			}
+
+			return sb.ToString ();
+		}
+
+		public override TargetBlob ReadMemory (TargetAddress address, int size)
+		{
+			return new TargetBlob (ReadBuffer (address, size), TargetMemoryInfo);
+		}
+
+		public override byte[] ReadBuffer (TargetAddress address, int size)
+		{
+			if ((size == 0) || (size > MaxCachedRead))
+				return target.ReadBuffer (address, size);
+
+			byte[] buffer = new byte [size];
+
+			lock (pages) {
+				int pos = 0;
+				while (pos < size) {
+					int offset;
+					byte[] page = get_page (address.Address + pos, out offset);
+					if (page == null)
+						return target.ReadBuffer (address, size);
+
+					int count = Math.Min (PageSize - offset, size - pos);
+					Buffer.BlockCopy (page, offset, buffer, pos, count);
+					pos += count;
+				}
+			}
+
+			return buffer;
+		}
+
+		//
+		// Read all the pages covering these ranges which aren't cached yet
+		// with a single batched read.
+		//
+		public override void Prefetch (TargetAddress[] addresses, int[] sizes)
+		{
+			if (addresses.Length != sizes.Length)
+				throw new ArgumentException ();
+
+			if (!CanCache)
+				return;
+
+			lock (pages) {
+				check_generation ();
+
+				List<long> missing = new List<long> ();
+				for (int i = 0; i < addresses.Length; i++) {
+					if (addresses [i].IsNull || (sizes [i] <= 0))
+						continue;
+
+					long start = addresses [i].Address & ~((long) PageSize - 1);
+					long end = addresses [i].Address + sizes [i];
+
+					for (long page = start; page < end; page += PageSize) {
+						if (pages.Count + missing.Count >= MaxPages - 1)
+							break;
+						if (!pages.ContainsKey (page) && !missing.Contains (page))
+							missing.Add (page);
+					}
+				}
+
+				if (missing.Count == 0)
+					return;
+
+				TargetAddress[] starts = new TargetAddress [missing.Count];
+				int[] page_sizes = new int [missing.Count];
+				for (int i = 0; i < missing.Count; i++) {
+					starts [i] = new TargetAddress (AddressDomain, missing [i]);
+					page_sizes [i] = PageSize;
+				}
+
+				byte[][] data;
+				try {
+					data = target.ReadMemoryBatch (starts, page_sizes);
+				} catch (TargetException) {
+					// One of the pages can't be read; just read them on demand.
+					return;
+				}
+
+				for (int i = 0; i < missing.Count; i++)
+					pages.Add (missing [i], data [i]);
+			}
+		}
+
+		public override Registers GetRegisters ()
+		{
+			return target.GetRegisters ();
+		}
+
+		public override bool CanWrite {
+			get { return target.CanWrite; }
+		}
+
+		public override void WriteBuffer (TargetAddress address, byte[] buffer)
+		{
+			try {
+				target.WriteBuffer (address, buffer);
+			} finally {
+				Invalidate ();
+			}
+		}
+
+		public override void WriteByte (TargetAddress address, byte value)
+		{
+			try {
+				target.WriteByte (address, value);
+			} finally {
+				Invalidate ();
+			}
+		}
+
+		public override void WriteInteger (TargetAddress address, int value)
+		{
+			try {
+				target.WriteInteger (address, value);
+			} finally {
+				Invalidate ();
+			}
+		}
+
+		public override void WriteLongInteger (TargetAddress address, long value)
+		{
+			try {
+				target.WriteLongInteger (address, value);
+			} finally {
+				Invalidate ();
+			}
+		}
+
+		public override void WriteAddress (TargetAddress address, TargetAddress value)
+		{
+			try {
+				target.WriteAddress (address, value);
+			} finally {
+				Invalidate ();
+			}
+		}
+
+		public override void SetRegisters (Registers registers)
+		{
+			target.SetRegisters (registers);
+		}
+
+		internal override void InsertBreakpoint (BreakpointHandle breakpoint,
+							 TargetAddress address, int domain)
+		{
+			target.InsertBreakpoint (breakpoint, address, domain);
+		}
+
+		internal override void RemoveBreakpoint (BreakpointHandle handle)
+		{
+			target.RemoveBreakpoint (handle);
+		}
+	}
+}
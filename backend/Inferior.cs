@@ -7,10 +7,12 @@ using System.Globalization;
 using System.Reflection;
 using System.Diagnostics;
 using System.Collections;
+using System.Collections.Generic;
 using System.Collections.Specialized;
 using System.Runtime.InteropServices;
 
 using Mono.Debugger.Languages;
+using Mono.Debugger.Architectures;
 
 namespace Mono.Debugger.Backend
 {
@@ -39,6 +41,10 @@ namespace Mono.Debugger.Backend
 		TargetMemoryInfo target_info;
 		Architecture arch;
 
+		CachingTargetMemoryAccess cached_memory;
+		bool memory_cache_enabled;
+		bool memory_cache_suspended;
+
 		bool has_signals;
 		SignalInfo signal_info;
 
@@ -68,7 +74,7 @@ namespace Mono.Debugger.Backend
 		static extern TargetError mono_debugger_server_initialize_thread (IntPtr handle, int child_pid, bool wait);
 
 		[DllImport("monodebuggerserver")]
-		static extern TargetError mono_debugger_server_io_thread_main (IntPtr io_data, ChildOutputHandler output_handler);
+		static extern TargetError mono_debugger_server_io_thread_main (IntPtr io_data, ChildOutputHandler output_handler, int flush_latency, int tee_fd);
 		[DllImport("monodebuggerserver")]
 		static extern TargetError mono_debugger_server_spawn (IntPtr handle, string working_directory, string[] argv, string[] envp, bool redirect_fds, out int child_pid, out IntPtr io_data, out IntPtr error);
 
@@ -97,7 +103,28 @@ namespace Mono.Debugger.Backend
 		static extern TargetError mono_debugger_server_finalize (IntPtr handle);
 
 		[DllImport("monodebuggerserver")]
-		static extern TargetError mono_debugger_server_read_memory (IntPtr handle, long start, int size, IntPtr data);
+		static extern TargetError mono_debugger_server_read_memory (IntPtr handle, long start, int size, [Out] byte[] data);
+
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_read_memory (IntPtr handle, long start, int size, out byte data);
+
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_read_u32 (IntPtr handle, long start, out int value);
+
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_read_u64 (IntPtr handle, long start, out long value);
+
+		[DllImport("monodebuggerserver")]
+		static extern void mono_debugger_server_set_memory_cache (IntPtr handle, bool enabled);
+
+		[DllImport("monodebuggerserver")]
+		static extern void mono_debugger_server_suspend_memory_cache (IntPtr handle, bool suspended);
+
+		[DllImport("monodebuggerserver")]
+		static extern void mono_debugger_server_get_memory_cache_stats (IntPtr handle, out long hits, out long misses);
+
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_read_memory_vector (IntPtr handle, int count, long[] addresses, int[] sizes, [Out] byte[] data);
 
 		[DllImport("monodebuggerserver")]
 		static extern TargetError mono_debugger_server_write_memory (IntPtr handle, long start, int size, IntPtr data);
@@ -129,9 +156,15 @@ namespace Mono.Debugger.Backend
 		[DllImport("monodebuggerserver")]
 		static extern TargetError mono_debugger_server_execute_instruction (IntPtr handle, IntPtr instruction, int insn_size, bool update_ip);
 
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_execute_displaced_instruction (IntPtr handle, IntPtr instruction, int insn_size, int displacement_offset);
+
 		[DllImport("monodebuggerserver")]
 		static extern TargetError mono_debugger_server_insert_breakpoint (IntPtr handle, long address, out int breakpoint);
 
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_insert_breakpoints (IntPtr handle, int count, long[] addresses, int[] breakpoints);
+
 		[DllImport("monodebuggerserver")]
 		static extern TargetError mono_debugger_server_insert_hw_breakpoint (IntPtr handle, HardwareBreakpointType type, out int index, long address, out int breakpoint);
 
@@ -144,6 +177,18 @@ namespace Mono.Debugger.Backend
 		[DllImport("monodebuggerserver")]
 		static extern TargetError mono_debugger_server_disable_breakpoint (IntPtr handle, int breakpoint);
 
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_set_breakpoints_enabled (IntPtr handle, int count, int[] breakpoints, bool enabled);
+
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_set_breakpoint_condition (IntPtr handle, int breakpoint, byte[] condition, int condition_size, int ignore_count, byte[] instruction, int insn_size, int displacement_offset);
+
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_free_retired_trampolines (IntPtr handle, long[] ips, int count);
+
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_set_watch_filter (IntPtr handle, int breakpoint, int value_size, byte[] condition, int condition_size);
+
 		[DllImport("monodebuggerserver")]
 		static extern TargetError mono_debugger_server_get_registers (IntPtr handle, IntPtr values);
 
@@ -156,6 +201,12 @@ namespace Mono.Debugger.Backend
 		[DllImport("monodebuggerserver")]
 		static extern TargetError mono_debugger_server_stop_and_wait (IntPtr handle, out int status);
 
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_stop_all (IntPtr[] handles, int count, [Out] TargetError[] results, [Out] int[] status);
+
+		[DllImport("monodebuggerserver")]
+		static extern TargetError mono_debugger_server_set_stop_pending (IntPtr handle);
+
 		[DllImport("monodebuggerserver")]
 		static extern TargetError mono_debugger_server_set_signal (IntPtr handle, int signal, int send_it);
 
@@ -222,6 +273,8 @@ namespace Mono.Debugger.Backend
 			CHILD_INTERRUPTED,
 			RUNTIME_INVOKE_DONE,
 			INTERNAL_ERROR,
+			CHILD_RESUMED,
+			CHILD_WATCH_FAULT,
 
 			UNHANDLED_EXCEPTION	= 4001,
 			THROW_EXCEPTION,
@@ -245,7 +298,8 @@ namespace Mono.Debugger.Backend
 		internal enum ServerCapabilities {
 			NONE = 0,
 			THREAD_EVENTS = 1,
-			CAN_DETACH_ANY = 2
+			CAN_DETACH_ANY = 2,
+			NEW_THREAD_STOPS = 4
 		}
 
 		internal delegate void ChildEventHandler (ChildEventType message, int arg);
@@ -325,6 +379,9 @@ namespace Mono.Debugger.Backend
 			server_handle = mono_debugger_server_create_inferior (breakpoint_manager.Manager);
 			if (server_handle == IntPtr.Zero)
 				throw new InternalError ("mono_debugger_server_initialize() failed.");
+
+			if (process.Session.Config.MemoryCache)
+				SetMemoryCache (true);
 		}
 
 		public static Inferior CreateInferior (ThreadManager thread_manager,
@@ -442,6 +499,8 @@ namespace Mono.Debugger.Backend
 			else
 				blob = obj.Location.ReadBuffer (this, obj.Type.Size);
 
+			TargetState old_state = change_target_state (TargetState.Running);
+
 			IntPtr blob_data = IntPtr.Zero;
 			try {
 				if (blob != null) {
@@ -452,6 +511,9 @@ namespace Mono.Debugger.Backend
 				check_error (mono_debugger_server_call_method_3 (
 					server_handle, method.Address, method_argument,
 					address, blob != null ? blob.Length : 0, blob_data, callback_arg));
+			} catch {
+				change_target_state (old_state);
+				throw;
 			} finally {
 				if (blob_data != IntPtr.Zero)
 					Marshal.FreeHGlobal (blob_data);
@@ -501,6 +563,8 @@ namespace Mono.Debugger.Backend
 				blob_size += blobs [i].Length;
 			}
 
+			TargetState old_state = change_target_state (TargetState.Running);
+
 			IntPtr blob_data = IntPtr.Zero, param_data = IntPtr.Zero;
 			IntPtr offset_data = IntPtr.Zero;
 			try {
@@ -519,6 +583,9 @@ namespace Mono.Debugger.Backend
 					server_handle, invoke_method.Address, method_argument.Address,
 					length, blob_size, param_data, offset_data, blob_data,
 					callback_arg, debug));
+			} catch {
+				change_target_state (old_state);
+				throw;
 			} finally {
 				if (blob_data != IntPtr.Zero)
 					Marshal.FreeHGlobal (blob_data);
@@ -531,6 +598,8 @@ namespace Mono.Debugger.Backend
 		{
 			check_disposed ();
 
+			TargetState old_state = change_target_state (TargetState.Running);
+
 			IntPtr data = IntPtr.Zero;
 			try {
 				data = Marshal.AllocHGlobal (instruction.Length);
@@ -538,6 +607,42 @@ namespace Mono.Debugger.Backend
 
 				check_error (mono_debugger_server_execute_instruction (
 					server_handle, data, instruction.Length, update_ip));
+			} catch {
+				change_target_state (old_state);
+				throw;
+			} finally {
+				Marshal.FreeHGlobal (data);
+			}
+		}
+
+		//
+		// Single-step a relocated copy of the instruction at the current address
+		// without touching any other thread.  Returns false if the server can't
+		// relocate the instruction; the caller must then step it in place.
+		//
+		public bool ExecuteDisplacedInstruction (byte[] instruction, int displacement_offset)
+		{
+			check_disposed ();
+
+			TargetState old_state = change_target_state (TargetState.Running);
+
+			IntPtr data = IntPtr.Zero;
+			try {
+				data = Marshal.AllocHGlobal (instruction.Length);
+				Marshal.Copy (instruction, 0, data, instruction.Length);
+
+				TargetError result = mono_debugger_server_execute_displaced_instruction (
+					server_handle, data, instruction.Length, displacement_offset);
+				if (result == TargetError.NotImplemented) {
+					change_target_state (old_state);
+					return false;
+				}
+
+				check_error (result);
+				return true;
+			} catch {
+				change_target_state (old_state);
+				throw;
 			} finally {
 				Marshal.FreeHGlobal (data);
 			}
@@ -562,6 +667,25 @@ namespace Mono.Debugger.Backend
 			return retval;
 		}
 
+		public int[] InsertBreakpoints (TargetAddress[] addresses)
+		{
+			long[] starts = new long [addresses.Length];
+			for (int i = 0; i < addresses.Length; i++)
+				starts [i] = addresses [i].Address;
+
+			int[] retval = new int [addresses.Length];
+			TargetError result = mono_debugger_server_insert_breakpoints (
+				server_handle, addresses.Length, starts, retval);
+			if (result == TargetError.NotImplemented) {
+				for (int i = 0; i < addresses.Length; i++)
+					retval [i] = InsertBreakpoint (addresses [i]);
+				return retval;
+			}
+
+			check_error (result);
+			return retval;
+		}
+
 		public int InsertHardwareBreakpoint (TargetAddress address, bool fallback,
 						     out int index)
 		{
@@ -587,6 +711,35 @@ namespace Mono.Debugger.Backend
 				server_handle, breakpoint));
 		}
 
+		//
+		// The server keeps the trampolines of removed conditional breakpoints around
+		// since another thread may still be executing inside one; free them if none
+		// of the process' threads is.  If we can't read a thread's registers, we
+		// keep them until the next time.
+		//
+		internal void FreeRetiredTrampolines ()
+		{
+			check_disposed ();
+
+			List<long> ips = new List<long> ();
+			foreach (SingleSteppingEngine engine in process.Engines) {
+				Inferior inferior = engine.Inferior;
+				if (inferior == null)
+					continue;
+
+				StackFrame frame = inferior.GetCurrentFrame (true);
+				if (frame == null)
+					return;
+
+				ips.Add (frame.Address.Address);
+			}
+
+			TargetError result = mono_debugger_server_free_retired_trampolines (
+				server_handle, ips.ToArray (), ips.Count);
+			if (result != TargetError.NotImplemented)
+				check_error (result);
+		}
+
 		public int InsertHardwareWatchPoint (TargetAddress address,
 						     HardwareBreakpointType type,
 						     out int index)
@@ -609,6 +762,83 @@ namespace Mono.Debugger.Backend
 				server_handle, breakpoint));
 		}
 
+		public void SetBreakpointsEnabled (int[] breakpoints, bool enabled)
+		{
+			TargetError result = mono_debugger_server_set_breakpoints_enabled (
+				server_handle, breakpoints.Length, breakpoints, enabled);
+			if (result == TargetError.NotImplemented) {
+				foreach (int breakpoint in breakpoints) {
+					if (enabled)
+						EnableBreakpoint (breakpoint);
+					else
+						DisableBreakpoint (breakpoint);
+				}
+				return;
+			}
+
+			check_error (result);
+		}
+
+		//
+		// Let the server evaluate `condition' and count the hits itself when the
+		// breakpoint is hit, and transparently resume the target if the condition is
+		// false or the first `ignore_count' hits.  Returns false if the server can't
+		// resume the target for this breakpoint; it still keeps the hit count, but the
+		// caller must then check the condition and ignore count itself.
+		//
+		public bool SetBreakpointCondition (int breakpoint, TargetAddress address,
+						    byte[] condition, int ignore_count)
+		{
+			check_disposed ();
+
+			if (condition == null)
+				condition = new byte [0];
+
+			byte[] code = null;
+			int displacement_offset = -1;
+
+			Instruction instruction = Architecture.ReadInstruction (this, address);
+			if ((instruction != null) && instruction.HasInstructionSize &&
+			    ((instruction.InstructionType == Instruction.Type.Unknown) ||
+			     (instruction.InstructionType == Instruction.Type.Interpretable))) {
+				if (!instruction.IsIpRelative)
+					code = instruction.Code;
+				else if (instruction.CanDisplaceInstruction) {
+					code = instruction.Code;
+					displacement_offset = instruction.DisplacementOffset;
+				}
+			}
+
+			TargetError result = mono_debugger_server_set_breakpoint_condition (
+				server_handle, breakpoint, condition, condition.Length, ignore_count,
+				code, code != null ? code.Length : 0, displacement_offset);
+			if (result == TargetError.NotImplemented)
+				return false;
+
+			check_error (result);
+			return true;
+		}
+
+		//
+		// Let the server filter the hits of a hardware watchpoint without stopping
+		// the target: if `value_size' is non-zero, it only reports the watchpoint if
+		// that many bytes at its address changed and if there's a `condition', only
+		// if it's true after the access.  Returns false if the server can't do that.
+		//
+		public bool SetWatchFilter (int breakpoint, int value_size, byte[] condition)
+		{
+			if (condition == null)
+				condition = new byte [0];
+
+			TargetError result = mono_debugger_server_set_watch_filter (
+				server_handle, breakpoint, value_size, condition, condition.Length);
+			if (result == TargetError.NotImplemented)
+				return false;
+
+			check_error (result);
+			return true;
+		}
+
 		public void RestartNotification ()
 		{
 			check_error (mono_debugger_server_restart_notification (server_handle));
@@ -628,7 +858,25 @@ namespace Mono.Debugger.Backend
 
 		void io_thread_main ()
 		{
-			mono_debugger_server_io_thread_main (io_data, process.OnTargetOutput);
+			FileStream tee = null;
+			int tee_fd = -1;
+
+			if (start.OutputTeeFile != null) {
+				try {
+					tee = new FileStream (start.OutputTeeFile, FileMode.Append, FileAccess.Write);
+					tee_fd = (int) tee.SafeFileHandle.DangerousGetHandle ();
+				} catch (Exception ex) {
+					Report.Error ("Cannot open `{0}': {1}", start.OutputTeeFile, ex.Message);
+				}
+			}
+
+			try {
+				mono_debugger_server_io_thread_main (
+					io_data, process.OnTargetOutput, start.OutputFlushLatency, tee_fd);
+			} finally {
+				if (tee != null)
+					tee.Close ();
+			}
 		}
 
 		public int Run ()
@@ -757,6 +1005,7 @@ namespace Mono.Debugger.Backend
 			case ChildEventType.CHILD_STOPPED:
 			case ChildEventType.CHILD_INTERRUPTED:
 			case ChildEventType.CHILD_HIT_BREAKPOINT:
+			case ChildEventType.CHILD_WATCH_FAULT:
 			case ChildEventType.CHILD_NOTIFICATION:
 				change_target_state (TargetState.Stopped);
 				break;
@@ -854,6 +1103,52 @@ namespace Mono.Debugger.Backend
 			get { return breakpoint_manager; }
 		}
 
+		//
+		// Cache inferior memory page-wise in the native server; the cache is
+		// flushed each time any thread is resumed or memory is modified and
+		// it's only used while all threads of the process are stopped.
+		//
+		public void SetMemoryCache (bool enabled)
+		{
+			check_disposed ();
+			mono_debugger_server_set_memory_cache (server_handle, enabled);
+			memory_cache_enabled = enabled;
+			memory_cache_suspended = false;
+		}
+
+		void check_memory_cache ()
+		{
+			if (!memory_cache_enabled)
+				return;
+
+			bool suspended = !process.IsStopped;
+			if (suspended == memory_cache_suspended)
+				return;
+
+			mono_debugger_server_suspend_memory_cache (server_handle, suspended);
+			memory_cache_suspended = suspended;
+		}
+
+		public void GetMemoryCacheStats (out long hits, out long misses)
+		{
+			check_disposed ();
+			mono_debugger_server_get_memory_cache_stats (server_handle, out hits, out misses);
+		}
+
+		//
+		// Like the native cache, but on the managed side, so repeated small reads
+		// don't even need a call into the server.  This is what we hand out to
+		// the language backends while the target is stopped.
+		//
+		public TargetAccess CachedMemory {
+			get {
+				check_disposed ();
+				if (cached_memory == null)
+					cached_memory = new CachingTargetMemoryAccess (this);
+				return cached_memory;
+			}
+		}
+
 		public NativeExecutableReader Executable {
 			get { return exe; }
 		}
@@ -910,19 +1205,16 @@ namespace Mono.Debugger.Backend
 			}
 		}
 
-		IntPtr read_buffer (TargetAddress address, int size)
+		//
+		// The server reads directly into the (pinned) managed array or returns
+		// scalars by value, so we don't need an unmanaged buffer for each read.
+		//
+		void check_read (TargetError result, TargetAddress address, int size)
 		{
-			IntPtr data = Marshal.AllocHGlobal (size);
-			TargetError result = mono_debugger_server_read_memory (
-				server_handle, address.Address, size, data);
-			if (result == TargetError.MemoryAccess) {
-				Marshal.FreeHGlobal (data);
+			if (result == TargetError.MemoryAccess)
 				throw new TargetMemoryException (address, size);
-			} else if (result != TargetError.None) {
-				Marshal.FreeHGlobal (data);
+			else if (result != TargetError.None)
 				throw new TargetException (result);
-			}
-			return data;
 		}
 
 		public override byte[] ReadBuffer (TargetAddress address, int size)
@@ -930,51 +1222,81 @@ namespace Mono.Debugger.Backend
 			check_disposed ();
 			if (size == 0)
 				return new byte [0];
-			IntPtr data = IntPtr.Zero;
-			try {
-				data = read_buffer (address, size);
-				byte[] retval = new byte [size];
-				Marshal.Copy (data, retval, 0, size);
-				return retval;
-			} finally {
-				Marshal.FreeHGlobal (data);
+			check_memory_cache ();
+			byte[] retval = new byte [size];
+			check_read (mono_debugger_server_read_memory (
+				server_handle, address.Address, size, retval), address, size);
+			return retval;
+		}
+
+		public override byte[][] ReadMemoryBatch (TargetAddress[] addresses, int[] sizes)
+		{
+			check_disposed ();
+			if (addresses.Length != sizes.Length)
+				throw new ArgumentException ();
+
+			int count = addresses.Length;
+			long[] starts = new long [count];
+			int total_size = 0;
+			for (int i = 0; i < count; i++) {
+				starts [i] = addresses [i].Address;
+				total_size += sizes [i];
+			}
+
+			if (total_size == 0)
+				return base.ReadMemoryBatch (addresses, sizes);
+
+			byte[] data = new byte [total_size];
+			TargetError result = mono_debugger_server_read_memory_vector (
+				server_handle, count, starts, sizes, data);
+
+			//
+			// If one of the ranges can't be read, fall back to reading them
+			// one by one to throw the correct TargetMemoryException.
+			//
+			if ((result == TargetError.MemoryAccess) ||
+			    (result == TargetError.NotImplemented))
+				return base.ReadMemoryBatch (addresses, sizes);
+			check_error (result);
+
+			byte[][] retval = new byte [count][];
+			int offset = 0;
+			for (int i = 0; i < count; i++) {
+				retval [i] = new byte [sizes [i]];
+				Buffer.BlockCopy (data, offset, retval [i], 0, sizes [i]);
+				offset += sizes [i];
 			}
+			return retval;
 		}
 
 		public override byte ReadByte (TargetAddress address)
 		{
 			check_disposed ();
-			IntPtr data = IntPtr.Zero;
-			try {
-				data = read_buffer (address, 1);
-				return Marshal.ReadByte (data);
-			} finally {
-				Marshal.FreeHGlobal (data);
-			}
+			byte value;
+			check_memory_cache ();
+			check_read (mono_debugger_server_read_memory (
+				server_handle, address.Address, 1, out value), address, 1);
+			return value;
 		}
 
 		public override int ReadInteger (TargetAddress address)
 		{
 			check_disposed ();
-			IntPtr data = IntPtr.Zero;
-			try {
-				data = read_buffer (address, 4);
-				return Marshal.ReadInt32 (data);
-			} finally {
-				Marshal.FreeHGlobal (data);
-			}
+			int value;
+			check_memory_cache ();
+			check_read (mono_debugger_server_read_u32 (
+				server_handle, address.Address, out value), address, 4);
+			return value;
 		}
 
 		public override long ReadLongInteger (TargetAddress address)
 		{
 			check_disposed ();
-			IntPtr data = IntPtr.Zero;
-			try {
-				data = read_buffer (address, 8);
-				return Marshal.ReadInt64 (data);
-			} finally {
-				Marshal.FreeHGlobal (data);
-			}
+			long value;
+			check_memory_cache ();
+			check_read (mono_debugger_server_read_u64 (
+				server_handle, address.Address, out value), address, 8);
+			return value;
 		}
 
 		public override TargetAddress ReadAddress (TargetAddress address)
@@ -1002,19 +1324,39 @@ namespace Mono.Debugger.Backend
 		}
 
 		public override string ReadString (TargetAddress address)
+		{
+			return ReadString (address, Int32.MaxValue);
+		}
+
+		//
+		// Read the string in chunks which never cross a page boundary, so we don't
+		// fault on an unmapped page behind a string which ends right before it.
+		//
+		const int StringChunkSize = 4096;
+
+		public override string ReadString (TargetAddress address, int max_length)
 		{
 			check_disposed ();
 			StringBuilder sb = new StringBuilder ();
 
-			while (true) {
-				byte b = ReadByte (address);
-				address++;
+			while (sb.Length < max_length) {
+				int count = StringChunkSize - (int) (address.Address & (StringChunkSize - 1));
+				count = Math.Min (count, max_length - sb.Length);
+
+				byte[] buffer = ReadBuffer (address, count);
+				int end = Array.IndexOf (buffer, (byte) 0);
+				int length = end < 0 ? count : end;
 
-				if (b == 0)
-					return sb.ToString ();
+				for (int i = 0; i < length; i++)
+					sb.Append ((char) buffer [i]);
 
-				sb.Append ((char) b);
+				if (end >= 0)
+					break;
+
+				address += count;
 			}
+
+			return sb.ToString ();
 		}
 
 		public override TargetBlob ReadMemory (TargetAddress address, int size)
@@ -1116,14 +1458,111 @@ namespace Mono.Debugger.Backend
 		internal override void InsertBreakpoint (BreakpointHandle handle,
 							 TargetAddress address, int domain)
 		{
+			if ((breakpoint_batch != null) && (handle.Breakpoint.Type == EventType.Breakpoint)) {
+				breakpoint_batch.Add (new PendingBreakpoint (handle, address, domain));
+				return;
+			}
+
 			breakpoint_manager.InsertBreakpoint (this, handle, address, domain);
 		}
 
 		internal override void RemoveBreakpoint (BreakpointHandle handle)
 		{
+			if (breakpoint_batch != null) {
+				int count = breakpoint_batch.RemoveAll (delegate (PendingBreakpoint pending) {
+					return pending.Handle == handle;
+				});
+				if (count > 0)
+					return;
+			}
+
 			breakpoint_manager.RemoveBreakpoint (this, handle);
 		}
 
+		//
+		// Between BeginBreakpointBatch() and EndBreakpointBatch(), software
+		// breakpoints are queued and then inserted with a single call into the
+		// server, which patches all of them on the same page with one write.
+		// Since errors are only detected at the end, they're reported through
+		// Breakpoint.OnBreakpointError().
+		//
+		struct PendingBreakpoint
+		{
+			public readonly BreakpointHandle Handle;
+			public readonly TargetAddress Address;
+			public readonly int Domain;
+
+			public PendingBreakpoint (BreakpointHandle handle, TargetAddress address, int domain)
+			{
+				this.Handle = handle;
+				this.Address = address;
+				this.Domain = domain;
+			}
+		}
+
+		List<PendingBreakpoint> breakpoint_batch;
+		int breakpoint_batch_level;
+
+		public void BeginBreakpointBatch ()
+		{
+			if (breakpoint_batch_level++ == 0)
+				breakpoint_batch = new List<PendingBreakpoint> ();
+		}
+
+		public void EndBreakpointBatch ()
+		{
+			if (--breakpoint_batch_level > 0)
+				return;
+
+			List<PendingBreakpoint> batch = breakpoint_batch;
+			breakpoint_batch = null;
+
+			while (batch.Count > 0) {
+				int domain = batch [0].Domain;
+				List<PendingBreakpoint> group = batch.FindAll (delegate (PendingBreakpoint pending) {
+					return pending.Domain == domain;
+				});
+				batch.RemoveAll (delegate (PendingBreakpoint pending) {
+					return pending.Domain == domain;
+				});
+
+				insert_breakpoints (group, domain);
+			}
+		}
+
+		void insert_breakpoints (List<PendingBreakpoint> group, int domain)
+		{
+			BreakpointHandle[] handles = new BreakpointHandle [group.Count];
+			TargetAddress[] addresses = new TargetAddress [group.Count];
+			for (int i = 0; i < group.Count; i++) {
+				handles [i] = group [i].Handle;
+				addresses [i] = group [i].Address;
+			}
+
+			try {
+				breakpoint_manager.InsertBreakpoints (this, handles, addresses, domain);
+				return;
+			} catch (TargetException ex) {
+				Report.Debug (DebugFlags.SSE,
+					      "Can't insert breakpoint batch: {0}", ex.Message);
+			}
+
+			//
+			// Insert them one by one, so we know which of them failed.
+			//
+			foreach (PendingBreakpoint pending in group) {
+				try {
+					breakpoint_manager.InsertBreakpoint (
+						this, pending.Handle, pending.Address, domain);
+				} catch (TargetException ex) {
+					pending.Handle.Breakpoint.OnBreakpointError (
+						"Cannot insert breakpoint {0} at {1}: {2}",
+						pending.Handle.Breakpoint.Index, pending.Address,
+						ex.Message);
+				}
+			}
+		}
+
 		//
 		// IInferior
 		//
@@ -1138,6 +1577,13 @@ namespace Mono.Debugger.Backend
 			}
 		}
 
+		// <summary>
+		//   Whether the target is stopped, so its memory can't change behind our back.
+		// </summary>
+		public bool IsStopped {
+			get { return target_state == TargetState.Stopped; }
+		}
+
 		protected TargetState change_target_state (TargetState new_state)
 		{
 			return change_target_state (new_state, 0);
@@ -1151,6 +1597,14 @@ namespace Mono.Debugger.Backend
 			TargetState old_state = target_state;
 			target_state = new_state;
 
+			bool was_running = (old_state == TargetState.Running) || (old_state == TargetState.Busy);
+			bool running = (new_state == TargetState.Running) || (new_state == TargetState.Busy);
+			if (running != was_running)
+				process.OnInferiorStateChanged (running);
+
+			if (running)
+				CachingTargetMemoryAccess.Invalidate ();
+
 			if (StateChanged != null)
 				StateChanged (target_state, arg);
 
@@ -1206,6 +1660,16 @@ namespace Mono.Debugger.Backend
 		{
 			check_disposed ();
 			int status;
+
+			//
+			// The wait thread may already have reaped an event for us which the
+			// engine thread didn't process yet.
+			//
+			if (thread_manager.TakeQueuedEvent (child_pid, out status)) {
+				new_event = process_queued_event (status);
+				return true;
+			}
+
 			TargetError error = mono_debugger_server_stop_and_wait (server_handle, out status);
 			if (error != TargetError.None) {
 				new_event = null;
@@ -1219,6 +1683,74 @@ namespace Mono.Debugger.Backend
 			return true;
 		}
 
+		//
+		// We're stopping the target, so the server must report a queued event
+		// just like the stop we would have requested - for instance, a breakpoint
+		// whose condition is false must not just be continued.
+		//
+		ChildEvent process_queued_event (int status)
+		{
+			TargetError result = mono_debugger_server_set_stop_pending (server_handle);
+			if (result != TargetError.NotImplemented)
+				check_error (result);
+
+			return ProcessEvent (status);
+		}
+
+		// <summary>
+		//   Stop all the `inferiors' like Stop(out ChildEvent) does, but signal
+		//   all of them before waiting for any, so they stop in parallel.
+		// </summary>
+		public static void StopAll (Inferior[] inferiors, bool[] stopped, ChildEvent[] new_events)
+		{
+			List<int> indices = new List<int> ();
+
+			for (int i = 0; i < inferiors.Length; i++) {
+				inferiors [i].check_disposed ();
+
+				int status;
+				if (inferiors [i].thread_manager.TakeQueuedEvent (inferiors [i].child_pid, out status)) {
+					new_events [i] = inferiors [i].process_queued_event (status);
+					stopped [i] = true;
+				} else {
+					indices.Add (i);
+				}
+			}
+
+			if (indices.Count == 0)
+				return;
+
+			IntPtr[] handles = new IntPtr [indices.Count];
+			for (int i = 0; i < indices.Count; i++)
+				handles [i] = inferiors [indices [i]].server_handle;
+
+			TargetError[] results = new TargetError [indices.Count];
+			int[] statuses = new int [indices.Count];
+
+			TargetError result = mono_debugger_server_stop_all (
+				handles, handles.Length, results, statuses);
+			if (result == TargetError.NotImplemented) {
+				foreach (int i in indices)
+					stopped [i] = inferiors [i].Stop (out new_events [i]);
+				return;
+			}
+			check_error (result);
+
+			for (int i = 0; i < indices.Count; i++) {
+				int index = indices [i];
+				if (results [i] != TargetError.None) {
+					new_events [index] = null;
+					stopped [index] = false;
+				} else if (statuses [i] == 0) {
+					new_events [index] = null;
+					stopped [index] = true;
+				} else {
+					new_events [index] = inferiors [index].ProcessEvent (statuses [i]);
+					stopped [index] = true;
+				}
+			}
+		}
+
 		// <summary>
 		//   Just send the inferior a stop signal, but don't wait for it to stop.
 		//   Returns true if it actually sent the signal and false if the target
@@ -1541,7 +2073,72 @@ namespace Mono.Debugger.Backend
 			return GetCurrentFrame (false);
 		}
 
+		// <summary>
+		//   The memory areas containing the stack pointers of the process'
+		//   threads; threads whose registers we can't read are skipped.
+		// </summary>
+		internal TargetMemoryArea[] GetThreadStackAreas ()
+		{
+			List<TargetMemoryArea> areas = new List<TargetMemoryArea> ();
+			foreach (SingleSteppingEngine engine in process.Engines) {
+				Inferior inferior = engine.Inferior;
+				if (inferior == null)
+					continue;
+
+				StackFrame frame = inferior.GetCurrentFrame (true);
+				if (frame == null)
+					continue;
+
+				TargetMemoryArea area = FindMemoryArea (frame.StackPointer);
+				if ((area != null) && !areas.Contains (area))
+					areas.Add (area);
+			}
+
+			return areas.ToArray ();
+		}
+
+		// <summary>
+		//   Returns the process' memory maps from the MemoryMapIndex, re-reading
+		//   them only if they have been invalidated.  The array must not be
+		//   modified.
+		// </summary>
 		public TargetMemoryArea[] GetMemoryMaps ()
+		{
+			MemoryMapIndex index = process.MemoryMapIndex;
+			lock (index) {
+				if (!index.IsValid)
+					index.Update (read_memory_maps ());
+				return index.Areas;
+			}
+		}
+
+		// <summary>
+		//   Returns the memory area containing `address' or null if it's not
+		//   mapped.  If the address isn't in any of the cached areas, the target
+		//   may have mapped some new memory since we last looked, so we re-read
+		//   the maps once before giving up.
+		// </summary>
+		public TargetMemoryArea FindMemoryArea (TargetAddress address)
+		{
+			MemoryMapIndex index = process.MemoryMapIndex;
+			lock (index) {
+				if (index.IsValid) {
+					TargetMemoryArea area = index.Find (address.Address);
+					if (area != null)
+						return area;
+				}
+
+				index.Update (read_memory_maps ());
+				return index.Find (address.Address);
+			}
+		}
+
+		public void InvalidateMemoryMaps ()
+		{
+			process.MemoryMapIndex.Invalidate ();
+		}
+
+		TargetMemoryArea[] read_memory_maps ()
 		{
 			// We cannot use System.IO to read this file because it is not
 			// seekable.  Actually, the file is seekable, but it contains
@@ -1557,57 +2154,81 @@ namespace Mono.Debugger.Backend
 			if (contents == null)
 				return null;
 
-			ArrayList list = new ArrayList ();
-
-			using (StringReader reader = new StringReader (contents)) {
-				do {
-					string l = reader.ReadLine ();
-					if (l == null)
-						break;
+			List<TargetMemoryArea> list = new List<TargetMemoryArea> ();
+
+			//
+			// Each line looks like
+			//   start-end perms offset dev inode [name]
+			// and we parse it in place instead of splitting it into substrings.
+			//
+			int pos = 0;
+			while (pos < contents.Length) {
+				int eol = contents.IndexOf ('\n', pos);
+				if (eol < 0)
+					eol = contents.Length;
+
+				if (eol == pos) {
+					pos++;
+					continue;
+				}
 
-					bool is64bit;
-					if (l [8] == '-')
-						is64bit = false;
-					else if (l [16] == '-')
-						is64bit = true;
-					else
-						throw new InternalError ();
+				long start = parse_hex (contents, ref pos);
+				if (contents [pos++] != '-')
+					throw new InternalError ();
+				long end = parse_hex (contents, ref pos);
+				pos++;
+
+				TargetMemoryFlags flags = 0;
+				if (contents [pos + 1] != 'w')
+					flags |= TargetMemoryFlags.ReadOnly;
+				if (contents [pos + 2] == 'x')
+					flags |= TargetMemoryFlags.Executable;
+
+				// Skip the perms, offset, dev and inode fields.
+				for (int field = 0; field < 4; field++) {
+					while ((pos < eol) && (contents [pos] != ' '))
+						pos++;
+					while ((pos < eol) && (contents [pos] == ' '))
+						pos++;
+				}
 
-					string sstart = is64bit ? l.Substring (0,16) : l.Substring (0,8);
-					string send = is64bit ? l.Substring (17,16) : l.Substring (9,8);
-					string sflags = is64bit ? l.Substring (34,4) : l.Substring (18,4);
+				string name = null;
+				if (pos < eol)
+					name = contents.Substring (pos, eol - pos).TrimEnd (' ');
+				if (name == "")
+					name = null;
 
-					long start = Int64.Parse (sstart, NumberStyles.HexNumber);
-					long end = Int64.Parse (send, NumberStyles.HexNumber);
+				list.Add (new TargetMemoryArea (
+					new TargetAddress (AddressDomain, start),
+					new TargetAddress (AddressDomain, end),
+					flags, name));
 
-					string name;
-					if (is64bit)
-						name = (l.Length > 73) ? l.Substring (73) : "";
-					else
-						name = (l.Length > 49) ? l.Substring (49) : "";
-					name = name.TrimStart (' ').TrimEnd (' ');
-					if (name == "")
-						name = null;
+				pos = eol + 1;
+			}
 
-					TargetMemoryFlags flags = 0;
-					if (sflags [1] != 'w')
-						flags |= TargetMemoryFlags.ReadOnly;
+			return list.ToArray ();
+		}
 
-					TargetMemoryArea area = new TargetMemoryArea (
-						new TargetAddress (AddressDomain, start),
-						new TargetAddress (AddressDomain, end),
-						flags, name);
-					list.Add (area);
-				} while (true);
+		static long parse_hex (string s, ref int pos)
+		{
+			long value = 0;
+			for (; pos < s.Length; pos++) {
+				char c = s [pos];
+				if ((c >= '0') && (c <= '9'))
+					value = (value << 4) | (long) (c - '0');
+				else if ((c >= 'a') && (c <= 'f'))
+					value = (value << 4) | (long) (c - 'a' + 10);
+				else if ((c >= 'A') && (c <= 'F'))
+					value = (value << 4) | (long) (c - 'A' + 10);
+				else
+					break;
 			}
-
-			TargetMemoryArea[] maps = new TargetMemoryArea [list.Count];
-			list.CopyTo (maps, 0);
-			return maps;
+			return value;
 		}
 
 		protected virtual void OnMemoryChanged ()
 		{
+			CachingTargetMemoryAccess.Invalidate ();
 			// child_event (ChildEventType.CHILD_MEMORY_CHANGED, 0);
 		}
 
@@ -1651,6 +2272,15 @@ namespace Mono.Debugger.Backend
 			}
 		}
 
+		public int SIGSEGV {
+			get {
+				if (!has_signals || (signal_info.SIGSEGV < 0))
+					throw new InvalidOperationException ();
+
+				return signal_info.SIGSEGV;
+			}
+		}
+
 		public bool Has_SIGWINCH {
 			get { return has_signals && (signal_info.SIGWINCH > 0); }
 		}
@@ -1722,6 +2352,24 @@ namespace Mono.Debugger.Backend
 			}
 		}
 
+		//
+		// Whether the server keeps track of the "early" stopping events of new threads
+		// itself, so we never see them.
+		//
+		// Background:
+		//
+		// With PTRACE_SEIZE, the server can tell the initial stop of a new thread apart
+		// from a PTRACE_INTERRUPT; see _server_ptrace_wait_for_new_thread() in
+		// x86-linux-ptrace.c.
+		//
+
+		public static bool TracksNewThreadStops {
+			get {
+				ServerCapabilities capabilities = mono_debugger_server_get_capabilities ();
+				return (capabilities & ServerCapabilities.NEW_THREAD_STOPS) != 0;
+			}
+		}
+
 		public static OperatingSystemBackend CreateOperatingSystemBackend (Process process)
 		{
 			ServerType type = mono_debugger_server_get_server_type ();
@@ -1757,6 +2405,10 @@ namespace Mono.Debugger.Backend
 				// dispose all managed resources.
 				this.disposed = true;
 
+				if (disposing && ((target_state == TargetState.Running) ||
+						  (target_state == TargetState.Busy)))
+					process.OnInferiorStateChanged (false);
+
 				// Release unmanaged resources
 				lock (this) {
 					if (server_handle != IntPtr.Zero) {
@@ -0,0 +1,80 @@
+using System;
+using System.Collections.Generic;
+
+namespace Mono.Debugger.Backend
+{
+	// <summary>
+	//   A cached copy of a process' memory maps, sorted by start address so we
+	//   can find the area containing an address with a binary search.
+	// </summary>
+	// <remarks>
+	//   Reading and parsing /proc/<pid>/maps is expensive, so this is only
+	//   refreshed when the dynamic linker tells us that a library has been
+	//   loaded or unloaded, or when an address isn't in any of the known areas -
+	//   for instance because the target mmap()ed some new memory.
+	// </remarks>
+	internal class MemoryMapIndex
+	{
+		TargetMemoryArea[] areas;
+		bool valid;
+
+		public bool IsValid {
+			get { return valid; }
+		}
+
+		// <summary>
+		//   The areas, sorted by start address; must not be modified.
+		// </summary>
+		public TargetMemoryArea[] Areas {
+			get { return areas; }
+		}
+
+		public void Invalidate ()
+		{
+			lock (this) {
+				valid = false;
+			}
+		}
+
+		public void Update (TargetMemoryArea[] maps)
+		{
+			lock (this) {
+				if (maps != null) {
+					maps = (TargetMemoryArea[]) maps.Clone ();
+					Array.Sort (maps, delegate (TargetMemoryArea a, TargetMemoryArea b) {
+						return a.Start.Address.CompareTo (b.Start.Address);
+					});
+				}
+
+				areas = maps;
+				valid = true;
+			}
+		}
+
+		// <summary>
+		//   Returns the area containing `address' or null if it's not mapped.
+		// </summary>
+		public TargetMemoryArea Find (long address)
+		{
+			lock (this) {
+				if (areas == null)
+					return null;
+
+				int lo = 0, hi = areas.Length - 1;
+				while (lo <= hi) {
+					int mid = lo + (hi - lo) / 2;
+					TargetMemoryArea area = areas [mid];
+
+					if (address < area.Start.Address)
+						hi = mid - 1;
+					else if (address >= area.End.Address)
+						lo = mid + 1;
+					else
+						return area;
+				}
+
+				return null;
+			}
+		}
+	}
+}
@@ -17,6 +17,8 @@ namespace Mono.Debugger.Backend
 		string base_dir;
 		bool stop_in_main = true;
 		bool redirect_output = false;
+		int output_flush_latency;
+		string output_tee_file;
 		string[] argv;
 		string[] envp;
 		DebuggerOptions options;
@@ -80,6 +82,8 @@ namespace Mono.Debugger.Backend
 
 			stop_in_main = options.StopInMain;
 			redirect_output = session.Config.RedirectOutput;
+			output_flush_latency = session.Config.OutputFlushLatency;
+			output_tee_file = session.Config.OutputTeeFile;
 
 			cwd = options.WorkingDirectory;
 			if (cwd == null)
@@ -232,6 +236,14 @@ namespace Mono.Debugger.Backend
 			get { return redirect_output; }
 		}
 
+		public int OutputFlushLatency {
+			get { return output_flush_latency; }
+		}
+
+		public string OutputTeeFile {
+			get { return output_tee_file; }
+		}
+
 		void AddUserEnvironment (Hashtable hash)
 		{
 			if (options.UserEnvironment == null)
@@ -247,6 +247,18 @@ namespace Mono.Debugger.Backend
 				return true;
 			}
 
+			if (page_watch_fault != null) {
+				if (page_watch_fault.ProcessEvent (cevent, out cevent))
+					return true;
+				page_watch_fault = null;
+			}
+
+			if (page_protection_change != null) {
+				if (page_protection_change.ProcessEvent (cevent))
+					return true;
+				page_protection_change = null;
+			}
+
 			Inferior.ChildEventType message = cevent.Type;
 			int arg = (int) cevent.Argument;
 
@@ -485,6 +497,12 @@ namespace Mono.Debugger.Backend
 					do_continue ();
 					return;
 				}
+			} else if (message == Inferior.ChildEventType.CHILD_WATCH_FAULT) {
+				TargetAddress address = new TargetAddress (inferior.AddressDomain, cevent.Data1);
+				PageWatchFault fault = new PageWatchFault (this, arg, address);
+				fault.Start ();
+				page_watch_fault = fault;
+				return;
 			}
 
 			ProcessOperationEvent (cevent);
@@ -709,6 +727,8 @@ namespace Mono.Debugger.Backend
 			else
 				result = new TargetEventArgs (TargetEventType.TargetExited, arg);
 			temp_breakpoint = null;
+			page_watch_fault = null;
+			page_protection_change = null;
 			dead = true;
 
 			if (current_operation != null)
@@ -957,7 +977,18 @@ namespace Mono.Debugger.Backend
 		public override TargetMemoryArea[] GetMemoryMaps ()
 		{
 			check_inferior ();
-			return inferior.GetMemoryMaps ();
+
+			// The user asked for them, so re-read them and don't give out the
+			// cached array.
+			inferior.InvalidateMemoryMaps ();
+			TargetMemoryArea[] maps = inferior.GetMemoryMaps ();
+			return maps != null ? (TargetMemoryArea[]) maps.Clone () : null;
+		}
+
+		public override TargetMemoryArea FindMemoryArea (TargetAddress address)
+		{
+			check_inferior ();
+			return inferior.FindMemoryArea (address);
 		}
 
 		public override void Kill ()
@@ -985,12 +1016,24 @@ namespace Mono.Debugger.Backend
 		internal override object DoTargetAccess (TargetAccessHandler func)
 		{
 			return SendCommand (delegate {
-				return func (inferior);
+				return func (inferior.CachedMemory);
 			});
 		}
 
 		public override void Detach ()
 		{
+			// The pages we protected for watchpoints must get their original protection
+			// back while we can still call mprotect() in the target.
+			try {
+				SendCommand (delegate {
+					process.BreakpointManager.RemovePageWatches (inferior);
+					return null;
+				});
+				change_page_protection ();
+			} catch (Exception ex) {
+				Report.Error ("Restoring the page protection failed: {0}", ex);
+			}
+
 			SendCommand (delegate {
 				AcquireThreadLock ();
 
@@ -1095,16 +1138,43 @@ namespace Mono.Debugger.Backend
 			if (!bpt.Breaks (thread.ID) || !process.BreakpointManager.IsBreakpointEnabled (index))
 				return false;
 
+			int native_index = index;
 			index = bpt.Index;
 
 			bool remain_stopped;
 			if (bpt.BreakpointHandler (inferior, out remain_stopped))
 				return remain_stopped;
 
+			// The server only resumes the target by itself if it could set up a trampoline.
+			if ((bpt.Condition != null) && !evaluate_condition (bpt))
+				return false;
+
+			int hit_count, ignore_count;
+			if (process.BreakpointManager.GetHitCount (native_index, out hit_count, out ignore_count)) {
+				bpt.HitCount = hit_count;
+				if (hit_count <= ignore_count)
+					return false;
+			}
+
 			TargetAddress address = inferior.CurrentFrame;
 			return bpt.CheckBreakpointHit (thread, address);
 		}
 
+		//
+		// Like the server, stop if we can't evaluate the condition.
+		//
+		bool evaluate_condition (Breakpoint bpt)
+		{
+			try {
+				return bpt.Condition.Evaluate (inferior);
+			} catch (TargetException ex) {
+				Report.Debug (DebugFlags.SSE,
+					      "{0} can't evaluate condition of breakpoint {1}: {2}",
+					      this, bpt.Index, ex.Message);
+				return true;
+			}
+		}
+
 		bool step_over_breakpoint (bool singlestep, TargetAddress until)
 		{
 			int index;
@@ -1138,7 +1208,10 @@ namespace Mono.Debugger.Backend
 			}
 
 			if (instruction.IsIpRelative) {
-				PushOperation (new OperationStepOverBreakpoint (this, index, until));
+				if (instruction.CanDisplaceInstruction)
+					PushOperation (new OperationDisplacedStep (this, index, instruction, until));
+				else
+					PushOperation (new OperationStepOverBreakpoint (this, index, until));
 				return true;
 			}
 
@@ -1419,6 +1492,8 @@ namespace Mono.Debugger.Backend
 		}
 
 		TemporaryBreakpointData temp_breakpoint = null;
+		PageWatchFault page_watch_fault = null;
+		PageProtectionChange page_protection_change = null;
 
 		void insert_temporary_breakpoint (TargetAddress address)
 		{
@@ -1490,6 +1565,9 @@ namespace Mono.Debugger.Backend
 			check_inferior ();
 			frames_invalid ();
 
+			if (change_page_protection (delegate { do_continue (until); }))
+				return;
+
 			if (step_over_breakpoint (false, until))
 				return;
 
@@ -1500,6 +1578,9 @@ namespace Mono.Debugger.Backend
 
 		void do_step_native ()
 		{
+			if (change_page_protection (do_step_native))
+				return;
+
 			if (step_over_breakpoint (true, TargetAddress.Null))
 				return;
 
@@ -1508,6 +1589,9 @@ namespace Mono.Debugger.Backend
 
 		void do_step ()
 		{
+			if (change_page_protection (do_step))
+				return;
+
 			if (step_over_breakpoint (true, TargetAddress.Null))
 				return;
 
@@ -1683,6 +1767,47 @@ namespace Mono.Debugger.Backend
 
 			Inferior.ChildEvent stop_event;
 			bool stopped = inferior.Stop (out stop_event);
+			acquired_thread_lock (stopped, stop_event);
+		}
+
+		// <summary>
+		//   Like AcquireThreadLock(), but for several threads at once: all of them
+		//   are sent their stop signal before we wait for the first one.
+		// </summary>
+		internal static void AcquireThreadLocks (SingleSteppingEngine[] engines)
+		{
+			List<SingleSteppingEngine> running = new List<SingleSteppingEngine> ();
+
+			foreach (SingleSteppingEngine engine in engines) {
+				if (engine.HasThreadLock)
+					throw new InternalError ("Recursive thread lock");
+
+				Report.Debug (DebugFlags.Threads,
+					      "{0} acquiring thread lock: {1} {2}",
+					      engine, engine.engine_stopped, engine.current_operation);
+
+				if (!engine.engine_stopped)
+					running.Add (engine);
+			}
+
+			if (running.Count == 0)
+				return;
+
+			Inferior[] inferiors = new Inferior [running.Count];
+			for (int i = 0; i < running.Count; i++)
+				inferiors [i] = running [i].inferior;
+
+			bool[] stopped = new bool [running.Count];
+			Inferior.ChildEvent[] stop_events = new Inferior.ChildEvent [running.Count];
+
+			Inferior.StopAll (inferiors, stopped, stop_events);
+
+			for (int i = 0; i < running.Count; i++)
+				running [i].acquired_thread_lock (stopped [i], stop_events [i]);
+		}
+
+		void acquired_thread_lock (bool stopped, Inferior.ChildEvent stop_event)
+		{
 			thread_lock = new ThreadLockData (stopped, stop_event, true);
 
 			Report.Debug (DebugFlags.Threads,
@@ -2166,6 +2291,7 @@ namespace Mono.Debugger.Backend
 					inferior, handle, address, domain);
 				return null;
 			});
+			change_page_protection ();
 		}
 
 		internal override void RemoveBreakpoint (BreakpointHandle handle)
@@ -2174,6 +2300,63 @@ namespace Mono.Debugger.Backend
 				process.BreakpointManager.RemoveBreakpoint (inferior, handle);
 				return null;
 			});
+			change_page_protection ();
+		}
+
+		//
+		// Breakpoints may also be inserted and removed on the engine thread, for
+		// instance after a fork or when an appdomain is unloaded; run the mprotect()
+		// calls for these before resuming the target and call `resume' when done.
+		// Returns false if there's nothing to do.
+		//
+		bool change_page_protection (PageProtectionChange.ResumeHandler resume)
+		{
+			if (page_protection_change != null)
+				throw new InternalError ();
+
+			BreakpointManager.PageProtection[] changes =
+				process.BreakpointManager.GetPageProtectionChanges ();
+			if (changes.Length == 0)
+				return false;
+
+			page_protection_change = new PageProtectionChange (this, changes, resume);
+			try {
+				page_protection_change.Start ();
+			} catch {
+				page_protection_change = null;
+				throw;
+			}
+			return true;
+		}
+
+		internal override void UpdateIgnoreCount (Breakpoint breakpoint, int count)
+		{
+			SendCommand (delegate {
+				process.BreakpointManager.UpdateIgnoreCount (inferior, breakpoint, count);
+				return null;
+			});
+		}
+
+		//
+		// Run the mprotect() calls for page-protection watchpoints which have been
+		// queued by the BreakpointManager.
+		//
+		void change_page_protection ()
+		{
+			if (ThreadManager.InBackgroundThread)
+				return;
+
+			BreakpointManager.PageProtection[] changes =
+				process.BreakpointManager.GetPageProtectionChanges ();
+			if (changes.Length == 0)
+				return;
+
+			CommandResult result = StartOperation (
+				new OperationChangePageProtection (this, changes));
+			result.Wait ();
+
+			if (result.Result is Exception)
+				throw (Exception) result.Result;
 		}
 
 		public override int GetInstructionSize (TargetAddress address)
@@ -2245,6 +2428,13 @@ namespace Mono.Debugger.Backend
 			});
 		}
 
+		public override string ReadString (TargetAddress address, int max_length)
+		{
+			return (string) SendCommand (delegate {
+				return inferior.ReadString (address, max_length);
+			});
+		}
+
 		internal override Inferior.CallbackFrame GetCallbackFrame (TargetAddress stack_pointer,
 									   bool exact_match)
 		{
@@ -2677,6 +2867,265 @@ namespace Mono.Debugger.Backend
 				return String.Format ("ThreadLock ({0}:{1}:{2})", Stopped, StopEvent, PushedRegisters);
 			}
 		}
+
+		//
+		// The target touched a page which we protected for a page-protection
+		// watchpoint.  Re-execute the access with the page unprotected while all
+		// other threads are stopped and protect it again.  This runs beneath the
+		// current operation, which only sees the single-step - or a breakpoint hit
+		// if the access was inside the watched range.
+		//
+		// If the instruction also touches another protected page, like `movs' does,
+		// the step faults again; we then unprotect that page as well and retry.
+		//
+		protected sealed class PageWatchFault
+		{
+			enum State {
+				Unprotect,
+				Step,
+				Protect
+			}
+
+			readonly SingleSteppingEngine sse;
+			readonly BreakpointManager bpm;
+			BreakpointManager.PageProtection[] changes;
+			List<BreakpointManager.PageProtection> protect;
+			List<long> unprotected;
+			Inferior.ChildEvent step_event;
+			TargetAddress mprotect;
+			TargetAddress address;
+			State state;
+			int index;
+			int pos;
+
+			// Negative, so they can't clash with the OperationCallback IDs.
+			static long next_id = 0;
+			readonly long id = --next_id;
+
+			public PageWatchFault (SingleSteppingEngine sse, int index, TargetAddress address)
+			{
+				this.sse = sse;
+				this.bpm = sse.process.BreakpointManager;
+				this.index = index;
+				this.address = address;
+
+				protect = new List<BreakpointManager.PageProtection> ();
+				unprotected = new List<long> ();
+			}
+
+			public void Start ()
+			{
+				mprotect = sse.process.OperatingSystem.LookupSymbol ("mprotect");
+				if (mprotect.IsNull)
+					throw new TargetException (TargetError.SymbolTable,
+								   "Can't find mprotect() in the target.");
+
+				sse.process.AcquireGlobalThreadLock (sse);
+				try {
+					unprotect (address);
+				} catch {
+					done ();
+					throw;
+				}
+			}
+
+			//
+			// Start unprotecting the page(s) touched at `fault'; returns false if
+			// we already did that, so this must be a real fault.
+			//
+			bool unprotect (TargetAddress fault)
+			{
+				BreakpointManager.PageProtection[] before, after;
+				bpm.SuspendPageWatch (sse.inferior, fault, out before, out after);
+
+				if (unprotected.Contains (before [0].Start.Address))
+					return false;
+
+				foreach (BreakpointManager.PageProtection change in before)
+					unprotected.Add (change.Start.Address);
+				protect.AddRange (after);
+
+				state = State.Unprotect;
+				changes = before;
+				pos = 0;
+
+				bpm.SetPageWatchSuspended (true);
+				call_mprotect ();
+				return true;
+			}
+
+			void call_mprotect ()
+			{
+				BreakpointManager.PageProtection change = changes [pos];
+
+				Report.Debug (DebugFlags.SSE, "{0} change page protection: {1}", sse, change);
+
+				sse.inferior.CallMethod (mprotect, change.Start.Address, change.Size,
+							 change.Protection, "", id);
+			}
+
+			void done ()
+			{
+				bpm.SetPageWatchSuspended (false);
+				sse.process.ReleaseGlobalThreadLock (sse);
+			}
+
+			// <summary>
+			//   Returns false when we're done; `result' is the event which is to be
+			//   processed in place of the original watch fault.
+			// </summary>
+			public bool ProcessEvent (Inferior.ChildEvent cevent, out Inferior.ChildEvent result)
+			{
+				Report.Debug (DebugFlags.SSE, "{0} page watch fault at {1} ({2}:{3}): {4}",
+					      sse, address, index, state, cevent);
+
+				result = cevent;
+
+				if (sse.dead) {
+					done ();
+					return false;
+				}
+
+				if (state == State.Step) {
+					if (cevent.Type == Inferior.ChildEventType.CHILD_WATCH_FAULT) {
+						TargetAddress fault = new TargetAddress (
+							sse.inferior.AddressDomain, cevent.Data1);
+						if ((index == 0) && (cevent.Argument != 0)) {
+							index = (int) cevent.Argument;
+							address = fault;
+						}
+
+						if (unprotect (fault))
+							return true;
+
+						// Deliver it like any other SIGSEGV.
+						Report.Error ("{0} faulted at {1} with the page unprotected",
+							      sse, fault);
+						sse.inferior.SetSignal (sse.inferior.SIGSEGV, false);
+						cevent = new Inferior.ChildEvent (
+							Inferior.ChildEventType.CHILD_STOPPED,
+							sse.inferior.SIGSEGV, 0, 0);
+					}
+
+					step_event = cevent;
+					state = State.Protect;
+					changes = protect.ToArray ();
+					pos = 0;
+					bpm.SetPageWatchSuspended (true);
+					call_mprotect ();
+					return true;
+				}
+
+				if ((cevent.Type != Inferior.ChildEventType.CHILD_CALLBACK) ||
+				    (cevent.Argument != id)) {
+					Report.Error ("{0} got unexpected event while changing page " +
+						      "protection: {1}", sse, cevent);
+					done ();
+					return false;
+				}
+
+				if ((int) cevent.Data1 != 0)
+					Report.Error ("{0} can't change page protection: {1}", sse, changes [pos]);
+
+				if (++pos < changes.Length) {
+					call_mprotect ();
+					return true;
+				}
+
+				if (state == State.Unprotect) {
+					bpm.SetPageWatchSuspended (false);
+					state = State.Step;
+					sse.inferior.Step ();
+					return true;
+				}
+
+				done ();
+
+				if ((index != 0) && (step_event.Type == Inferior.ChildEventType.CHILD_STOPPED) &&
+				    (step_event.Argument == 0) && bpm.IsPageWatchHit (index, address))
+					result = new Inferior.ChildEvent (
+						Inferior.ChildEventType.CHILD_HIT_BREAKPOINT, index, 0, 0);
+				else
+					result = step_event;
+				return false;
+			}
+		}
+
+		//
+		// Like OperationChangePageProtection, but runs in the middle of whatever the
+		// engine is currently doing and then calls `resume'.
+		//
+		protected sealed class PageProtectionChange
+		{
+			public delegate void ResumeHandler ();
+
+			readonly SingleSteppingEngine sse;
+			readonly BreakpointManager.PageProtection[] changes;
+			readonly ResumeHandler resume;
+			TargetAddress mprotect;
+			int pos;
+
+			// Negative, so they can't clash with the OperationCallback IDs.
+			static long next_id = 0;
+			readonly long id = --next_id;
+
+			public PageProtectionChange (SingleSteppingEngine sse,
+						     BreakpointManager.PageProtection[] changes,
+						     ResumeHandler resume)
+			{
+				this.sse = sse;
+				this.changes = changes;
+				this.resume = resume;
+			}
+
+			public void Start ()
+			{
+				mprotect = sse.process.OperatingSystem.LookupSymbol ("mprotect");
+				if (mprotect.IsNull)
+					throw new TargetException (TargetError.SymbolTable,
+								   "Can't find mprotect() in the target.");
+
+				call_mprotect ();
+			}
+
+			void call_mprotect ()
+			{
+				BreakpointManager.PageProtection change = changes [pos];
+
+				Report.Debug (DebugFlags.SSE, "{0} change page protection: {1}", sse, change);
+
+				sse.inferior.CallMethod (mprotect, change.Start.Address, change.Size,
+							 change.Protection, "", id);
+			}
+
+			// <summary>
+			//   Returns false if `cevent' isn't ours and is to be processed as usual.
+			// </summary>
+			public bool ProcessEvent (Inferior.ChildEvent cevent)
+			{
+				if (sse.dead)
+					return false;
+
+				if ((cevent.Type != Inferior.ChildEventType.CHILD_CALLBACK) ||
+				    (cevent.Argument != id)) {
+					Report.Error ("{0} got unexpected event while changing page " +
+						      "protection: {1}", sse, cevent);
+					return false;
+				}
+
+				if ((int) cevent.Data1 != 0)
+					Report.Error ("{0} can't change page protection: {1}", sse, changes [pos]);
+
+				if (++pos < changes.Length) {
+					call_mprotect ();
+					return true;
+				}
+
+				sse.page_protection_change = null;
+				resume ();
+				return true;
+			}
+		}
 #endregion
 
 #region SSE Operations
@@ -3119,7 +3568,17 @@ namespace Mono.Debugger.Backend
 
 			Report.Debug (DebugFlags.SSE, "{0} insert breakpoint done: {1}", sse, info);
 
-			sse.Process.MonoLanguage.RegisterMethodLoadHandler (inferior, info, Handle.Index, Handle.MethodLoaded);
+			//
+			// A generic method may have been compiled several times already;
+			// insert all these breakpoints with a single call into the server.
+			//
+			inferior.BeginBreakpointBatch ();
+			try {
+				sse.Process.MonoLanguage.RegisterMethodLoadHandler (
+					inferior, info, Handle.Index, Handle.MethodLoaded);
+			} finally {
+				inferior.EndBreakpointBatch ();
+			}
 
 			Handle.Breakpoint.OnBreakpointBound ();
 			args = null;
@@ -3320,6 +3779,61 @@ namespace Mono.Debugger.Backend
 		}
 	}
 
+	//
+	// Call mprotect() in the target for page-protection watchpoints.
+	//
+	protected class OperationChangePageProtection : OperationCallback
+	{
+		public readonly BreakpointManager.PageProtection[] Changes;
+
+		TargetAddress mprotect;
+		int pos;
+
+		public OperationChangePageProtection (SingleSteppingEngine sse,
+						      BreakpointManager.PageProtection[] changes)
+			: base (sse)
+		{
+			this.Changes = changes;
+		}
+
+		protected override void DoExecute ()
+		{
+			mprotect = sse.process.OperatingSystem.LookupSymbol ("mprotect");
+			if (mprotect.IsNull)
+				throw new TargetException (TargetError.SymbolTable,
+							   "Can't find mprotect() in the target.");
+
+			call_mprotect ();
+		}
+
+		void call_mprotect ()
+		{
+			BreakpointManager.PageProtection change = Changes [pos];
+
+			Report.Debug (DebugFlags.SSE, "{0} change page protection: {1}", sse, change);
+
+			// call_method_1() passes the first three arguments in %rdi, %rsi and %rdx.
+			inferior.CallMethod (mprotect, change.Start.Address, change.Size,
+					     change.Protection, "", ID);
+		}
+
+		protected override EventResult CallbackCompleted (long data1, long data2, out TargetEventArgs args)
+		{
+			args = null;
+
+			if ((int) data1 != 0)
+				Report.Error ("{0} can't change page protection: {1}", sse, Changes [pos]);
+
+			if (++pos < Changes.Length) {
+				call_mprotect ();
+				return EventResult.Running;
+			}
+
+			RestoreStack ();
+			return EventResult.CompletedCallback;
+		}
+	}
+
 	protected class OperationExecuteInstruction : Operation
 	{
 		public readonly byte[] Instruction;
@@ -3373,6 +3887,95 @@ namespace Mono.Debugger.Backend
 		}
 	}
 
+	//
+	// Step over a breakpoint by single-stepping a relocated copy of the instruction
+	// in the code buffer; unlike `OperationStepOverBreakpoint', the other threads
+	// keep running.
+	//
+	protected class OperationDisplacedStep : Operation
+	{
+		public readonly int Index;
+		readonly Instruction instruction;
+		TargetAddress until;
+
+		bool pushed_code_buffer;
+		bool stepped_in_place;
+
+		public OperationDisplacedStep (SingleSteppingEngine sse, int index,
+					       Instruction instruction, TargetAddress until)
+			: base (sse, null)
+		{
+			this.Index = index;
+			this.instruction = instruction;
+			this.until = until;
+		}
+
+		public override bool IsSourceOperation {
+			get { return false; }
+		}
+
+		protected override void DoExecute ()
+		{
+			if (!sse.Process.MonoManager.HasCodeBuffer) {
+				sse.PushOperation (new OperationInitCodeBuffer (sse));
+				pushed_code_buffer = true;
+				return;
+			}
+
+			execute_displaced ();
+		}
+
+		void execute_displaced ()
+		{
+			Report.Debug (DebugFlags.SSE,
+				      "{0} displaced stepping over breakpoint {1} at {2} until {3}: {4}",
+				      sse, Index, inferior.CurrentFrame, until,
+				      TargetBinaryReader.HexDump (instruction.Code));
+
+			if (inferior.ExecuteDisplacedInstruction (
+				    instruction.Code, instruction.DisplacementOffset))
+				return;
+
+			//
+			// The server can't relocate this instruction (the code buffer is
+			// too far away for its displacement), so step it in place.
+			//
+			stepped_in_place = true;
+			sse.PushOperation (new OperationStepOverBreakpoint (sse, Index, until));
+		}
+
+		protected override EventResult DoProcessEvent (Inferior.ChildEvent cevent,
+							       out TargetEventArgs args)
+		{
+			Report.Debug (DebugFlags.SSE,
+				      "{0} displaced step over breakpoint {1} done at {2}: {3} {4}",
+				      sse, Index, inferior.CurrentFrame, cevent, until);
+
+			args = null;
+			if (pushed_code_buffer) {
+				pushed_code_buffer = false;
+				execute_displaced ();
+				return EventResult.Running;
+			}
+
+			if (stepped_in_place)
+				return EventResult.ResumeOperation;
+
+			if ((cevent.Type == Inferior.ChildEventType.CHILD_HIT_BREAKPOINT) &&
+			    (cevent.Argument != Index))
+				return EventResult.Completed;
+
+			if (!until.IsNull) {
+				sse.do_continue (until);
+
+				until = TargetAddress.Null;
+				return EventResult.Running;
+			}
+
+			return EventResult.ResumeOperation;
+		}
+	}
+
 	protected abstract class OperationStepBase : Operation
 	{
 		public override bool CheckBreakpointsOnCompletion {
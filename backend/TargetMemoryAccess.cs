@@ -42,10 +42,40 @@ namespace Mono.Debugger
 
 		public abstract string ReadString (TargetAddress address);
 
+		// <summary>
+		//   Read a NUL-terminated string, but stop after `max_length' bytes if
+		//   there's no terminator before that.
+		// </summary>
+		public abstract string ReadString (TargetAddress address, int max_length);
+
 		public abstract TargetBlob ReadMemory (TargetAddress address, int size);
 
 		public abstract byte[] ReadBuffer (TargetAddress address, int size);
 
+		// <summary>
+		//   Read several (address, size) ranges at once.
+		//   Backends which can do this in a single operation override this; the
+		//   default implementation just reads the ranges one after another.
+		// </summary>
+		public virtual byte[][] ReadMemoryBatch (TargetAddress[] addresses, int[] sizes)
+		{
+			if (addresses.Length != sizes.Length)
+				throw new ArgumentException ();
+
+			byte[][] retval = new byte [addresses.Length][];
+			for (int i = 0; i < addresses.Length; i++)
+				retval [i] = ReadBuffer (addresses [i], sizes [i]);
+			return retval;
+		}
+
+		// <summary>
+		//   Announce that we're about to read the (address, size) ranges, so a
+		//   caching target can read them in one batch instead of one by one.
+		//   This is only a hint; the default implementation does nothing.
+		// </summary>
+		public virtual void Prefetch (TargetAddress[] addresses, int[] sizes)
+		{ }
+
 		public abstract Registers GetRegisters ();
 
 		public abstract bool CanWrite {
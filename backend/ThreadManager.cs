@@ -21,6 +21,12 @@ namespace Mono.Debugger.Backend
 	{
 		public static TimeSpan WaitTimeout = TimeSpan.FromMilliseconds (5000);
 
+		// <summary>
+		//   Maximum number of child events the wait thread reaps in one go and
+		//   hands to the engine thread as a single batch.
+		// </summary>
+		public const int MaxWaitEvents = 64;
+
 		internal ThreadManager (Debugger debugger)
 		{
 			this.debugger = debugger;
@@ -30,6 +36,10 @@ namespace Mono.Debugger.Backend
 			processes = ArrayList.Synchronized (new ArrayList ());
 
 			pending_events = Hashtable.Synchronized (new Hashtable ());
+			queued_events = new Dictionary<int,int> ();
+
+			wait_pids = new int [MaxWaitEvents];
+			wait_statuses = new int [MaxWaitEvents];
 
 			last_pending_sigstop = DateTime.Now;
 			pending_sigstops = new Dictionary<int,DateTime> ();
@@ -44,6 +54,7 @@ namespace Mono.Debugger.Backend
 			event_queue.DebugFlags = DebugFlags.Wait;
 
 			mono_debugger_server_global_init ();
+			tracks_new_thread_stops = Inferior.TracksNewThreadStops;
 
 			wait_thread = new ST.Thread (new ST.ThreadStart (start_wait_thread));
 			wait_thread.IsBackground = true;
@@ -66,12 +77,17 @@ namespace Mono.Debugger.Backend
 		Hashtable thread_hash;
 		Hashtable engine_hash;
 		Hashtable pending_events;
+		Dictionary<int,int> queued_events;
 		ArrayList processes;
 
+		int[] wait_pids;
+		int[] wait_statuses;
+
 		AddressDomain address_domain;
 
 		DateTime last_pending_sigstop;
 		Dictionary<int,DateTime> pending_sigstops;
+		bool tracks_new_thread_stops;
 
 		bool abort_requested;
 		bool waiting;
@@ -82,6 +98,9 @@ namespace Mono.Debugger.Backend
 		[DllImport("monodebuggerserver")]
 		static extern int mono_debugger_server_global_wait (out int status);
 
+		[DllImport("monodebuggerserver")]
+		static extern int mono_debugger_server_global_wait_many (int max_events, [Out] int[] pids, [Out] int[] status);
+
 		[DllImport("monodebuggerserver")]
 		static extern Inferior.ChildEventType mono_debugger_server_dispatch_simple (int status, out int arg);
 
@@ -102,8 +121,8 @@ namespace Mono.Debugger.Backend
 		//   lock (this) before accessing/modifying them.
 		// </remarks>
 		Command current_command = null;
-		SingleSteppingEngine current_event = null;
-		int current_event_status = 0;
+		SingleSteppingEngine[] current_events = null;
+		int[] current_event_status = null;
 
 #if DISABLED
 		public Process OpenCoreFile (ProcessStart start, out Thread[] threads)
@@ -147,6 +166,12 @@ namespace Mono.Debugger.Backend
 				return true;
 			}
 
+			if (cevent.Type == Inferior.ChildEventType.CHILD_RESUMED) {
+				// The server already resumed the target after a false breakpoint condition.
+				resume_target = false;
+				return true;
+			}
+
 			if (cevent.Type == Inferior.ChildEventType.CHILD_CREATED_THREAD) {
 				int pid = (int) cevent.Argument;
 				inferior.Process.ThreadCreated (inferior, pid, false, true);
@@ -280,6 +305,23 @@ namespace Mono.Debugger.Backend
 			}
 		}
 
+		// <summary>
+		//   While the engine thread is working through a batch of events, the
+		//   ones it didn't get to yet have already been reaped from the kernel.
+		//   If an engine needs to stop such a thread, it must take its event
+		//   from here instead of waiting for it.
+		// </summary>
+		internal bool TakeQueuedEvent (int pid, out int status)
+		{
+			lock (queued_events) {
+				if (!queued_events.TryGetValue (pid, out status))
+					return false;
+
+				queued_events.Remove (pid);
+				return true;
+			}
+		}
+
 		internal void AddPendingEvent (SingleSteppingEngine engine, Inferior.ChildEvent cevent)
 		{
 			Report.Debug (DebugFlags.Wait, "Add pending event: {0} {1}", engine, cevent);
@@ -308,37 +350,60 @@ namespace Mono.Debugger.Backend
 				return;
 			}
 
-			int status;
-			SingleSteppingEngine event_engine;
+			int[] statuses;
+			SingleSteppingEngine[] event_engines;
 			Command command;
 
-			Report.Debug (DebugFlags.Wait, "ThreadManager woke up: {0} {1:x} {2}",
-				      current_event, current_event_status, current_command);
+			Report.Debug (DebugFlags.Wait, "ThreadManager woke up: {0} {1}",
+				      current_events != null ? current_events.Length : 0, current_command);
 
-			event_engine = current_event;
-			status = current_event_status;
+			event_engines = current_events;
+			statuses = current_event_status;
 
-			current_event = null;
-			current_event_status = 0;
+			current_events = null;
+			current_event_status = null;
 
 			command = current_command;
 			current_command = null;
 
-			if (event_engine != null) {
-				try {
-					Report.Debug (DebugFlags.Wait,
-						      "ThreadManager {0} process event: {1}",
-						      DebuggerWaitHandle.CurrentThread, event_engine);
-					event_engine.ProcessEvent (status);
-					Report.Debug (DebugFlags.Wait,
-						      "ThreadManager {0} process event done: {1}",
-						      DebuggerWaitHandle.CurrentThread, event_engine);
-				} catch (ST.ThreadAbortException) {
-					;
-				} catch (Exception e) {
-					Report.Debug (DebugFlags.Wait,
-						      "ThreadManager caught exception: {0}", e);
-					Console.WriteLine ("EXCEPTION: {0}", e);
+			if (event_engines != null) {
+				//
+				// A thread can't report another event before it's resumed, so each
+				// pid occurs at most once in a batch.
+				//
+				lock (queued_events) {
+					for (int i = 0; i < event_engines.Length; i++)
+						queued_events [event_engines [i].PID] = statuses [i];
+				}
+
+				for (int i = 0; i < event_engines.Length; i++) {
+					SingleSteppingEngine event_engine = event_engines [i];
+
+					//
+					// Processing one of the previous events may have stopped this
+					// thread and consumed its event or disposed it.
+					//
+					int status;
+					if (!TakeQueuedEvent (event_engine.PID, out status))
+						continue;
+					if (thread_hash [event_engine.PID] != event_engine)
+						continue;
+
+					try {
+						Report.Debug (DebugFlags.Wait,
+							      "ThreadManager {0} process event: {1} {2:x}",
+							      DebuggerWaitHandle.CurrentThread, event_engine, status);
+						event_engine.ProcessEvent (status);
+						Report.Debug (DebugFlags.Wait,
+							      "ThreadManager {0} process event done: {1}",
+							      DebuggerWaitHandle.CurrentThread, event_engine);
+					} catch (ST.ThreadAbortException) {
+						;
+					} catch (Exception e) {
+						Report.Debug (DebugFlags.Wait,
+							      "ThreadManager caught exception: {0}", e);
+						Console.WriteLine ("EXCEPTION: {0}", e);
+					}
 				}
 
 				check_pending_events ();
@@ -485,7 +550,8 @@ namespace Mono.Debugger.Backend
 				return false;
 			}
 
-			if (DateTime.Now - last_pending_sigstop > new TimeSpan (0, 2, 30)) {
+			if (!tracks_new_thread_stops &&
+			    (DateTime.Now - last_pending_sigstop > new TimeSpan (0, 2, 30))) {
 				foreach (int pending in pending_sigstops.Keys) {
 					Report.Error ("Got SIGSTOP from unknown PID {0}!", pending);
 				}
@@ -498,121 +564,147 @@ namespace Mono.Debugger.Backend
 
 			//
 			// Wait until we got an event from the target or a command from the user.
+			// Everything else which is already pending is collected as well, so
+			// we only need to wake up the engine thread once.
 			//
 
-			pid = mono_debugger_server_global_wait (out status);
+			int count = mono_debugger_server_global_wait_many (
+				MaxWaitEvents, wait_pids, wait_statuses);
 
 			Report.Debug (DebugFlags.Wait,
-				      "Wait thread received event: {0} {1:x}",
-				      pid, status);
-
-			//
-			// Note: `pid' is basically just an unique number which identifies the
-			//       SingleSteppingEngine of this event.
-			//
+				      "Wait thread received {0} events", count);
 
-			if (abort_requested || (pid <= 0))
+			if (abort_requested || (count <= 0))
 				return true;
 
-			if(!Inferior.HasThreadEvents)
-			{
-				int arg;
-				Inferior.ChildEventType etype = mono_debugger_server_dispatch_simple (status, out arg);
-				SingleSteppingEngine engine = (SingleSteppingEngine) thread_hash [pid];
-				if(etype == Inferior.ChildEventType.CHILD_EXITED) {
-					if(engine != null) {
-						SingleSteppingEngine[] sses = new SingleSteppingEngine [thread_hash.Count];
-						thread_hash.Values.CopyTo (sses, 0);
-						foreach(SingleSteppingEngine sse in sses)
-							sse.ProcessEvent (status);
-						Dispose();
-						waiting = false;
-						return true;
+			List<SingleSteppingEngine> event_engines = new List<SingleSteppingEngine> ();
+			List<int> event_statuses = new List<int> ();
+
+			for (int i = 0; i < count; i++) {
+				pid = wait_pids [i];
+				status = wait_statuses [i];
+
+				Report.Debug (DebugFlags.Wait,
+					      "Wait thread received event: {0} {1:x}",
+					      pid, status);
+
+				//
+				// Note: `pid' is basically just an unique number which identifies the
+				//       SingleSteppingEngine of this event.
+				//
+
+				if(!Inferior.HasThreadEvents)
+				{
+					int arg;
+					Inferior.ChildEventType etype = mono_debugger_server_dispatch_simple (status, out arg);
+					SingleSteppingEngine engine = (SingleSteppingEngine) thread_hash [pid];
+					if(etype == Inferior.ChildEventType.CHILD_EXITED) {
+						if(engine != null) {
+							SingleSteppingEngine[] sses = new SingleSteppingEngine [thread_hash.Count];
+							thread_hash.Values.CopyTo (sses, 0);
+							foreach(SingleSteppingEngine sse in sses)
+								sse.ProcessEvent (status);
+							Dispose();
+							waiting = false;
+							return true;
+						}
+						else
+							continue;
 					}
-					else
-						goto again;
-				}
 
-				if (engine == null) {
-					SingleSteppingEngine[] sses = new SingleSteppingEngine [thread_hash.Count];
-					thread_hash.Values.CopyTo (sses, 0);				
-					Inferior inferior = sses[0].Inferior;		
-					inferior.Process.ThreadCreated (inferior, pid, false, true);
-					goto again;
-				}
+					if (engine == null) {
+						SingleSteppingEngine[] sses = new SingleSteppingEngine [thread_hash.Count];
+						thread_hash.Values.CopyTo (sses, 0);				
+						Inferior inferior = sses[0].Inferior;		
+						inferior.Process.ThreadCreated (inferior, pid, false, true);
+						continue;
+					}
 
-				ArrayList check_threads = new ArrayList();
-				bool got_threads = true;
-				foreach(Process process in processes)
-					got_threads = got_threads && process.CheckForThreads(check_threads);
-
-				if(got_threads) {
-					int[] lwps = new int [thread_hash.Count];
-					thread_hash.Keys.CopyTo (lwps, 0);
-					foreach(int lwp in lwps) {
-						if(!check_threads.Contains(lwp)) {
-							SingleSteppingEngine old_engine = (SingleSteppingEngine) thread_hash [lwp];					
-							thread_hash.Remove (old_engine.PID);
-							engine_hash.Remove (old_engine.ID);
-							old_engine.Process.OnThreadExitedEvent (old_engine);
-							old_engine.Dispose ();
+					ArrayList check_threads = new ArrayList();
+					bool got_threads = true;
+					foreach(Process process in processes)
+						got_threads = got_threads && process.CheckForThreads(check_threads);
+
+					if(got_threads) {
+						int[] lwps = new int [thread_hash.Count];
+						thread_hash.Keys.CopyTo (lwps, 0);
+						foreach(int lwp in lwps) {
+							if(!check_threads.Contains(lwp)) {
+								SingleSteppingEngine old_engine = (SingleSteppingEngine) thread_hash [lwp];					
+								thread_hash.Remove (old_engine.PID);
+								engine_hash.Remove (old_engine.ID);
+								old_engine.Process.OnThreadExitedEvent (old_engine);
+								old_engine.Dispose ();
+							}
 						}
 					}
 				}
-			}
 
-			SingleSteppingEngine event_engine = (SingleSteppingEngine) thread_hash [pid];
-			if (event_engine == null && Inferior.HasThreadEvents) {
-				int arg;
-				Inferior.ChildEventType etype = mono_debugger_server_dispatch_simple (status, out arg);
-
-				/*
-				 * Ignore exit events from unknown children.
-				 */
-
-				if ((etype == Inferior.ChildEventType.CHILD_EXITED) && (arg == 0))
-					goto again;
-
-				/*
-				 * There is a race condition in the Linux kernel which shows up on >= 2.6.27:
-				 *
-				 * When creating a new thread, the initial stopping event of that thread is sometimes
-				 * sent before sending the `PTRACE_EVENT_CLONE' for it.
-				 *
-				 * Because of this, we explicitly wait for the new thread to stop and ignore any
-				 * "early" stopping signals.
-				 *
-				 * See also the comments in _server_ptrace_wait_for_new_thread() in x86-linux-ptrace.c
-				 * and bugs #423518 and #466012.
-				 *
-				 */
-
-				if ((etype != Inferior.ChildEventType.CHILD_STOPPED) || (arg != 0)) {
-					Report.Error ("WARNING: Got event {0:x} for unknown pid {1}", status, pid);
-					waiting = false;
-					RequestWait ();
-					return true;
+				SingleSteppingEngine event_engine = (SingleSteppingEngine) thread_hash [pid];
+				if (event_engine == null && Inferior.HasThreadEvents) {
+					int arg;
+					Inferior.ChildEventType etype = mono_debugger_server_dispatch_simple (status, out arg);
+
+					/*
+					 * Ignore exit events from unknown children.
+					 */
+
+					if ((etype == Inferior.ChildEventType.CHILD_EXITED) && (arg == 0))
+						continue;
+
+					/*
+					 * There is a race condition in the Linux kernel which shows up on >= 2.6.27:
+					 *
+					 * When creating a new thread, the initial stopping event of that thread is sometimes
+					 * sent before sending the `PTRACE_EVENT_CLONE' for it.
+					 *
+					 * Because of this, we explicitly wait for the new thread to stop and ignore any
+					 * "early" stopping signals.
+					 *
+					 * See also the comments in _server_ptrace_wait_for_new_thread() in x86-linux-ptrace.c
+					 * and bugs #423518 and #466012.
+					 *
+					 */
+
+					if ((etype != Inferior.ChildEventType.CHILD_STOPPED) || (arg != 0)) {
+						Report.Error ("WARNING: Got event {0:x} for unknown pid {1}", status, pid);
+						continue;
+					}
+
+					/*
+					 * The server already swallows these if it can tell them apart.
+					 */
+					if (tracks_new_thread_stops) {
+						Report.Debug (DebugFlags.Wait, "Ignoring SIGSTOP from unknown pid {0}.", pid);
+						continue;
+					}
+
+					if (!pending_sigstops.ContainsKey (pid))
+						pending_sigstops.Add (pid, DateTime.Now);
+
+					Report.Debug (DebugFlags.Wait, "Ignoring SIGSTOP from unknown pid {0}.", pid);
+					continue;
 				}
 
-				if (!pending_sigstops.ContainsKey (pid))
-					pending_sigstops.Add (pid, DateTime.Now);
+				event_engines.Add (event_engine);
+				event_statuses.Add (status);
+			}
 
-				Report.Debug (DebugFlags.Wait, "Ignoring SIGSTOP from unknown pid {0}.", pid);
+			if (event_engines.Count == 0)
 				goto again;
-			}
 
 			engine_event.WaitOne ();
 
 			event_queue.Lock ();
 			engine_event.Reset ();
 
-			if (current_event != null) {
+			if (current_events != null) {
 				Console.WriteLine ("Current_event is not null: {0}", Environment.StackTrace);
 				throw new InternalError ();
 			}
 
-			current_event = event_engine;
-			current_event_status = status;
+			current_events = event_engines.ToArray ();
+			current_event_status = event_statuses.ToArray ();
 
 			waiting = false;
 
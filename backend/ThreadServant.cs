@@ -98,6 +98,8 @@ namespace Mono.Debugger.Backend
 
 		public abstract TargetMemoryArea[] GetMemoryMaps ();
 
+		public abstract TargetMemoryArea FindMemoryArea (TargetAddress address);
+
 		public abstract Method Lookup (TargetAddress address);
 
 		public abstract Symbol SimpleLookup (TargetAddress address, bool exact_match);
@@ -165,6 +167,8 @@ namespace Mono.Debugger.Backend
 		// </summary>
 		internal abstract void RemoveBreakpoint (BreakpointHandle handle);
 
+		internal abstract void UpdateIgnoreCount (Breakpoint breakpoint, int count);
+
 		internal abstract void AcquireThreadLock ();
 
 		internal abstract void ReleaseThreadLock ();
@@ -260,6 +264,8 @@ namespace Mono.Debugger.Backend
 
 		public abstract string ReadString (TargetAddress address);
 
+		public abstract string ReadString (TargetAddress address, int max_length);
+
 		public abstract TargetBlob ReadMemory (TargetAddress address, int size);
 
 		public abstract byte[] ReadBuffer (TargetAddress address, int size);
@@ -102,8 +102,8 @@ namespace Mono.Debugger.Architectures
 				return new string[] {
 					"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
 					null, null, null, null, null, null, null, null,
-					"eip", "eflags", null, "cs", "ss", "ds", "es",
-					"fs", "gs", null, null
+					"eip", "eflags", "orig_eax", "cs", "ss", "ds", "es",
+					"fs", "gs", "fs_base", "gs_base"
 				};
 			}
 		}
@@ -1,6 +1,7 @@
 #if DISABLED
 using System;
 using System.IO;
+using System.Text;
 using System.Collections;
 using ST = System.Threading;
 using System.Runtime.InteropServices;
@@ -383,6 +384,11 @@ namespace Mono.Debugger.Backend
 				throw new NotImplementedException ();
 			}
 
+			public override TargetMemoryArea FindMemoryArea (TargetAddress address)
+			{
+				throw new NotImplementedException ();
+			}
+
 			public override Method Lookup (TargetAddress address)
 			{
 				return CoreFile.SymbolTableManager.Lookup (address);
@@ -438,7 +444,37 @@ namespace Mono.Debugger.Backend
 
 			public override string ReadString (TargetAddress address)
 			{
-				return CoreFile.GetReader (address).BinaryReader.ReadString ();
+				return ReadString (address, Int32.MaxValue);
+			}
+
+			//
+			// The sections are already in memory, so just search for the
+			// terminator in there; a string may continue in the next section.
+			//
+			public override string ReadString (TargetAddress address, int max_length)
+			{
+				StringBuilder sb = new StringBuilder ();
+
+				while (sb.Length < max_length) {
+					TargetReader reader = CoreFile.GetReader (address);
+					int start = (int) reader.Offset;
+					int count = (int) Math.Min (reader.Size - start, max_length - sb.Length);
+					if (count <= 0)
+						break;
+
+					int end = Array.IndexOf (reader.Contents, (byte) 0, start, count);
+					int length = end < 0 ? count : end - start;
+
+					for (int i = 0; i < length; i++)
+						sb.Append ((char) reader.Contents [start + i]);
+
+					if (end >= 0)
+						break;
+
+					address += count;
+				}
+
+				return sb.ToString ();
 			}
 
 			public override TargetBlob ReadMemory (TargetAddress address, int size)
@@ -507,6 +543,11 @@ namespace Mono.Debugger.Backend
 				throw new InvalidOperationException ();
 			}
 
+			internal override void UpdateIgnoreCount (Breakpoint breakpoint, int count)
+			{
+				throw new InvalidOperationException ();
+			}
+
 			public override CommandResult Step (ThreadingModel model, StepMode mode, StepFrame frame)
 			{
 				throw new InvalidOperationException ();
@@ -660,6 +701,11 @@ namespace Mono.Debugger.Backend
 					return Thread.ReadString (address);
 				}
 
+				public override string ReadString (TargetAddress address, int max_length)
+				{
+					return Thread.ReadString (address, max_length);
+				}
+
 				public override TargetBlob ReadMemory (TargetAddress address, int size)
 				{
 					return Thread.ReadMemory (address, size);
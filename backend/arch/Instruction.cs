@@ -67,6 +67,17 @@ namespace Mono.Debugger.Architectures
 			get;
 		}
 
+		// Whether the instruction may be single-stepped from a different address
+		// with `Inferior.ExecuteDisplacedInstruction'.
+		public abstract bool CanDisplaceInstruction {
+			get;
+		}
+
+		// Offset of the IP-relative displacement within `Code' or -1.
+		public abstract int DisplacementOffset {
+			get;
+		}
+
 		public abstract bool InterpretInstruction (Inferior inferior);
 	}
 }
@@ -62,6 +62,30 @@ namespace Mono.Debugger.Architectures
 			get { return has_insn_size; }
 		}
 
+		public override bool CanDisplaceInstruction {
+			get {
+				if (!has_insn_size)
+					return false;
+
+				switch (type) {
+				case Type.ConditionalJump:
+				case Type.Jump:
+					return true;
+
+				case Type.Unknown:
+				case Type.Interpretable:
+					return !is_ip_relative || (displacement_offset >= 0);
+
+				default:
+					return false;
+				}
+			}
+		}
+
+		public override int DisplacementOffset {
+			get { return displacement_offset; }
+		}
+
 		public override int InstructionSize {
 			get {
 				if (!has_insn_size)
@@ -81,6 +105,8 @@ namespace Mono.Debugger.Architectures
 		}
 
 		bool is_ip_relative;
+		bool opaque_encoding;
+		int displacement_offset = -1;
 		bool has_insn_size;
 		int insn_size;
 		byte[] code;
@@ -293,11 +319,18 @@ namespace Mono.Debugger.Architectures
 
 			if (Is64BitMode && (ModRM.Mod == 0) && ((ModRM.R_M & 0x07) == 0x05)) {
 				is_ip_relative = true;
+				/* The disp32 immediately follows the ModRM byte. */
+				if (!opaque_encoding)
+					displacement_offset = (int) reader.Offset;
 			}
 		}
 
 		protected void OneByteOpcode (TargetReader reader, byte opcode)
 		{
+			/* VEX prefixes; we don't decode these. */
+			if (Is64BitMode && ((opcode == 0xc4) || (opcode == 0xc5)))
+				opaque_encoding = true;
+
 			if (OneByte_Has_ModRM [opcode] != 0)
 				DecodeModRM (reader);
 
@@ -344,6 +377,10 @@ namespace Mono.Debugger.Architectures
 		{
 			byte opcode = reader.ReadByte ();
 
+			/* Three-byte opcodes; the ModRM byte comes later. */
+			if ((opcode == 0x38) || (opcode == 0x3a))
+				opaque_encoding = true;
+
 			if (TwoByte_Has_ModRM [opcode] != 0)
 				DecodeModRM (reader);
 
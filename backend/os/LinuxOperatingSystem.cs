@@ -255,6 +255,9 @@ namespace Mono.Debugger.Backend
 			if (inferior.ReadInteger (rdebug_state_addr) != 0)
 				return false;
 
+			// A library has been loaded or unloaded.
+			inferior.InvalidateMemoryMaps ();
+
 			do_update_shlib_info (inferior);
 			return false;
 		}
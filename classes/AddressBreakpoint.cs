@@ -8,7 +8,7 @@ namespace Mono.Debugger
 	{
 		AddressBreakpointHandle handle;
 		TargetAddress address = TargetAddress.Null;
-		int domain;
+		int domain, size;
 
 		public override bool IsPersistent {
 			get { return false; }
@@ -22,6 +22,24 @@ namespace Mono.Debugger
 			get { return address; }
 		}
 
+		// <summary>
+		//   The size of the watched range or zero to use a hardware watchpoint
+		//   if there's a free debug register.
+		// </summary>
+		public int Size {
+			get { return size; }
+		}
+
+		// <summary>
+		//   Only stop if the watched value actually changed and not each time the
+		//   same value is written again.  The debugger server compares the values
+		//   itself, so this is cheap even for frequently written locations.  This
+		//   must be set before the watchpoint is activated.
+		// </summary>
+		public bool ChangesOnly {
+			get; set;
+		}
+
 		internal AddressBreakpoint (string name, ThreadGroup group, TargetAddress address)
 			: base (EventType.Breakpoint, name, group)
 		{
@@ -29,9 +47,14 @@ namespace Mono.Debugger
 		}
 
 		internal AddressBreakpoint (HardwareWatchType type, TargetAddress address)
+			: this (type, address, 0)
+		{ }
+
+		internal AddressBreakpoint (HardwareWatchType type, TargetAddress address, int size)
 			: base (GetEventType (type), address.ToString (), ThreadGroup.Global)
 		{
 			this.address = address;
+			this.size = size;
 		}
 
 		public override bool IsActivated {
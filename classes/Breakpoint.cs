@@ -27,6 +27,55 @@ namespace Mono.Debugger
 			get { return false; }
 		}
 
+		// <summary>
+		//   An optional condition which is evaluated each time the breakpoint is
+		//   hit; the breakpoint is ignored if it's false.  The debugger server
+		//   evaluates this itself where possible, without stopping the target.
+		// </summary>
+		// <remarks>
+		//   This must be set before the breakpoint is activated.
+		// </remarks>
+		public BreakpointCondition Condition {
+			get; set;
+		}
+
+		// <summary>
+		//   The number of hits each of the breakpoint's locations ignores after
+		//   it's been activated.  Use Ignore() to change it once the breakpoint
+		//   is activated.
+		// </summary>
+		public int IgnoreCount {
+			get; set;
+		}
+
+		// <summary>
+		//   Ignore the next @count hits of each of this breakpoint's locations.
+		//   If @target is null, this applies to the next time the breakpoint is
+		//   activated.
+		// </summary>
+		// <remarks>
+		//   The debugger server keeps the hit and ignore counts per location; use
+		//   Process.GetIgnoreCount() to find out how many hits are still ignored.
+		// </remarks>
+		public void Ignore (Thread target, int count)
+		{
+			if (count < 0)
+				throw new ArgumentOutOfRangeException ("count");
+
+			IgnoreCount = count;
+			if ((target != null) && IsActivated)
+				target.UpdateIgnoreCount (this, count);
+		}
+
+		// <summary>
+		//   How often the breakpoint has been hit (with its condition being true),
+		//   including the ignored hits.  The debugger server counts these itself, so
+		//   this is only updated when the breakpoint is actually reported.
+		// </summary>
+		public int HitCount {
+			get; internal set;
+		}
+
 		public override void Remove (Thread target)
 		{
 			Deactivate (target);
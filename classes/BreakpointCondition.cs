@@ -0,0 +1,513 @@
+using System;
+using System.IO;
+using System.Globalization;
+using System.Collections.Generic;
+
+using Mono.Debugger.Backend;
+using Mono.Debugger.Architectures;
+
+namespace Mono.Debugger
+{
+	// <summary>
+	//   A simple breakpoint condition which can be evaluated by the debugger server
+	//   itself, without stopping all threads and reporting the breakpoint to us.
+	// </summary>
+	// <remarks>
+	//   The condition is built as a small stack-based program: operands are pushed
+	//   onto the stack and the operators pop their arguments and push the result.
+	//   The breakpoint is only hit if the value which is left on the stack is
+	//   non-zero.  The encoding must match `BreakpointConditionOpcode' in the
+	//   server's breakpoints.h.
+	//
+	//   Parse() creates a condition from its textual form, which is what the
+	//   user interface uses and what we store in the session.
+	// </remarks>
+	[Serializable]
+	public sealed class BreakpointCondition
+	{
+		enum Opcode : byte {
+			Register = 1,
+			Constant,
+			Load,
+			Add,
+			Equal,
+			NotEqual,
+			Less,
+			LessEqual,
+			Greater,
+			GreaterEqual,
+			And,
+			Or,
+			Not
+		}
+
+		const int MaxStackSize = 16;
+		const byte SignExtend = 0x80;
+
+		MemoryStream stream = new MemoryStream ();
+		int stack_size, max_stack_size;
+
+		// Registers which are referenced by name and their operand's offset in the code.
+		List<string> register_names = new List<string> ();
+		List<int> register_offsets = new List<int> ();
+
+		string text;
+
+		// <summary>
+		//   The text this condition was parsed from or null.
+		// </summary>
+		public string Text {
+			get { return text; }
+		}
+
+		public byte[] Code {
+			get {
+				if (stack_size != 1)
+					throw new InvalidOperationException (
+						"Breakpoint condition must leave exactly one value on the stack.");
+				return stream.ToArray ();
+			}
+		}
+
+		//
+		// The code with the register names resolved for `arch'.
+		//
+		internal byte[] GetCode (Architecture arch)
+		{
+			byte[] code = Code;
+			for (int i = 0; i < register_names.Count; i++) {
+				int regnum = Array.IndexOf (arch.RegisterNames, register_names [i]);
+				if (regnum < 0)
+					throw new TargetException (
+						TargetError.NoSuchRegister, "No such register: `{0}'.",
+						register_names [i]);
+
+				Array.Copy (BitConverter.GetBytes (regnum), 0, code, register_offsets [i], 4);
+			}
+
+			return code;
+		}
+
+		public BreakpointCondition Register (int index)
+		{
+			emit (Opcode.Register, 0, 1);
+			write (BitConverter.GetBytes (index));
+			return this;
+		}
+
+		// <summary>
+		//   Push register `name'; it's looked up when the breakpoint is inserted.
+		// </summary>
+		public BreakpointCondition Register (string name)
+		{
+			emit (Opcode.Register, 0, 1);
+			register_names.Add (name);
+			register_offsets.Add ((int) stream.Position);
+			write (BitConverter.GetBytes (-1));
+			return this;
+		}
+
+		public BreakpointCondition Constant (long value)
+		{
+			emit (Opcode.Constant, 0, 1);
+			write (BitConverter.GetBytes (value));
+			return this;
+		}
+
+		public BreakpointCondition Load (int size, bool sign_extend)
+		{
+			if ((size != 1) && (size != 2) && (size != 4) && (size != 8))
+				throw new ArgumentException ();
+
+			emit (Opcode.Load, 1, 1);
+			stream.WriteByte ((byte) (sign_extend ? size | SignExtend : size));
+			return this;
+		}
+
+		public BreakpointCondition Add ()
+		{
+			return binary (Opcode.Add);
+		}
+
+		public BreakpointCondition Equal ()
+		{
+			return binary (Opcode.Equal);
+		}
+
+		public BreakpointCondition NotEqual ()
+		{
+			return binary (Opcode.NotEqual);
+		}
+
+		public BreakpointCondition Less ()
+		{
+			return binary (Opcode.Less);
+		}
+
+		public BreakpointCondition LessEqual ()
+		{
+			return binary (Opcode.LessEqual);
+		}
+
+		public BreakpointCondition Greater ()
+		{
+			return binary (Opcode.Greater);
+		}
+
+		public BreakpointCondition GreaterEqual ()
+		{
+			return binary (Opcode.GreaterEqual);
+		}
+
+		public BreakpointCondition And ()
+		{
+			return binary (Opcode.And);
+		}
+
+		public BreakpointCondition Or ()
+		{
+			return binary (Opcode.Or);
+		}
+
+		public BreakpointCondition Not ()
+		{
+			emit (Opcode.Not, 1, 1);
+			return this;
+		}
+
+		BreakpointCondition binary (Opcode opcode)
+		{
+			emit (opcode, 2, 1);
+			return this;
+		}
+
+		void emit (Opcode opcode, int pop, int push)
+		{
+			if (stack_size < pop)
+				throw new InvalidOperationException (
+					"Stack underflow in breakpoint condition.");
+
+			stack_size += push - pop;
+			max_stack_size = Math.Max (max_stack_size, stack_size);
+			if (max_stack_size > MaxStackSize)
+				throw new InvalidOperationException (
+					"Breakpoint condition is too complex.");
+
+			stream.WriteByte ((byte) opcode);
+		}
+
+		void write (byte[] data)
+		{
+			stream.Write (data, 0, data.Length);
+		}
+
+		//
+		// Evaluate the condition in the current stack frame.  The server does this
+		// itself if it can; this is used if it couldn't set up the condition.
+		//
+		internal bool Evaluate (Inferior inferior)
+		{
+			byte[] code = GetCode (inferior.Architecture);
+			long[] stack = new long [MaxStackSize];
+			Registers regs = inferior.GetRegisters ();
+			int pos = 0, sp = 0;
+
+			while (pos < code.Length) {
+				Opcode opcode = (Opcode) code [pos++];
+				long a, b;
+
+				switch (opcode) {
+				case Opcode.Register:
+					stack [sp++] = regs [BitConverter.ToInt32 (code, pos)].GetValue ();
+					pos += 4;
+					continue;
+
+				case Opcode.Constant:
+					stack [sp++] = BitConverter.ToInt64 (code, pos);
+					pos += 8;
+					continue;
+
+				case Opcode.Load:
+					stack [sp - 1] = load (inferior, stack [sp - 1], code [pos++]);
+					continue;
+
+				case Opcode.Not:
+					stack [sp - 1] = stack [sp - 1] == 0 ? 1 : 0;
+					continue;
+				}
+
+				b = stack [--sp];
+				a = stack [sp - 1];
+
+				switch (opcode) {
+				case Opcode.Add:
+					a += b;
+					break;
+				case Opcode.Equal:
+					a = a == b ? 1 : 0;
+					break;
+				case Opcode.NotEqual:
+					a = a != b ? 1 : 0;
+					break;
+				case Opcode.Less:
+					a = a < b ? 1 : 0;
+					break;
+				case Opcode.LessEqual:
+					a = a <= b ? 1 : 0;
+					break;
+				case Opcode.Greater:
+					a = a > b ? 1 : 0;
+					break;
+				case Opcode.GreaterEqual:
+					a = a >= b ? 1 : 0;
+					break;
+				case Opcode.And:
+					a = (a != 0) && (b != 0) ? 1 : 0;
+					break;
+				case Opcode.Or:
+					a = (a != 0) || (b != 0) ? 1 : 0;
+					break;
+				default:
+					throw new InternalError ();
+				}
+
+				stack [sp - 1] = a;
+			}
+
+			return stack [0] != 0;
+		}
+
+		static long load (Inferior inferior, long address, byte size)
+		{
+			bool sign_extend = (size & SignExtend) != 0;
+			size &= unchecked ((byte) ~SignExtend);
+
+			TargetAddress addr = new TargetAddress (inferior.AddressDomain, address);
+			byte[] data = inferior.ReadBuffer (addr, size);
+
+			switch (size) {
+			case 1:
+				return sign_extend ? (sbyte) data [0] : data [0];
+			case 2:
+				return sign_extend ? BitConverter.ToInt16 (data, 0) : BitConverter.ToUInt16 (data, 0);
+			case 4:
+				return sign_extend ? BitConverter.ToInt32 (data, 0) : BitConverter.ToUInt32 (data, 0);
+			default:
+				return BitConverter.ToInt64 (data, 0);
+			}
+		}
+
+		//
+		// Parsing.
+		//
+		// The syntax is a C-like expression over numbers, registers and memory:
+		//
+		//   $REGISTER, NUMBER, memSIZE[EXPR] (sign-extended), umemSIZE[EXPR],
+		//   ( ), !, +, - NUMBER, ==, !=, <, <=, >, >=, && and ||
+		//
+		// with SIZE being 1, 2, 4 or 8 bytes; for instance `mem4[$rbp-20] == 5'.
+		//
+
+		// <summary>
+		//   Create a condition from its textual form; throws an ArgumentException
+		//   if it's invalid.
+		// </summary>
+		public static BreakpointCondition Parse (string text)
+		{
+			BreakpointCondition condition = new BreakpointCondition ();
+			Parser parser = new Parser (condition, text);
+
+			try {
+				parser.ParseOr ();
+			} catch (InvalidOperationException ex) {
+				throw new ArgumentException (ex.Message);
+			}
+
+			if (!parser.AtEnd)
+				throw parser.Error ();
+
+			condition.text = text;
+			return condition;
+		}
+
+		class Parser
+		{
+			BreakpointCondition condition;
+			string text;
+			int pos;
+
+			public Parser (BreakpointCondition condition, string text)
+			{
+				this.condition = condition;
+				this.text = text;
+			}
+
+			public bool AtEnd {
+				get {
+					skip_whitespace ();
+					return pos == text.Length;
+				}
+			}
+
+			public ArgumentException Error ()
+			{
+				return new ArgumentException (String.Format (
+					"Invalid breakpoint condition `{0}' at position {1}.", text, pos));
+			}
+
+			void skip_whitespace ()
+			{
+				while ((pos < text.Length) && Char.IsWhiteSpace (text [pos]))
+					pos++;
+			}
+
+			bool accept (string token)
+			{
+				skip_whitespace ();
+				if (String.CompareOrdinal (text, pos, token, 0, token.Length) != 0)
+					return false;
+				pos += token.Length;
+				return true;
+			}
+
+			void expect (string token)
+			{
+				if (!accept (token))
+					throw Error ();
+			}
+
+			public void ParseOr ()
+			{
+				ParseAnd ();
+				while (accept ("||")) {
+					ParseAnd ();
+					condition.Or ();
+				}
+			}
+
+			void ParseAnd ()
+			{
+				ParseComparison ();
+				while (accept ("&&")) {
+					ParseComparison ();
+					condition.And ();
+				}
+			}
+
+			void ParseComparison ()
+			{
+				ParseSum ();
+
+				if (accept ("==")) {
+					ParseSum ();
+					condition.Equal ();
+				} else if (accept ("!=")) {
+					ParseSum ();
+					condition.NotEqual ();
+				} else if (accept ("<=")) {
+					ParseSum ();
+					condition.LessEqual ();
+				} else if (accept (">=")) {
+					ParseSum ();
+					condition.GreaterEqual ();
+				} else if (accept ("<")) {
+					ParseSum ();
+					condition.Less ();
+				} else if (accept (">")) {
+					ParseSum ();
+					condition.Greater ();
+				}
+			}
+
+			void ParseSum ()
+			{
+				ParseUnary ();
+
+				for (;;) {
+					if (accept ("+")) {
+						ParseUnary ();
+						condition.Add ();
+					} else if (accept ("-")) {
+						// There's no subtraction, but we can add the negated constant.
+						condition.Constant (-ParseNumber ());
+						condition.Add ();
+					} else
+						break;
+				}
+			}
+
+			void ParseUnary ()
+			{
+				if (accept ("!")) {
+					ParseUnary ();
+					condition.Not ();
+				} else
+					ParsePrimary ();
+			}
+
+			void ParsePrimary ()
+			{
+				if (accept ("(")) {
+					ParseOr ();
+					expect (")");
+				} else if (accept ("$")) {
+					condition.Register (ParseIdentifier ());
+				} else if (accept ("umem")) {
+					ParseLoad (false);
+				} else if (accept ("mem")) {
+					ParseLoad (true);
+				} else if (accept ("-")) {
+					condition.Constant (-ParseNumber ());
+				} else {
+					condition.Constant (ParseNumber ());
+				}
+			}
+
+			void ParseLoad (bool sign_extend)
+			{
+				int size = (int) ParseNumber ();
+				if ((size != 1) && (size != 2) && (size != 4) && (size != 8))
+					throw Error ();
+
+				expect ("[");
+				ParseOr ();
+				expect ("]");
+				condition.Load (size, sign_extend);
+			}
+
+			string ParseIdentifier ()
+			{
+				int start = pos;
+				while ((pos < text.Length) &&
+				       (Char.IsLetterOrDigit (text [pos]) || (text [pos] == '_')))
+					pos++;
+
+				if (pos == start)
+					throw Error ();
+				return text.Substring (start, pos - start);
+			}
+
+			long ParseNumber ()
+			{
+				skip_whitespace ();
+
+				bool hex = accept ("0x");
+				int start = pos;
+				while ((pos < text.Length) && Uri.IsHexDigit (text [pos]) &&
+				       (hex || Char.IsDigit (text [pos])))
+					pos++;
+
+				long value;
+				string number = text.Substring (start, pos - start);
+				if (hex) {
+					if (!Int64.TryParse (number, NumberStyles.HexNumber,
+							     CultureInfo.InvariantCulture, out value))
+						throw Error ();
+				} else if (!Int64.TryParse (number, out value))
+					throw Error ();
+
+				return value;
+			}
+		}
+	}
+}
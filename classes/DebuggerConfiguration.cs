@@ -122,6 +122,12 @@ namespace Mono.Debugger
 					NestedBreakStates = Boolean.Parse (iter.Current.Value);
 				else if (iter.Current.Name == "RedirectOutput")
 					RedirectOutput = Boolean.Parse (iter.Current.Value);
+				else if (iter.Current.Name == "OutputFlushLatency")
+					OutputFlushLatency = Int32.Parse (iter.Current.Value);
+				else if (iter.Current.Name == "OutputTeeFile")
+					OutputTeeFile = iter.Current.Value;
+				else if (iter.Current.Name == "MemoryCache")
+					MemoryCache = Boolean.Parse (iter.Current.Value);
 				else if (iter.Current.Name == "Martin_Boston_07102008") {
 					; // ignore, this is no longer in use.
 				} else if (iter.Current.Name == "BrokenThreading") {
@@ -219,6 +225,20 @@ namespace Mono.Debugger
 				redirect_output_e.InnerText = RedirectOutput ? "true" : "false";
 				element.AppendChild (redirect_output_e);
 
+				XmlElement output_flush_latency_e = doc.CreateElement ("OutputFlushLatency");
+				output_flush_latency_e.InnerText = OutputFlushLatency.ToString ();
+				element.AppendChild (output_flush_latency_e);
+
+				if (OutputTeeFile != null) {
+					XmlElement output_tee_file_e = doc.CreateElement ("OutputTeeFile");
+					output_tee_file_e.InnerText = OutputTeeFile;
+					element.AppendChild (output_tee_file_e);
+				}
+
+				XmlElement memory_cache_e = doc.CreateElement ("MemoryCache");
+				memory_cache_e.InnerText = MemoryCache ? "true" : "false";
+				element.AppendChild (memory_cache_e);
+
 				XmlElement stop_daemon_threads_e = doc.CreateElement ("StopDaemonThreads");
 				stop_daemon_threads_e.InnerText = (ThreadingModel & ThreadingModel.StopDaemonThreads) != 0 ? "true" : "false";
 				element.AppendChild (stop_daemon_threads_e);
@@ -269,6 +289,9 @@ namespace Mono.Debugger
 		bool stop_on_managed_signals = true;
 		bool nested_break_states = false;
 		bool redirect_output = false;
+		int output_flush_latency = 10;
+		string output_tee_file = null;
+		bool memory_cache = false;
 		bool is_xsp = false;
 		bool is_cli = false;
 		UserNotificationType user_notifications = UserNotificationType.Threads;
@@ -404,6 +427,37 @@ namespace Mono.Debugger
 			set { redirect_output = value; }
 		}
 
+		//
+		// When redirecting the target's output, it is collected and delivered in
+		// batches; this is the maximum delay in milliseconds.
+		//
+		public int OutputFlushLatency {
+			get { return output_flush_latency; }
+			set {
+				if (value < 0)
+					throw new ArgumentOutOfRangeException ();
+				output_flush_latency = value;
+			}
+		}
+
+		//
+		// If set, the target's output is also written to this file, without going
+		// through managed code.
+		//
+		public string OutputTeeFile {
+			get { return output_tee_file; }
+			set { output_tee_file = value; }
+		}
+
+		//
+		// Cache the target's memory page-wise in the native server while all its
+		// threads are stopped.
+		//
+		public bool MemoryCache {
+			get { return memory_cache; }
+			set { memory_cache = value; }
+		}
+
 		/*
 		 * Configurable user notifications.
 		 */
@@ -465,6 +519,12 @@ namespace Mono.Debugger
 
 			sb.Append (String.Format ("  Redirect output (redirect-output):                  {0}\n",
 						  RedirectOutput ? "yes" : "no"));
+			sb.Append (String.Format ("  Output flush latency (output-flush-latency):        {0} ms\n",
+						  OutputFlushLatency));
+			sb.Append (String.Format ("  Copy output to file (output-tee):                   {0}\n",
+						  OutputTeeFile ?? "none"));
+			sb.Append (String.Format ("  Cache target memory (memory-cache):                 {0}\n",
+						  MemoryCache ? "yes" : "no"));
 
 			if (expert_mode) {
 				sb.Append ("\nExpert Settings:\n");
@@ -226,6 +226,13 @@ namespace Mono.Debugger
 			return bpt;
 		}
 
+		public Tracepoint InsertTracepoint (ThreadGroup group, SourceLocation location)
+		{
+			Tracepoint tracepoint = new Tracepoint (this, group, location);
+			AddEvent (tracepoint);
+			return tracepoint;
+		}
+
 		public Event InsertBreakpoint (ThreadGroup group, LocationType type, string name)
 		{
 			Breakpoint bpt = new ExpressionBreakpoint (this, group, type, name);
@@ -245,7 +252,36 @@ namespace Mono.Debugger
 		public Event InsertHardwareWatchPoint (Thread target, TargetAddress address,
 						       HardwareWatchType type)
 		{
-			Event handle = new AddressBreakpoint (type, address);
+			return InsertHardwareWatchPoint (target, address, type, false);
+		}
+
+		// <summary>
+		//   If `changes_only' is true, the watchpoint only stops if the value at
+		//   `address' actually changed.
+		// </summary>
+		public Event InsertHardwareWatchPoint (Thread target, TargetAddress address,
+						       HardwareWatchType type, bool changes_only)
+		{
+			AddressBreakpoint handle = new AddressBreakpoint (type, address);
+			handle.ChangesOnly = changes_only;
+			handle.Activate (target);
+			AddEvent (handle);
+			return handle;
+		}
+
+		// <summary>
+		//   Watch `size' bytes at `address'.  There's no limit on the size or the
+		//   number of these watchpoints since they protect the memory pages instead
+		//   of using the debug registers, but each access to the same pages is a
+		//   bit slow.
+		// </summary>
+		public Event InsertWatchPoint (Thread target, TargetAddress address, int size,
+					       HardwareWatchType type)
+		{
+			if (size <= 0)
+				throw new ArgumentOutOfRangeException ("size");
+
+			Event handle = new AddressBreakpoint (type, address, size);
 			handle.Activate (target);
 			AddEvent (handle);
 			return handle;
@@ -426,6 +462,15 @@ namespace Mono.Debugger
 					throw new InternalError ();
 
 				e.IsEnabled = enabled;
+
+				string condition = event_iter.Current.GetAttribute ("condition", "");
+				if ((condition != "") && (e is Breakpoint))
+					((Breakpoint) e).Condition = BreakpointCondition.Parse (condition);
+
+				string ignore = event_iter.Current.GetAttribute ("ignore", "");
+				if ((ignore != "") && (e is Breakpoint))
+					((Breakpoint) e).IgnoreCount = Int32.Parse (ignore);
+
 				AddEvent (e);
 			}
 		}
@@ -735,45 +780,54 @@ namespace Mono.Debugger
 					sse.Client, FrameType.Special, TargetAddress.Null, TargetAddress.Null,
 					TargetAddress.Null, null, language, new Symbol ("<main>", TargetAddress.Null, 0));
 
-				foreach (var entry in pending_bpts.ToArray ()) {
-					var breakpoint = entry.Key;
-					var action = entry.Value;
-
-					try {
-						BreakpointHandle handle = breakpoint.Resolve (sse.Client, main_frame);
-						if (handle == null)
-							continue;
+				//
+				// Address breakpoints are queued and inserted together when
+				// we're done, see Inferior.BeginBreakpointBatch().
+				//
+				sse.Inferior.BeginBreakpointBatch ();
+				try {
+					foreach (var entry in pending_bpts.ToArray ()) {
+						var breakpoint = entry.Key;
+						var action = entry.Value;
+
+						try {
+							BreakpointHandle handle = breakpoint.Resolve (sse.Client, main_frame);
+							if (handle == null)
+								continue;
+
+							FunctionBreakpointHandle fh = handle as FunctionBreakpointHandle;
+							if (fh == null) {
+								if (action == BreakpointHandle.Action.Insert)
+									handle.Insert (sse.Inferior);
+								else
+									handle.Remove (sse.Inferior);
+								pending_bpts.Remove (breakpoint);
+								continue;
+							}
 
-						FunctionBreakpointHandle fh = handle as FunctionBreakpointHandle;
-						if (fh == null) {
+							pending_bpts.Remove (breakpoint);
 							if (action == BreakpointHandle.Action.Insert)
-								handle.Insert (sse.Inferior);
+								pending_inserts.Add (fh);
 							else
-								handle.Remove (sse.Inferior);
-							pending_bpts.Remove (breakpoint);
-							continue;
-						}
-
-						pending_bpts.Remove (breakpoint);
-						if (action == BreakpointHandle.Action.Insert)
-							pending_inserts.Add (fh);
-						else
-							pending_removals.Add (fh);
-					} catch (TargetException ex) {
-						if (ex.Type == TargetError.LocationInvalid)
-							breakpoint.OnResolveFailed ();
-						else {
+								pending_removals.Add (fh);
+						} catch (TargetException ex) {
+							if (ex.Type == TargetError.LocationInvalid)
+								breakpoint.OnResolveFailed ();
+							else {
+								Console.WriteLine ("EX: {0} {1} {2}", breakpoint, action, ex);
+								breakpoint.OnBreakpointError (
+									"Cannot insert breakpoint {0}: {1}",
+									breakpoint.Index, ex.Message);
+							}
+						} catch (Exception ex) {
 							Console.WriteLine ("EX: {0} {1} {2}", breakpoint, action, ex);
 							breakpoint.OnBreakpointError (
 								"Cannot insert breakpoint {0}: {1}",
 								breakpoint.Index, ex.Message);
 						}
-					} catch (Exception ex) {
-						Console.WriteLine ("EX: {0} {1} {2}", breakpoint, action, ex);
-						breakpoint.OnBreakpointError (
-							"Cannot insert breakpoint {0}: {1}",
-							breakpoint.Index, ex.Message);
 					}
+				} finally {
+					sse.Inferior.EndBreakpointBatch ();
 				}
 			}
 
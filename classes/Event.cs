@@ -125,6 +125,12 @@ namespace Mono.Debugger
 			element.SetAttribute ("threadgroup", ThreadGroup.Name);
 			element.SetAttribute ("enabled", IsEnabled ? "true" : "false");
 
+			Breakpoint bpt = this as Breakpoint;
+			if ((bpt != null) && (bpt.Condition != null) && (bpt.Condition.Text != null))
+				element.SetAttribute ("condition", bpt.Condition.Text);
+			if ((bpt != null) && (bpt.IgnoreCount > 0))
+				element.SetAttribute ("ignore", bpt.IgnoreCount.ToString ());
+
 			GetSessionData (root, element);
 		}
 
@@ -156,6 +156,7 @@ namespace Mono.Debugger
 		SymbolTableManager symtab_manager;
 		MonoThreadManager mono_manager;
 		BreakpointManager breakpoint_manager;
+		MemoryMapIndex memory_map_index;
 		Dictionary<int,ExceptionCatchPoint> exception_handlers;
 		ProcessStart start;
 		DebuggerSession session;
@@ -175,6 +176,7 @@ namespace Mono.Debugger
 		bool initialized;
 		DebuggerMutex thread_lock_mutex;
 		bool has_thread_lock;
+		int running_inferiors;
 
 		private Process (ThreadManager manager, DebuggerSession session)
 		{
@@ -189,6 +191,8 @@ namespace Mono.Debugger
 
 			thread_hash = Hashtable.Synchronized (new Hashtable ());
 
+			memory_map_index = new MemoryMapIndex ();
+
 			target_info = Inferior.GetTargetInfo ();
 			if (target_info.TargetAddressSize == 8)
 				architecture = new Architecture_X86_64 (this, target_info);
@@ -269,6 +273,27 @@ namespace Mono.Debugger
 			get { return breakpoint_manager; }
 		}
 
+		internal MemoryMapIndex MemoryMapIndex {
+			get { return memory_map_index; }
+		}
+
+		//
+		// Called by the Inferior each time one of our threads is resumed or
+		// stops.  The target's memory may only be cached while none of them is
+		// running; a thread which never stopped may modify it at any time.
+		//
+		internal void OnInferiorStateChanged (bool running)
+		{
+			if (running)
+				ST.Interlocked.Increment (ref running_inferiors);
+			else
+				ST.Interlocked.Decrement (ref running_inferiors);
+		}
+
+		internal bool IsStopped {
+			get { return ST.Thread.VolatileRead (ref running_inferiors) == 0; }
+		}
+
 		internal SymbolTableManager SymbolTableManager {
 			get {
 				return symtab_manager;
@@ -379,6 +404,8 @@ namespace Mono.Debugger
 		{
 			is_execed = true;
 
+			memory_map_index.Invalidate ();
+
 			if (!is_forked) {
 				if (mono_language != null)
 					mono_language.Dispose();
@@ -761,6 +788,41 @@ namespace Mono.Debugger
 			}
 		}
 
+		// <summary>
+		//   How often `breakpoint' has been hit in this process, including the
+		//   hits which the debugger server ignored without reporting them.
+		// </summary>
+		public int GetHitCount (Breakpoint breakpoint)
+		{
+			return breakpoint_manager.GetHitCount (breakpoint);
+		}
+
+		// <summary>
+		//   How many more hits of `breakpoint' the debugger server is going to
+		//   ignore in this process, summed over all its locations.
+		// </summary>
+		public int GetIgnoreCount (Breakpoint breakpoint)
+		{
+			return breakpoint_manager.GetIgnoreCount (breakpoint);
+		}
+
+		// <summary>
+		//   The state of the debugger server's tracepoint buffer.
+		// </summary>
+		public TraceStatus GetTraceStatus ()
+		{
+			return breakpoint_manager.GetTraceStatus ();
+		}
+
+		// <summary>
+		//   Remove all frames which have been collected by tracepoints so far from
+		//   the debugger server's buffer.
+		// </summary>
+		public TraceFrame[] ReadTraceFrames ()
+		{
+			return breakpoint_manager.ReadTraceFrames (architecture, manager.AddressDomain);
+		}
+
 		internal bool HasThreadLock {
 			get { return has_thread_lock; }
 		}
@@ -779,11 +841,20 @@ namespace Mono.Debugger
 			Report.Debug (DebugFlags.Threads,
 				      "Acquiring global thread lock: {0}", caller);
 			has_thread_lock = true;
+
+			List<SingleSteppingEngine> engines = new List<SingleSteppingEngine> ();
 			foreach (ThreadServant thread in thread_hash.Values) {
 				if (thread == caller)
 					continue;
-				thread.AcquireThreadLock ();
+
+				SingleSteppingEngine engine = thread as SingleSteppingEngine;
+				if (engine != null)
+					engines.Add (engine);
+				else
+					thread.AcquireThreadLock ();
 			}
+
+			SingleSteppingEngine.AcquireThreadLocks (engines.ToArray ());
 			Report.Debug (DebugFlags.Threads,
 				      "Done acquiring global thread lock: {0}",
 				      caller);
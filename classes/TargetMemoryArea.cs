@@ -5,7 +5,8 @@ namespace Mono.Debugger
 	[Flags]
 	public enum TargetMemoryFlags
 	{
-		ReadOnly	= 1
+		ReadOnly	= 1,
+		Executable	= 2
 	}
 
 	public sealed class TargetMemoryArea
@@ -254,6 +254,16 @@ namespace Mono.Debugger
 			return servant.GetMemoryMaps ();
 		}
 
+		// <summary>
+		//   Returns the memory area containing `address' or null if it's not
+		//   mapped; this is much cheaper than searching GetMemoryMaps().
+		// </summary>
+		public TargetMemoryArea FindMemoryArea (TargetAddress address)
+		{
+			check_servant ();
+			return servant.FindMemoryArea (address);
+		}
+
 		public Method Lookup (TargetAddress address)
 		{
 			check_servant ();
@@ -461,6 +471,12 @@ namespace Mono.Debugger
 				servant.RemoveBreakpoint (handle);
 		}
 
+		internal void UpdateIgnoreCount (Breakpoint breakpoint, int count)
+		{
+			check_alive ();
+			servant.UpdateIgnoreCount (breakpoint, count);
+		}
+
 		public string PrintObject (Style style, TargetObject obj, DisplayFormat format)
 		{
 			check_alive ();
@@ -725,6 +741,12 @@ namespace Mono.Debugger
 			return servant.ReadString (address);
 		}
 
+		public string ReadString (TargetAddress address, int max_length)
+		{
+			check_alive ();
+			return servant.ReadString (address, max_length);
+		}
+
 		public TargetBlob ReadMemory (TargetAddress address, int size)
 		{
 			check_alive ();
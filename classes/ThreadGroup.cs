@@ -7,6 +7,8 @@ using Mono.Debugger.Backend;
 
 namespace Mono.Debugger
 {
+	internal delegate void ThreadGroupHandler (ThreadGroup group);
+
 	// <summary>
 	//   This is used to share information about breakpoints and signal handlers
 	//   between different invocations of the same target.
@@ -40,6 +42,7 @@ namespace Mono.Debugger
 
 			if (!threads.Contains (id))
 				threads.Add (id, true);
+			OnThreadsChanged ();
 		}
 
 		public void RemoveThread (int id)
@@ -48,6 +51,20 @@ namespace Mono.Debugger
 				throw new InvalidOperationException ();
 
 			threads.Remove (id);
+			OnThreadsChanged ();
+		}
+
+		// <summary>
+		//   Raised when a thread is added to or removed from this group, so the
+		//   breakpoint managers can update the debugger server's thread filters.
+		// </summary>
+		internal event ThreadGroupHandler ThreadsChangedEvent;
+
+		void OnThreadsChanged ()
+		{
+			ThreadGroupHandler handler = ThreadsChangedEvent;
+			if (handler != null)
+				handler (this);
 		}
 
 		public int[] Threads {
@@ -0,0 +1,171 @@
+using System;
+using System.IO;
+using System.Collections.Generic;
+
+using Mono.Debugger.Backend;
+using Mono.Debugger.Architectures;
+
+namespace Mono.Debugger
+{
+	// <summary>
+	//   A breakpoint which doesn't stop the target, but only collects some registers
+	//   and memory into the debugger server's trace buffer each time it's hit.
+	// </summary>
+	// <remarks>
+	//   The debugger server collects the data and resumes the target itself, so
+	//   this is cheap enough to be used on busy code paths.  Use
+	//   Process.ReadTraceFrames() to retrieve the collected data.
+	// </remarks>
+	public class Tracepoint : SourceBreakpoint
+	{
+		List<MemoryAction> memory = new List<MemoryAction> ();
+		bool collect_registers = true;
+
+		[Serializable]
+		struct MemoryAction
+		{
+			public readonly string Register;
+			public readonly long Offset;
+			public readonly int Size;
+
+			public MemoryAction (string register, long offset, int size)
+			{
+				this.Register = register;
+				this.Offset = offset;
+				this.Size = size;
+			}
+		}
+
+		// Must match `TracepointActionOpcode' in the server's breakpoints.h.
+		const byte ActionRegisters = 1;
+		const byte ActionMemory = 2;
+
+		public const int MaxMemorySize = 4096;
+
+		public Tracepoint (DebuggerSession session, ThreadGroup group,
+				   SourceLocation location)
+			: base (session, group, location)
+		{ }
+
+		public override bool IsPersistent {
+			get { return false; }
+		}
+
+		public bool CollectRegisters {
+			get { return collect_registers; }
+			set { collect_registers = value; }
+		}
+
+		// <summary>
+		//   Collect `size' bytes at `offset' relative to `register', which is one
+		//   of the architecture's register names.  If `register' is null, `offset'
+		//   is an absolute address.
+		// </summary>
+		public void CollectMemory (string register, long offset, int size)
+		{
+			if ((size <= 0) || (size > MaxMemorySize))
+				throw new ArgumentOutOfRangeException ("size");
+
+			memory.Add (new MemoryAction (register, offset, size));
+		}
+
+		internal byte[] GetActionCode (Architecture arch)
+		{
+			using (MemoryStream stream = new MemoryStream ()) {
+				if (collect_registers)
+					stream.WriteByte (ActionRegisters);
+
+				foreach (MemoryAction action in memory) {
+					int regnum = -1;
+					if (action.Register != null) {
+						regnum = Array.IndexOf (arch.RegisterNames, action.Register);
+						if (regnum < 0)
+							throw new TargetException (
+								TargetError.NoSuchRegister, "No such register: `{0}'.",
+								action.Register);
+					}
+
+					stream.WriteByte (ActionMemory);
+					stream.Write (BitConverter.GetBytes (regnum), 0, 4);
+					stream.Write (BitConverter.GetBytes (action.Offset), 0, 8);
+					stream.Write (BitConverter.GetBytes (action.Size), 0, 4);
+				}
+
+				return stream.ToArray ();
+			}
+		}
+
+		public override bool CheckBreakpointHit (Thread target, TargetAddress address)
+		{
+			// We only get here if the server couldn't resume the target by itself;
+			// it already collected the data.
+			return false;
+		}
+	}
+
+	[Serializable]
+	public sealed class TraceMemoryBlock
+	{
+		public readonly TargetAddress Address;
+
+		// <summary>
+		//   The memory contents or null if it could not be read.
+		// </summary>
+		public readonly byte[] Data;
+
+		internal TraceMemoryBlock (TargetAddress address, byte[] data)
+		{
+			this.Address = address;
+			this.Data = data;
+		}
+	}
+
+	[Serializable]
+	public sealed class TraceFrame
+	{
+		// <summary>
+		//   The index of the Tracepoint or -1 if it has been deleted since.
+		// </summary>
+		public readonly int Tracepoint;
+
+		// <summary>
+		//   The LWP of the thread which hit the tracepoint.
+		// </summary>
+		public readonly int ThreadLWP;
+
+		// <summary>
+		//   The register names and values or null if no registers were collected.
+		// </summary>
+		public readonly string[] RegisterNames;
+		public readonly long[] Registers;
+
+		public readonly TraceMemoryBlock[] Memory;
+
+		internal TraceFrame (int tracepoint, int lwp, string[] register_names,
+				     long[] registers, TraceMemoryBlock[] memory)
+		{
+			this.Tracepoint = tracepoint;
+			this.ThreadLWP = lwp;
+			this.RegisterNames = register_names;
+			this.Registers = registers;
+			this.Memory = memory;
+		}
+	}
+
+	[Serializable]
+	public sealed class TraceStatus
+	{
+		public readonly int Frames;
+		public readonly int Used;
+		public readonly int Size;
+		public readonly int Dropped;
+
+		internal TraceStatus (int frames, int used, int size, int dropped)
+		{
+			this.Frames = frames;
+			this.Used = used;
+			this.Size = size;
+			this.Dropped = dropped;
+		}
+	}
+}
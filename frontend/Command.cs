@@ -5,6 +5,7 @@ using System.IO;
 using System.Threading;
 using System.Reflection;
 using System.Collections;
+using System.Collections.Generic;
 using System.Globalization;
 using System.Text.RegularExpressions;
 using SD = System.Diagnostics;
@@ -65,10 +66,14 @@ namespace Mono.Debugger.Frontend
 			RegisterCommand ("activate", typeof (BreakpointActivateCommand));
 			RegisterCommand ("deactivate", typeof (BreakpointDeactivateCommand));
 			RegisterCommand ("delete", typeof (BreakpointDeleteCommand));
+			RegisterCommand ("ignore", typeof (BreakpointIgnoreCommand));
 			RegisterCommand ("list", typeof (ListCommand));
 			RegisterAlias   ("l", typeof (ListCommand));
 			RegisterCommand ("break", typeof (BreakCommand));
 			RegisterAlias   ("b", typeof (BreakCommand));
+			RegisterCommand ("trace", typeof (TraceCommand));
+			RegisterCommand ("tstatus", typeof (TraceStatusCommand));
+			RegisterCommand ("tdump", typeof (TraceDumpCommand));
 			RegisterCommand ("display", typeof (DisplayCommand));
 			RegisterAlias   ("d", typeof (DisplayCommand));
 			RegisterCommand ("undisplay", typeof (UndisplayCommand));
@@ -2795,6 +2800,55 @@ namespace Mono.Debugger.Frontend
 		public string Documentation { get { return ""; } }
 	}
 
+	public class BreakpointIgnoreCommand : DebuggerCommand, IDocumentableCommand
+	{
+		Breakpoint breakpoint;
+		int count;
+
+		protected override bool DoResolve (ScriptingContext context)
+		{
+			if ((Args == null) || (Args.Count != 2))
+				throw new ScriptingException ("Argument expected: BREAKPOINT COUNT");
+
+			int index;
+			if (!Int32.TryParse ((string) Args [0], out index))
+				throw new ScriptingException ("Breakpoint number expected.");
+			if (!Int32.TryParse ((string) Args [1], out count) || (count < 0))
+				throw new ScriptingException ("Invalid ignore count: `{0}'.", Args [1]);
+
+			breakpoint = context.Interpreter.GetEvent (index) as Breakpoint;
+			if (breakpoint == null)
+				throw new ScriptingException ("Event {0} is not a breakpoint.", index);
+
+			return true;
+		}
+
+		protected override object DoExecute (ScriptingContext context)
+		{
+			Thread thread = null;
+			if (context.Interpreter.HasTarget && breakpoint.IsActivated)
+				thread = context.Interpreter.CurrentThread;
+
+			breakpoint.Ignore (thread, count);
+
+			if (count == 0)
+				context.Print ("Will stop next time breakpoint {0} is reached.",
+					       breakpoint.Index);
+			else
+				context.Print ("Will ignore next {0} crossings of breakpoint {1}.",
+					       count, breakpoint.Index);
+			return null;
+		}
+
+		// IDocumentableCommand
+		public CommandFamily Family { get { return CommandFamily.Breakpoints; } }
+		public string Description { get { return "Ignore the next hits of a breakpoint."; } }
+		public string Documentation { get { return
+					"`ignore BREAKPOINT COUNT' doesn't stop the next COUNT times\n" +
+					"BREAKPOINT is reached; the debugger server skips these hits\n" +
+					"without stopping the target where possible."; } }
+	}
+
 	public abstract class SourceCommand : FrameCommand
 	{
 		protected LocationType type = LocationType.Method;
@@ -3083,6 +3137,7 @@ namespace Mono.Debugger.Frontend
 		bool lazy, gui;
 		int domain = 0;
 		ThreadGroup tgroup;
+		BreakpointCondition condition;
 
 		public string Group {
 			get { return group; }
@@ -3159,8 +3214,45 @@ namespace Mono.Debugger.Frontend
 			set { f_index = value; }
 		}
 
+		protected SourceLocation ResolvedLocation {
+			get { return location; }
+		}
+
+		protected ThreadGroup ResolvedThreadGroup {
+			get { return tgroup; }
+		}
+
+		protected BreakpointCondition ResolvedCondition {
+			get { return condition; }
+		}
+
+		// break LOCATION if CONDITION
+		void ParseCondition ()
+		{
+			condition = null;
+
+			int pos = Args != null ? Args.IndexOf ("if") : -1;
+			if (pos < 0)
+				return;
+
+			ArrayList words_list = Args.GetRange (pos + 1, Args.Count - pos - 1);
+			string[] words = (string []) words_list.ToArray (typeof (string));
+			Args.RemoveRange (pos, Args.Count - pos);
+
+			if ((pos == 0) || (words.Length == 0))
+				throw new ScriptingException ("Invalid breakpoint expression");
+
+			try {
+				condition = BreakpointCondition.Parse (String.Join (" ", words));
+			} catch (ArgumentException ex) {
+				throw new ScriptingException (ex.Message);
+			}
+		}
+
 		protected override bool DoResolve (ScriptingContext context)
 		{
+			ParseCondition ();
+
 			if (global) {
 				if (local)
 					throw new ScriptingException (
@@ -3284,6 +3376,9 @@ namespace Mono.Debugger.Frontend
 				context.Print ("Breakpoint {0} at {1}", handle.Index, Argument);
 			}
 
+			if (condition != null)
+				((Breakpoint) handle).Condition = condition;
+
 			if (gui) {
 				context.ActivatePendingBreakpoints ();
 				return handle.Index;
@@ -3311,6 +3406,189 @@ namespace Mono.Debugger.Frontend
 		// IDocumentableCommand
 		public CommandFamily Family { get { return CommandFamily.Breakpoints; } }
 		public string Description { get { return "Insert breakpoint."; } }
+		public string Documentation { get { return
+					"`break LOCATION if CONDITION' only stops if CONDITION is true;\n" +
+					"the debugger server evaluates it without stopping the target.\n" +
+					"CONDITION is a simple expression over numbers, registers and\n" +
+					"memory, like `mem4[$rbp-20] == 5 && $rax != 0'.  Use memSIZE[ADDRESS]\n" +
+					"to read a signed and umemSIZE[ADDRESS] to read an unsigned integer\n" +
+					"of 1, 2, 4 or 8 bytes."; } }
+	}
+
+	public class TraceCommand : BreakCommand, IDocumentableCommand
+	{
+		string memory;
+		bool no_registers;
+		List<MemorySpec> memory_specs = new List<MemorySpec> ();
+
+		struct MemorySpec
+		{
+			public string Register;
+			public long Offset;
+			public int Size;
+		}
+
+		public string Memory {
+			get { return memory; }
+			set { memory = value; }
+		}
+
+		public bool NoRegisters {
+			get { return no_registers; }
+			set { no_registers = value; }
+		}
+
+		protected override bool DoResolve (ScriptingContext context)
+		{
+			if (Lazy || GUI)
+				throw new ScriptingException ("Tracepoints can't be lazy.");
+
+			if (!base.DoResolve (context))
+				return false;
+
+			if (ResolvedLocation == null)
+				throw new ScriptingException (
+					"Tracepoints can only be inserted at a method or source " +
+					"line of a running target.");
+
+			memory_specs.Clear ();
+			if (memory != null) {
+				foreach (string spec in memory.Split (','))
+					memory_specs.Add (ParseMemorySpec (spec.Trim ()));
+			}
+
+			return true;
+		}
+
+		// REGISTER[+-OFFSET]:SIZE or ADDRESS:SIZE
+		static MemorySpec ParseMemorySpec (string spec)
+		{
+			MemorySpec result = new MemorySpec ();
+
+			int pos = spec.LastIndexOf (':');
+			if ((pos <= 0) || !Int32.TryParse (spec.Substring (pos + 1), out result.Size) ||
+			    (result.Size <= 0) || (result.Size > Tracepoint.MaxMemorySize))
+				throw new ScriptingException ("Invalid memory range: `{0}'.", spec);
+
+			string location = spec.Substring (0, pos).TrimStart ('$');
+			if (Char.IsDigit (location [0])) {
+				result.Offset = ParseNumber (spec, location);
+				return result;
+			}
+
+			pos = location.IndexOfAny (new char[] { '+', '-' });
+			if (pos < 0) {
+				result.Register = location;
+				return result;
+			}
+
+			result.Register = location.Substring (0, pos);
+			result.Offset = ParseNumber (spec, location.Substring (pos + 1));
+			if (location [pos] == '-')
+				result.Offset = -result.Offset;
+			return result;
+		}
+
+		static long ParseNumber (string spec, string number)
+		{
+			long value;
+			bool ok;
+			if (number.StartsWith ("0x"))
+				ok = Int64.TryParse (number.Substring (2), NumberStyles.HexNumber,
+						     CultureInfo.InvariantCulture, out value);
+			else
+				ok = Int64.TryParse (number, out value);
+			if (!ok)
+				throw new ScriptingException ("Invalid memory range: `{0}'.", spec);
+			return value;
+		}
+
+		protected override object DoExecute (ScriptingContext context)
+		{
+			Tracepoint tracepoint = context.Interpreter.Session.InsertTracepoint (
+				ResolvedThreadGroup, ResolvedLocation);
+			tracepoint.Condition = ResolvedCondition;
+			tracepoint.CollectRegisters = !no_registers;
+			foreach (MemorySpec spec in memory_specs)
+				tracepoint.CollectMemory (spec.Register, spec.Offset, spec.Size);
+
+			context.Print ("Tracepoint {0} at {1}", tracepoint.Index, ResolvedLocation.Name);
+			tracepoint.Activate (context.Interpreter.CurrentThread);
+			return tracepoint.Index;
+		}
+
+		// IDocumentableCommand
+		public new CommandFamily Family { get { return CommandFamily.Breakpoints; } }
+		public new string Description { get { return "Insert a tracepoint."; } }
+		public new string Documentation { get { return
+					"Like `break', but doesn't stop the target.  Instead, each hit\n" +
+					"collects the registers and the memory ranges given with\n" +
+					"`-memory REGISTER[+-OFFSET]:SIZE,ADDRESS:SIZE,...' into the\n" +
+					"trace buffer; use `-noregisters' to skip the registers.\n" +
+					"See `tstatus' and `tdump'."; } }
+	}
+
+	public class TraceStatusCommand : ProcessCommand, IDocumentableCommand
+	{
+		protected override object DoExecute (ScriptingContext context)
+		{
+			TraceStatus status = CurrentProcess.GetTraceStatus ();
+			context.Print ("Trace buffer: {0} frames, {1} of {2} bytes used, {3} frames dropped.",
+				       status.Frames, status.Used, status.Size, status.Dropped);
+			return status;
+		}
+
+		// IDocumentableCommand
+		public CommandFamily Family { get { return CommandFamily.Breakpoints; } }
+		public string Description { get { return "Show the state of the trace buffer."; } }
+		public string Documentation { get { return ""; } }
+	}
+
+	public class TraceDumpCommand : ProcessCommand, IDocumentableCommand
+	{
+		protected override object DoExecute (ScriptingContext context)
+		{
+			TraceFrame[] frames = CurrentProcess.ReadTraceFrames ();
+			if (frames.Length == 0) {
+				context.Print ("No trace frames.");
+				return frames;
+			}
+
+			for (int i = 0; i < frames.Length; i++) {
+				TraceFrame frame = frames [i];
+				context.Print ("Frame {0}: tracepoint {1}, LWP {2}", i,
+					       frame.Tracepoint, frame.ThreadLWP);
+
+				if (frame.Registers != null) {
+					StringBuilder sb = new StringBuilder ();
+					for (int j = 0; j < frame.Registers.Length; j++) {
+						sb.Append (String.Format ("{0,6}={1:x}", frame.RegisterNames [j],
+									  frame.Registers [j]));
+						if ((j % 4) == 3 || (j == frame.Registers.Length - 1)) {
+							context.Print ("  {0}", sb.ToString ());
+							sb.Length = 0;
+						} else
+							sb.Append ("  ");
+					}
+				}
+
+				foreach (TraceMemoryBlock block in frame.Memory) {
+					if (block.Data == null) {
+						context.Print ("  {0}: <unreadable>", block.Address);
+						continue;
+					}
+
+					context.Print ("  {0}: {1}", block.Address,
+						       BitConverter.ToString (block.Data).Replace ('-', ' '));
+				}
+			}
+
+			return frames;
+		}
+
+		// IDocumentableCommand
+		public CommandFamily Family { get { return CommandFamily.Breakpoints; } }
+		public string Description { get { return "Print and remove all frames from the trace buffer."; } }
 		public string Documentation { get { return ""; } }
 	}
 
@@ -3387,6 +3665,18 @@ namespace Mono.Debugger.Frontend
 	{
 		Expression expression;
 		TargetAddress address;
+		int size;
+		bool changes;
+
+		public int Size {
+			get { return size; }
+			set { size = value; }
+		}
+
+		public bool Changes {
+			get { return changes; }
+			set { changes = true; }
+		}
 
 		protected override bool DoResolve (ScriptingContext context)
 		{
@@ -3413,9 +3703,20 @@ namespace Mono.Debugger.Frontend
 				address = pexp.EvaluateAddress (context);
 			}
 
-			int index = context.Interpreter.InsertHardwareWatchPoint (CurrentThread, address);
-			context.Print ("Hardware watchpoint {0} at {1}", index, address);
-			return index;
+			if ((size > 0) && changes)
+				throw new ScriptingException (
+					"Can't use `-changes' together with `-size'.");
+
+			if (size > 0) {
+				int index = context.Interpreter.InsertWatchPoint (CurrentThread, address, size);
+				context.Print ("Watchpoint {0} at {1} ({2} bytes)", index, address, size);
+				return index;
+			} else {
+				int index = context.Interpreter.InsertHardwareWatchPoint (
+					CurrentThread, address, changes);
+				context.Print ("Hardware watchpoint {0} at {1}", index, address);
+				return index;
+			}
 
 		}
 
@@ -3427,7 +3728,16 @@ namespace Mono.Debugger.Frontend
 		// IDocumentableCommand
 		public CommandFamily Family { get { return CommandFamily.Catchpoints; } }
 		public string Description { get { return "Insert a hardware watchpoint."; } }
-		public string Documentation { get { return ""; } }
+		public string Documentation { get { return
+						"Stops when the target writes to the location.  If all the\n" +
+						"debug registers are in use or `-size' is given, the debugger\n" +
+						"protects the memory pages instead, which works for any number\n" +
+						"of watchpoints and any size, but slows down other accesses to\n" +
+						"the same pages.  This doesn't work on a thread's stack, and\n" +
+						"system calls which write to a protected page fail with EFAULT\n" +
+						"instead of stopping.\n\n" +
+						"With `-changes', only stops if the value actually changed\n" +
+						"and not each time the same value is written again."; } }
 	}
 
 	public class DumpCommand : NestedCommand, IDocumentableCommand
@@ -3845,6 +4155,20 @@ namespace Mono.Debugger.Frontend
 					continue;
 				}
 
+				if (arg.StartsWith ("output-flush-latency=")) {
+					int latency;
+					if (!Int32.TryParse (arg.Substring (21), out latency) || (latency < 0))
+						throw new ScriptingException ("Invalid 'output-flush-latency' option '{0}'.", arg.Substring (21));
+					config.OutputFlushLatency = latency;
+					continue;
+				}
+
+				if (arg.StartsWith ("output-tee=")) {
+					string arg1 = arg.Substring (11);
+					config.OutputTeeFile = arg1 != "" ? arg1 : null;
+					continue;
+				}
+
 				if ((arg [0] != '+') && (arg [0] != '-'))
 					throw new ScriptingException ("Expected `+option' or `-option'.");
 
@@ -3872,6 +4196,10 @@ namespace Mono.Debugger.Frontend
 					config.RedirectOutput = enable;
 					break;
 
+				case "memory-cache":
+					config.MemoryCache = enable;
+					break;
+
 				case "stop-daemon":
 					require_expert_mode ();
 					if (enable)
@@ -446,6 +446,8 @@ namespace Mono.Debugger.Frontend
 
 				if (handle is ExceptionCatchPoint)
 					type = "catch";
+				else if (handle is Tracepoint)
+					type = "trace";
 				else
 					type = "break";
 
@@ -455,9 +457,46 @@ namespace Mono.Debugger.Frontend
 				       handle.IsActivated ? "y" : "n",
 				       handle.ThreadGroup != null ? handle.ThreadGroup.Name : "global",
 				       handle.Name);
+
+				Breakpoint bpt = handle as Breakpoint;
+				if (bpt == null)
+					continue;
+
+				int hit_count = GetHitCount (bpt);
+				if (hit_count > 0)
+					Print ("\tbreakpoint already hit {0} time(s)", hit_count);
+				int ignore_count = GetIgnoreCount (bpt);
+				if (ignore_count > 0)
+					Print ("\tignore next {0} hits", ignore_count);
 			}
 		}
 
+		//
+		// The server counts the hits itself, so Breakpoint.HitCount is only
+		// up-to-date when the breakpoint was last reported to us.
+		//
+		int GetHitCount (Breakpoint bpt)
+		{
+			if (!HasTarget || !bpt.IsActivated)
+				return bpt.HitCount;
+
+			int hit_count = 0;
+			foreach (Process process in Processes)
+				hit_count += process.GetHitCount (bpt);
+			return hit_count;
+		}
+
+		int GetIgnoreCount (Breakpoint bpt)
+		{
+			if (!HasTarget || !bpt.IsActivated)
+				return bpt.IgnoreCount;
+
+			int ignore_count = 0;
+			foreach (Process process in Processes)
+				ignore_count += process.GetIgnoreCount (bpt);
+			return ignore_count;
+		}
+
 		public Event GetEvent (int index)
 		{
 			Event handle = Session.GetEvent (index);
@@ -677,9 +716,22 @@ namespace Mono.Debugger.Frontend
 		}
 
 		public int InsertHardwareWatchPoint (Thread target, TargetAddress address)
+		{
+			return InsertHardwareWatchPoint (target, address, false);
+		}
+
+		public int InsertHardwareWatchPoint (Thread target, TargetAddress address,
+						     bool changes_only)
 		{
 			Event handle = target.Process.Session.InsertHardwareWatchPoint (
-				target, address, HardwareWatchType.WatchWrite);
+				target, address, HardwareWatchType.WatchWrite, changes_only);
+			return handle.Index;
+		}
+
+		public int InsertWatchPoint (Thread target, TargetAddress address, int size)
+		{
+			Event handle = target.Process.Session.InsertWatchPoint (
+				target, address, size, HardwareWatchType.WatchWrite);
 			return handle.Index;
 		}
 
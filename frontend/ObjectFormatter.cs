@@ -238,8 +238,10 @@ namespace Mono.Debugger.Frontend
 			bool first = true;
 
 			TargetClass class_info = obj.Type.GetClass (target);
-			if (class_info != null)
+			if (class_info != null) {
+				obj.Prefetch (target);
 				FormatClassObject (target, obj, class_info, ref first);
+			}
 		}
 
 		protected void FormatClassObject (Thread target, TargetClassObject obj,
@@ -353,8 +355,10 @@ namespace Mono.Debugger.Frontend
 			TargetArrayBounds bounds = aobj.GetArrayBounds (target);
 			if (bounds.IsUnbound)
 				Append ("[ ]");
-			else
+			else {
+				aobj.Prefetch (target);
 				FormatArray (target, aobj, bounds, 0, new int [0]);
+			}
 		}
 
 		protected void FormatArray (Thread target, TargetArrayObject aobj,
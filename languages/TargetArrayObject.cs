@@ -1,4 +1,7 @@
 using System;
+using System.Collections.Generic;
+
+using Mono.Debugger.Backend;
 
 namespace Mono.Debugger.Languages
 {
@@ -94,6 +97,81 @@ namespace Mono.Debugger.Languages
 
 		internal abstract TargetObject GetElement (TargetMemoryAccess target, int[] indices);
 
+		// We don't prefetch more than this many bytes of elements.
+		const int MaxPrefetchSize = 65536;
+
+		// <summary>
+		//   Tell the target that we're about to read the elements and - if they're
+		//   references - the objects they point to, so it can read them in a few
+		//   batches.  This is only a hint; target errors are ignored.
+		// </summary>
+		public void Prefetch (Thread thread)
+		{
+			try {
+				thread.ThreadServant.DoTargetAccess (
+					delegate (TargetMemoryAccess target) {
+						Prefetch (target);
+						return null;
+				});
+			} catch (TargetException) {
+				// Reading the elements will report any errors.
+			}
+		}
+
+		internal void Prefetch (TargetMemoryAccess target)
+		{
+			// This only pays off if the target keeps what we read.
+			CachingTargetMemoryAccess cache = target as CachingTargetMemoryAccess;
+			if ((cache == null) || !cache.CanCache)
+				return;
+
+			if (!Location.HasAddress || !GetArrayBounds (target) || bounds.IsUnbound)
+				return;
+
+			TargetAddress data;
+			long size;
+
+			if (Type.HasFixedSize) {
+				// Native arrays: the elements are right here.
+				data = Location.GetAddress (target);
+				size = Type.Size;
+			} else {
+				TargetLocation data_location;
+				TargetBlob blob = Location.ReadMemory (target, Type.Size);
+				size = GetDynamicSize (target, blob, Location, out data_location);
+				if (!data_location.HasAddress)
+					return;
+
+				data = data_location.GetAddress (target);
+			}
+
+			if (size <= 0)
+				return;
+
+			int count = (int) Math.Min (size, MaxPrefetchSize);
+
+			target.Prefetch (new TargetAddress[] { data }, new int[] { count });
+
+			if (!Type.ElementType.IsByRef)
+				return;
+
+			int element_size = Type.GetElementSize (target);
+			int address_size = target.TargetMemoryInfo.TargetAddressSize;
+
+			List<TargetAddress> addresses = new List<TargetAddress> ();
+			for (int offset = 0; offset + element_size <= count; offset += element_size) {
+				TargetAddress address = target.ReadAddress (data + offset);
+				if (!address.IsNull)
+					addresses.Add (address);
+			}
+
+			int[] sizes = new int [addresses.Count];
+			for (int i = 0; i < sizes.Length; i++)
+				sizes [i] = 2 * address_size;
+
+			target.Prefetch (addresses.ToArray (), sizes);
+		}
+
 		public void SetElement (Thread thread, int[] indices, TargetObject obj)
 		{
 			thread.ThreadServant.DoTargetAccess (
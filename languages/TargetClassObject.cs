@@ -1,3 +1,5 @@
+using System;
+
 namespace Mono.Debugger.Languages
 {
 	public abstract class TargetClassObject : TargetStructObject
@@ -9,5 +11,32 @@ namespace Mono.Debugger.Languages
 		{
 			this.Type = type;
 		}
+
+		// <summary>
+		//   Tell the target that we're about to read this object's fields and
+		//   what they point to, so it can read them in one batch.  This is only
+		//   a hint; target errors are ignored.
+		// </summary>
+		public void Prefetch (Thread thread)
+		{
+			try {
+				thread.ThreadServant.DoTargetAccess (
+					delegate (TargetMemoryAccess target) {
+						Prefetch (target);
+						return null;
+				});
+			} catch (TargetException) {
+				// Reading the fields will report any errors.
+			}
+		}
+
+		internal virtual void Prefetch (TargetMemoryAccess target)
+		{
+			if (!Location.HasAddress || !Type.HasFixedSize)
+				return;
+
+			target.Prefetch (new TargetAddress[] { Location.GetAddress (target) },
+					 new int[] { Type.Size });
+		}
 	}
 }
@@ -212,6 +212,43 @@ namespace Mono.Debugger.Languages.Mono
 			return type.GetObject (target, field_loc);
 		}
 
+		//
+		// Prefetch the objects which the instance's reference fields point to;
+		// the instance itself should already be cached.
+		//
+		internal void PrefetchFields (TargetMemoryAccess target, TargetStructObject instance)
+		{
+			if (!instance.Location.HasAddress)
+				return;
+
+			GetFields (target);
+
+			TargetAddress start = instance.Location.GetAddress (target);
+			int address_size = target.TargetMemoryInfo.TargetAddressSize;
+
+			List<TargetAddress> addresses = new List<TargetAddress> ();
+			for (int i = 0; i < fields.Length; i++) {
+				if (fields [i].IsStatic || fields [i].HasConstValue)
+					continue;
+				if (!field_types [i].IsByRef)
+					continue;
+
+				int offset = field_offsets [i];
+				if (!Type.IsByRef)
+					offset -= 2 * address_size;
+
+				TargetAddress address = target.ReadAddress (start + offset);
+				if (!address.IsNull)
+					addresses.Add (address);
+			}
+
+			int[] sizes = new int [addresses.Count];
+			for (int i = 0; i < sizes.Length; i++)
+				sizes [i] = 2 * address_size;
+
+			target.Prefetch (addresses.ToArray (), sizes);
+		}
+
 		internal TargetObject GetStaticField (Thread thread, TargetFieldInfo field)
 		{
 			if (!thread.CurrentFrame.Language.IsManaged)
@@ -37,6 +37,12 @@ namespace Mono.Debugger.Languages.Mono
 			return type.GetCurrentObject (target, Location);
 		}
 
+		internal override void Prefetch (TargetMemoryAccess target)
+		{
+			base.Prefetch (target);
+			info.PrefetchFields (target, this);
+		}
+
 		internal TargetAddress KlassAddress {
 			get { return info.KlassAddress; }
 		}
@@ -37,9 +37,28 @@ namespace Mono.Debugger.Languages.Native
 
 		protected string ReadString (TargetMemoryAccess target, TargetLocation start)
 		{
-			if (start.HasAddress && start.GetAddress (target).IsNull)
-				return "null";
+			if (start.HasAddress) {
+				TargetAddress address = start.GetAddress (target);
+				if (address.IsNull)
+					return "null";
+
+				//
+				// Let the target read it in as few chunks as possible and
+				// look for the terminator itself.
+				//
+				string str = target.ReadString (address, MaximumDynamicSize);
+
+				StringBuilder sb = new StringBuilder (str.Length);
+				for (int i = 0; i < str.Length; i++)
+					escape (sb, str [i]);
+				return sb.ToString ();
+			}
+
+			return read_string_chunked (target, start);
+		}
 
+		string read_string_chunked (TargetMemoryAccess target, TargetLocation start)
+		{
 			StringBuilder sb = new StringBuilder ();
 			bool done = false;
 
@@ -49,39 +68,37 @@ namespace Mono.Debugger.Languages.Native
 				TargetLocation location = start.GetLocationAtOffset (offset);
 				byte[] buffer = location.ReadBuffer (target, ChunkSize);
 
-				int pos = 0;
 				int size = buffer.Length;
-				char[] char_buffer = new char [size * 3];
 				for (int i = 0; i < size; i++) {
 					if (buffer [i] == 0) {
 						done = true;
 						break;
 					}
 
-					char ch = (char) buffer [i];
-					if (Char.IsLetterOrDigit (ch) || Char.IsPunctuation (ch) ||
-					    Char.IsWhiteSpace (ch) || (ch == '<') || (ch == '>'))
-						char_buffer [pos++] = ch;
-					else if (ch == '\\') {
-						char_buffer [pos++] = '\\';
-						char_buffer [pos++] = '\\';
-					} else if ((ch == '\'') || (ch == '`')) {
-						char_buffer [pos++] = ch;
-					} else {
-						char_buffer [pos++] = '\\';
-						char_buffer [pos++] = hex_chars [(ch & 0xf0) >> 4];
-						char_buffer [pos++] = hex_chars [ch & 0x0f];
-					}
+					escape (sb, (char) buffer [i]);
 				}
 
-				string str = new String (char_buffer, 0, pos);
-				sb.Append (str);
-
 				offset += size;
 			}
 
 			return sb.ToString ();
 		}
+
+		static void escape (StringBuilder sb, char ch)
+		{
+			if (Char.IsLetterOrDigit (ch) || Char.IsPunctuation (ch) ||
+			    Char.IsWhiteSpace (ch) || (ch == '<') || (ch == '>'))
+				sb.Append (ch);
+			else if (ch == '\\')
+				sb.Append ("\\\\");
+			else if ((ch == '\'') || (ch == '`'))
+				sb.Append (ch);
+			else {
+				sb.Append ('\\');
+				sb.Append (hex_chars [(ch & 0xf0) >> 4]);
+				sb.Append (hex_chars [ch & 0x0f]);
+			}
+		}
 	}
 }
 
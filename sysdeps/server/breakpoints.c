@@ -10,106 +10,843 @@
 #include <fcntl.h>
 #include <errno.h>
 
-static GStaticRecMutex bpm_mutex = G_STATIC_REC_MUTEX_INIT;
+static volatile gint last_breakpoint_id = 0;
 
-static int last_breakpoint_id = 0;
+static BreakpointSnapshot *
+snapshot_new (guint32 count)
+{
+	BreakpointSnapshot *snapshot;
 
-BreakpointManager *
-mono_debugger_breakpoint_manager_new (void)
+	snapshot = g_malloc0 (G_STRUCT_OFFSET (BreakpointSnapshot, breakpoints) +
+			      MAX (count, 1) * sizeof (BreakpointInfo *));
+	snapshot->count = count;
+	return snapshot;
+}
+
+static BreakpointTable *
+table_new (void)
+{
+	BreakpointTable *table = g_new0 (BreakpointTable, 1);
+
+	table->refcount = 1;
+	table->breakpoints = g_ptr_array_new ();
+	table->breakpoint_hash = g_hash_table_new (NULL, NULL);
+	table->snapshot = snapshot_new (0);
+	table->watch_ranges = g_array_new (FALSE, FALSE, sizeof (WatchRange));
+
+	return table;
+}
+
+static void
+free_breakpoint_info (BreakpointInfo *info)
+{
+	g_free (info->condition);
+	g_free (info->threads);
+	g_free (info->actions);
+	g_free (info);
+}
+
+/*
+ * Only called once nobody can see `table' anymore, so this doesn't need to retire anything.
+ */
+static void
+table_unref (BreakpointTable *table)
+{
+	guint32 i;
+
+	if (!g_atomic_int_dec_and_test (&table->refcount))
+		return;
+
+	for (i = 0; i < table->breakpoints->len; i++)
+		free_breakpoint_info (g_ptr_array_index (table->breakpoints, i));
+	g_ptr_array_free (table->breakpoints, TRUE);
+	g_hash_table_destroy (table->breakpoint_hash);
+	g_array_free (table->watch_ranges, TRUE);
+	g_free (table->snapshot);
+	g_free (table);
+}
+
+static BreakpointManager *
+manager_new (BreakpointTable *table)
 {
 	BreakpointManager *bpm = g_new0 (BreakpointManager, 1);
 
-	bpm->breakpoints = g_ptr_array_new ();
-	bpm->breakpoint_hash = g_hash_table_new (NULL, NULL);
-	bpm->breakpoint_by_addr = g_hash_table_new (NULL, NULL);
+	g_static_rec_mutex_init (&bpm->mutex);
+	bpm->table = table;
+#ifdef HAVE_UNISTD_H
+	bpm->page_size = getpagesize ();
+#else
+	bpm->page_size = 4096;
+#endif
 
 	return bpm;
 }
 
 BreakpointManager *
-mono_debugger_breakpoint_manager_clone (BreakpointManager *old)
+mono_debugger_breakpoint_manager_new (void)
 {
-	BreakpointManager *bpm = mono_debugger_breakpoint_manager_new ();
-	int i;
+	return manager_new (table_new ());
+}
 
-	for (i = 0; i < old->breakpoints->len; i++) {
-		BreakpointInfo *old_info = g_ptr_array_index (old->breakpoints, i);
-		BreakpointInfo *info = g_memdup (old_info, sizeof (BreakpointInfo));
+/*
+ * This is called for each fork(), so it only takes another reference on the table;
+ * the child inherits the breakpoints and page protections with the parent's memory.
+ */
+BreakpointManager *
+mono_debugger_breakpoint_manager_clone (BreakpointManager *old)
+{
+	BreakpointManager *bpm;
 
-		mono_debugger_breakpoint_manager_insert (bpm, info);
-	}
+	mono_debugger_breakpoint_manager_lock (old);
+	g_atomic_int_inc (&old->table->refcount);
+	bpm = manager_new (old->table);
+	bpm->is_fork_child = TRUE;
+	mono_debugger_breakpoint_manager_unlock (old);
 
 	return bpm;
 }
 
+static void
+free_retired (BreakpointManager *bpm)
+{
+	GSList *l;
+
+	for (l = bpm->retired; l; l = l->next)
+		g_free (l->data);
+
+	g_slist_free (bpm->retired);
+	bpm->retired = NULL;
+
+	for (l = bpm->retired_tables; l; l = l->next)
+		table_unref (l->data);
+
+	g_slist_free (bpm->retired_tables);
+	bpm->retired_tables = NULL;
+}
+
 void
 mono_debugger_breakpoint_manager_free (BreakpointManager *bpm)
 {
-	g_ptr_array_free (bpm->breakpoints, TRUE);
-	g_hash_table_destroy (bpm->breakpoint_hash);
-	g_hash_table_destroy (bpm->breakpoint_by_addr);
+	if (bpm->trace_buffer) {
+		g_free (bpm->trace_buffer->data);
+		g_free (bpm->trace_buffer);
+	}
+
+	free_retired (bpm);
+	table_unref (bpm->table);
+	g_static_rec_mutex_free (&bpm->mutex);
 	g_free (bpm);
 }
 
 void
-mono_debugger_breakpoint_manager_lock (void)
+mono_debugger_breakpoint_manager_lock (BreakpointManager *bpm)
 {
-	g_static_rec_mutex_lock (&bpm_mutex);
+	g_static_rec_mutex_lock (&bpm->mutex);
 }
 
 void
-mono_debugger_breakpoint_manager_unlock (void)
+mono_debugger_breakpoint_manager_unlock (BreakpointManager *bpm)
 {
-	g_static_rec_mutex_unlock (&bpm_mutex);
+	g_static_rec_mutex_unlock (&bpm->mutex);
+}
+
+/*
+ * Readers don't take the lock; they only announce themselves, so writers won't
+ * free any snapshot or BreakpointInfo which might still be in use.
+ */
+void
+mono_debugger_breakpoint_manager_begin_read (BreakpointManager *bpm)
+{
+	g_atomic_int_inc (&bpm->readers);
+}
+
+/*
+ * The last reader frees whatever has been retired while it was reading, so the
+ * retired lists don't keep growing while readers overlap.  If a writer holds the
+ * lock, the next retire() does it instead.
+ */
+void
+mono_debugger_breakpoint_manager_end_read (BreakpointManager *bpm)
+{
+	if (!g_atomic_int_dec_and_test (&bpm->readers))
+		return;
+
+	if (!g_atomic_pointer_get ((gpointer *) &bpm->retired) &&
+	    !g_atomic_pointer_get ((gpointer *) &bpm->retired_tables))
+		return;
+
+	if (!g_static_rec_mutex_trylock (&bpm->mutex))
+		return;
+
+	if (g_atomic_int_get (&bpm->readers) == 0)
+		free_retired (bpm);
+
+	g_static_rec_mutex_unlock (&bpm->mutex);
+}
+
+/*
+ * Retired snapshots and removed breakpoints are only freed once there are no
+ * more readers; new readers can only see the new snapshot.
+ *
+ * Must be called with the lock held.
+ */
+static void
+retire (BreakpointManager *bpm, gpointer data)
+{
+	bpm->retired = g_slist_prepend (bpm->retired, data);
+
+	if (g_atomic_int_get (&bpm->readers) == 0)
+		free_retired (bpm);
+}
+
+static void
+publish_snapshot (BreakpointManager *bpm, BreakpointSnapshot *snapshot)
+{
+	BreakpointSnapshot *old = bpm->table->snapshot;
+
+	/*
+	 * This must be a full memory barrier, so we can't miss a reader which
+	 * already picked up the old snapshot when checking `readers' in retire().
+	 */
+	g_atomic_pointer_compare_and_exchange ((gpointer *) &bpm->table->snapshot, old, snapshot);
+	retire (bpm, old);
+}
+
+/*
+ * A forked child mustn't use anything which belongs to its parent: the thread filter
+ * names the parent's LWPs and the trampoline and runtime table slots are allocated in
+ * the parent's MonoRuntimeInfo.  Without a trampoline, the breakpoint is always
+ * reported and the debugger evaluates the condition itself.
+ */
+static void
+strip_breakpoint_info (BreakpointInfo *info)
+{
+	guint32 *threads = info->threads;
+
+	info->threads = NULL;
+	info->n_threads = 0;
+	g_free (threads);
+
+	info->trampoline = 0;
+	info->trampoline_slot = -1;
+	info->runtime_table_slot = -1;
+}
+
+static BreakpointInfo *
+copy_breakpoint_info (BreakpointInfo *old, gboolean strip)
+{
+	BreakpointInfo *info = g_memdup (old, sizeof (BreakpointInfo));
+
+	if (old->condition)
+		info->condition = g_memdup (old->condition, old->condition_size);
+	if (old->actions)
+		info->actions = g_memdup (old->actions, MAX (old->actions_size, 1));
+
+	if (strip) {
+		info->threads = NULL;
+		strip_breakpoint_info (info);
+	} else if (old->threads)
+		info->threads = g_memdup (old->threads, MAX (old->n_threads, 1) * sizeof (guint32));
+
+	return info;
+}
+
+/*
+ * Gives `bpm' its own copy of the breakpoint table if it still shares it with a clone.
+ * Must be called with the lock held before modifying the table or any BreakpointInfo
+ * in it.  Returns TRUE if it made a copy; the BreakpointInfo's from earlier lookups
+ * then still belong to the other BreakpointManager.
+ *
+ * A child which exec()s right after the fork() never modifies its breakpoints, so it
+ * never pays for the copy.  Whichever side copies, the child drops its parent's
+ * per-process state the first time it gets here.
+ */
+gboolean
+mono_debugger_breakpoint_manager_unshare (BreakpointManager *bpm)
+{
+	BreakpointTable *old = bpm->table, *table;
+	gboolean strip = bpm->is_fork_child;
+	guint32 i;
+
+	bpm->is_fork_child = FALSE;
+
+	if (g_atomic_int_get (&old->refcount) == 1) {
+		/* The parent already made its own copy. */
+		for (i = 0; strip && (i < old->breakpoints->len); i++)
+			strip_breakpoint_info (g_ptr_array_index (old->breakpoints, i));
+		return FALSE;
+	}
+
+	table = table_new ();
+	g_free (table->snapshot);
+	table->snapshot = snapshot_new (old->snapshot->count);
+
+	for (i = 0; i < old->snapshot->count; i++) {
+		BreakpointInfo *info = copy_breakpoint_info (old->snapshot->breakpoints [i], strip);
+
+		table->snapshot->breakpoints [i] = info;
+		g_ptr_array_add (table->breakpoints, info);
+		g_hash_table_insert (table->breakpoint_hash, GSIZE_TO_POINTER (info->id), info);
+	}
+
+	g_array_append_vals (table->watch_ranges, old->watch_ranges->data, old->watch_ranges->len);
+
+	g_atomic_pointer_compare_and_exchange ((gpointer *) &bpm->table, old, table);
+
+	/* Our readers may still be looking at the old table. */
+	bpm->retired_tables = g_slist_prepend (bpm->retired_tables, old);
+	if (g_atomic_int_get (&bpm->readers) == 0)
+		free_retired (bpm);
+
+	return TRUE;
+}
+
+/*
+ * Returns the index of the first breakpoint in `snapshot' whose address is
+ * greater than or equal to `address'.
+ */
+static guint32
+find_sorted_index (BreakpointSnapshot *snapshot, guint64 address)
+{
+	guint32 lo = 0, hi = snapshot->count;
+
+	while (lo < hi) {
+		guint32 mid = lo + (hi - lo) / 2;
+
+		if (snapshot->breakpoints [mid]->address < address)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
 }
 
 void
 mono_debugger_breakpoint_manager_insert (BreakpointManager *bpm, BreakpointInfo *breakpoint)
 {
-	g_ptr_array_add (bpm->breakpoints, breakpoint);
-	g_hash_table_insert (bpm->breakpoint_hash, GSIZE_TO_POINTER (breakpoint->id), breakpoint);
-	g_hash_table_insert (bpm->breakpoint_by_addr, GSIZE_TO_POINTER (breakpoint->address), breakpoint);
+	mono_debugger_breakpoint_manager_insert_many (bpm, &breakpoint, 1);
 }
 
+/*
+ * Inserts `count' breakpoints, which must be sorted by address, and publishes a
+ * single new snapshot for all of them.
+ */
+void
+mono_debugger_breakpoint_manager_insert_many (BreakpointManager *bpm, BreakpointInfo **breakpoints,
+					      guint32 count)
+{
+	BreakpointSnapshot *old, *snapshot;
+	guint32 i, j, k;
+
+	if (!count)
+		return;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+	mono_debugger_breakpoint_manager_unshare (bpm);
+
+	for (i = 0; i < count; i++) {
+		g_ptr_array_add (bpm->table->breakpoints, breakpoints [i]);
+		g_hash_table_insert (bpm->table->breakpoint_hash,
+				     GSIZE_TO_POINTER (breakpoints [i]->id), breakpoints [i]);
+	}
+
+	old = bpm->table->snapshot;
+	snapshot = snapshot_new (old->count + count);
+
+	/* A new breakpoint goes before the existing ones at the same address. */
+	for (i = j = k = 0; k < snapshot->count; k++) {
+		if ((j < count) &&
+		    ((i == old->count) || (breakpoints [j]->address <= old->breakpoints [i]->address)))
+			snapshot->breakpoints [k] = breakpoints [j++];
+		else
+			snapshot->breakpoints [k] = old->breakpoints [i++];
+	}
+
+	publish_snapshot (bpm, snapshot);
+
+	mono_debugger_breakpoint_manager_unlock (bpm);
+}
+
+/*
+ * Lock-free, but must be called with the lock held or between begin_read() and
+ * end_read(); the returned BreakpointInfo may only be used until then.
+ */
 BreakpointInfo *
 mono_debugger_breakpoint_manager_lookup (BreakpointManager *bpm, guint64 address)
 {
-	return g_hash_table_lookup (bpm->breakpoint_by_addr, GSIZE_TO_POINTER (address));
+	BreakpointTable *table;
+	BreakpointSnapshot *snapshot;
+	guint32 idx;
+
+	table = g_atomic_pointer_get ((gpointer *) &bpm->table);
+	snapshot = g_atomic_pointer_get ((gpointer *) &table->snapshot);
+	idx = find_sorted_index (snapshot, address);
+	if ((idx < snapshot->count) && (snapshot->breakpoints [idx]->address == address))
+		return snapshot->breakpoints [idx];
+
+	return NULL;
 }
 
 BreakpointInfo *
 mono_debugger_breakpoint_manager_lookup_by_id (BreakpointManager *bpm, guint32 id)
 {
-	return g_hash_table_lookup (bpm->breakpoint_hash, GSIZE_TO_POINTER (id));
+	BreakpointInfo *info;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+	info = g_hash_table_lookup (bpm->table->breakpoint_hash, GSIZE_TO_POINTER (id));
+	mono_debugger_breakpoint_manager_unlock (bpm);
+
+	return info;
 }
 
 GPtrArray *
 mono_debugger_breakpoint_manager_get_breakpoints (BreakpointManager *bpm)
 {
-	return bpm->breakpoints;
+	return bpm->table->breakpoints;
+}
+
+/*
+ * Stores a pointer to the first breakpoint in [start, start+size) in `first' and
+ * returns the number of breakpoints in that range; they're sorted by address.
+ * Must be called between begin_read() and end_read() or with the lock held.
+ */
+guint32
+mono_debugger_breakpoint_manager_lookup_range (BreakpointManager *bpm, guint64 start, guint32 size,
+					       BreakpointInfo ***first)
+{
+	BreakpointTable *table;
+	BreakpointSnapshot *snapshot;
+	guint32 lo, hi;
+
+	table = g_atomic_pointer_get ((gpointer *) &bpm->table);
+	snapshot = g_atomic_pointer_get ((gpointer *) &table->snapshot);
+
+	lo = find_sorted_index (snapshot, start);
+	hi = find_sorted_index (snapshot, start + size);
+
+	*first = snapshot->breakpoints + lo;
+	return hi - lo;
+}
+
+static void
+remove_sorted (BreakpointManager *bpm, BreakpointInfo *breakpoint)
+{
+	BreakpointSnapshot *old, *snapshot;
+	guint32 idx;
+
+	old = bpm->table->snapshot;
+	for (idx = find_sorted_index (old, breakpoint->address); idx < old->count; idx++) {
+		if (old->breakpoints [idx] == breakpoint)
+			break;
+		if (old->breakpoints [idx]->address != breakpoint->address) {
+			idx = old->count;
+			break;
+		}
+	}
+
+	if (idx == old->count) {
+		g_warning (G_STRLOC ": Breakpoint %d not in sorted list", breakpoint->id);
+		return;
+	}
+
+	snapshot = snapshot_new (old->count - 1);
+	memcpy (snapshot->breakpoints, old->breakpoints, idx * sizeof (BreakpointInfo *));
+	memcpy (snapshot->breakpoints + idx, old->breakpoints + idx + 1,
+		(old->count - idx - 1) * sizeof (BreakpointInfo *));
+
+	publish_snapshot (bpm, snapshot);
 }
 
 void
 mono_debugger_breakpoint_manager_remove (BreakpointManager *bpm, BreakpointInfo *breakpoint)
 {
-	if (!mono_debugger_breakpoint_manager_lookup_by_id (bpm, breakpoint->id)) {
-		g_warning (G_STRLOC ": mono_debugger_breakpoint_manager_remove(): No such breakpoint %d", breakpoint->id);
-		return;
+	guint32 id = breakpoint->id;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+	mono_debugger_breakpoint_manager_unshare (bpm);
+
+	breakpoint = mono_debugger_breakpoint_manager_lookup_by_id (bpm, id);
+	if (!breakpoint) {
+		g_warning (G_STRLOC ": mono_debugger_breakpoint_manager_remove(): No such breakpoint %d", id);
+		goto out;
 	}
 
 	if (--breakpoint->refcount > 0)
-		return;
+		goto out;
+
+	g_hash_table_remove (bpm->table->breakpoint_hash, GSIZE_TO_POINTER (breakpoint->id));
+	remove_sorted (bpm, breakpoint);
+	g_ptr_array_remove_fast (bpm->table->breakpoints, breakpoint);
+
+	g_free (breakpoint->threads);
+	breakpoint->threads = NULL;
+	g_free (breakpoint->actions);
+	breakpoint->actions = NULL;
+
+	retire (bpm, breakpoint);
+
+ out:
+	mono_debugger_breakpoint_manager_unlock (bpm);
+}
+
+/*
+ * Restricts breakpoint `id' to the `count' LWPs in `threads'; if `threads' is NULL, all
+ * threads stop there again.  Only the list is updated here; whether the server can let
+ * the other threads pass without reporting the breakpoint depends on the breakpoint's
+ * trampoline.
+ */
+gboolean
+mono_debugger_breakpoint_manager_set_threads (BreakpointManager *bpm, guint32 id,
+					      guint32 count, const guint32 *threads)
+{
+	BreakpointInfo *info;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+	mono_debugger_breakpoint_manager_unshare (bpm);
+
+	info = mono_debugger_breakpoint_manager_lookup_by_id (bpm, id);
+	if (!info) {
+		mono_debugger_breakpoint_manager_unlock (bpm);
+		return FALSE;
+	}
+
+	g_free (info->threads);
+	info->threads = NULL;
+	info->n_threads = 0;
+
+	if (threads) {
+		info->threads = g_new0 (guint32, MAX (count, 1));
+		memcpy (info->threads, threads, count * sizeof (guint32));
+		info->n_threads = count;
+	}
+
+	mono_debugger_breakpoint_manager_unlock (bpm);
+	return TRUE;
+}
+
+static gboolean
+tracepoint_actions_are_valid (const guint8 *actions, guint32 size)
+{
+	guint32 pos = 0, memory_size;
+
+	while (pos < size) {
+		switch (actions [pos++]) {
+		case TRACEPOINT_ACTION_REGISTERS:
+			break;
+
+		case TRACEPOINT_ACTION_MEMORY:
+			if (pos + 16 > size)
+				return FALSE;
+			memcpy (&memory_size, actions + pos + 12, 4);
+			if (memory_size > TRACEPOINT_MAX_MEMORY_SIZE)
+				return FALSE;
+			pos += 16;
+			break;
+
+		default:
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/*
+ * Makes breakpoint `id' a tracepoint which runs `actions' on each hit; if `actions' is
+ * NULL, it's an ordinary breakpoint again.  Like the thread filter, the server can only
+ * let the target continue by itself if the breakpoint has a trampoline.
+ */
+gboolean
+mono_debugger_breakpoint_manager_set_actions (BreakpointManager *bpm, guint32 id,
+					      const guint8 *actions, guint32 size)
+{
+	BreakpointInfo *info;
+
+	if (actions && !tracepoint_actions_are_valid (actions, size))
+		return FALSE;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+	mono_debugger_breakpoint_manager_unshare (bpm);
+
+	info = mono_debugger_breakpoint_manager_lookup_by_id (bpm, id);
+	if (!info) {
+		mono_debugger_breakpoint_manager_unlock (bpm);
+		return FALSE;
+	}
+
+	g_free (info->actions);
+	info->actions = actions ? g_memdup (actions, MAX (size, 1)) : NULL;
+	info->actions_size = actions ? size : 0;
+
+	mono_debugger_breakpoint_manager_unlock (bpm);
+	return TRUE;
+}
+
+static void
+trace_buffer_copy_in (TraceBuffer *tb, const guint8 *data, guint32 size)
+{
+	guint32 first = MIN (size, tb->size - tb->head);
+
+	memcpy (tb->data + tb->head, data, first);
+	memcpy (tb->data, data + first, size - first);
+	tb->head = (tb->head + size) % tb->size;
+	tb->used += size;
+}
 
-	g_hash_table_remove (bpm->breakpoint_hash, GSIZE_TO_POINTER (breakpoint->id));
-	g_hash_table_remove (bpm->breakpoint_by_addr, GSIZE_TO_POINTER (breakpoint->address));
-	g_ptr_array_remove_fast (bpm->breakpoints, breakpoint);
-	g_free (breakpoint);
+static void
+trace_buffer_copy_out (TraceBuffer *tb, guint8 *data, guint32 size)
+{
+	guint32 first = MIN (size, tb->size - tb->tail);
+
+	memcpy (data, tb->data + tb->tail, first);
+	memcpy (data + first, tb->data, size - first);
+}
+
+static void
+trace_buffer_drop_frame (TraceBuffer *tb)
+{
+	TraceFrameHeader header;
+
+	trace_buffer_copy_out (tb, (guint8 *) &header, sizeof (header));
+	tb->tail = (tb->tail + header.size) % tb->size;
+	tb->used -= header.size;
+	tb->frames--;
+}
+
+/*
+ * Appends a complete frame (which starts with a TraceFrameHeader) to the trace buffer,
+ * dropping the oldest frames if necessary.
+ */
+void
+mono_debugger_breakpoint_manager_add_trace_frame (BreakpointManager *bpm, const guint8 *frame,
+						  guint32 size)
+{
+	TraceBuffer *tb;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+
+	if (!bpm->trace_buffer) {
+		bpm->trace_buffer = g_new0 (TraceBuffer, 1);
+		bpm->trace_buffer->size = TRACE_BUFFER_DEFAULT_SIZE;
+		bpm->trace_buffer->data = g_malloc (TRACE_BUFFER_DEFAULT_SIZE);
+	}
+
+	tb = bpm->trace_buffer;
+	if (size > tb->size) {
+		tb->dropped++;
+		goto out;
+	}
+
+	while (tb->size - tb->used < size) {
+		trace_buffer_drop_frame (tb);
+		tb->dropped++;
+	}
+
+	trace_buffer_copy_in (tb, frame, size);
+	tb->frames++;
+
+ out:
+	mono_debugger_breakpoint_manager_unlock (bpm);
+}
+
+/*
+ * Moves as many complete frames as fit into `buffer' out of the trace buffer and
+ * returns the number of bytes written.
+ */
+guint32
+mono_debugger_breakpoint_manager_read_trace_frames (BreakpointManager *bpm, guint8 *buffer,
+						    guint32 size)
+{
+	TraceBuffer *tb;
+	guint32 offset = 0;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+
+	tb = bpm->trace_buffer;
+	while (tb && tb->frames) {
+		TraceFrameHeader header;
+
+		trace_buffer_copy_out (tb, (guint8 *) &header, sizeof (header));
+		if (offset + header.size > size)
+			break;
+
+		trace_buffer_copy_out (tb, buffer + offset, header.size);
+		trace_buffer_drop_frame (tb);
+		offset += header.size;
+	}
+
+	mono_debugger_breakpoint_manager_unlock (bpm);
+	return offset;
+}
+
+void
+mono_debugger_breakpoint_manager_get_trace_status (BreakpointManager *bpm, guint32 *frames,
+						   guint32 *used, guint32 *size, guint32 *dropped)
+{
+	TraceBuffer *tb;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+
+	tb = bpm->trace_buffer;
+	*frames = tb ? tb->frames : 0;
+	*used = tb ? tb->used : 0;
+	*size = tb ? tb->size : TRACE_BUFFER_DEFAULT_SIZE;
+	*dropped = tb ? tb->dropped : 0;
+
+	mono_debugger_breakpoint_manager_unlock (bpm);
 }
 
 int
 mono_debugger_breakpoint_manager_get_next_id (void)
 {
-	return ++last_breakpoint_id;
+	return g_atomic_int_exchange_and_add (&last_breakpoint_id, 1) + 1;
+}
+
+/*
+ * Returns the number of watch ranges which start at or before `address'.
+ */
+static guint32
+watch_range_upper_bound (BreakpointManager *bpm, guint64 address)
+{
+	guint32 lo = 0, hi = bpm->table->watch_ranges->len;
+
+	while (lo < hi) {
+		guint32 mid = (lo + hi) / 2;
+
+		if (g_array_index (bpm->table->watch_ranges, WatchRange, mid).start <= address)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void
+update_watch_range_max_end (BreakpointManager *bpm, guint32 pos)
+{
+	guint64 max_end = 0;
+	guint32 i;
+
+	if (pos > 0)
+		max_end = g_array_index (bpm->table->watch_ranges, WatchRange, pos - 1).max_end;
+
+	for (i = pos; i < bpm->table->watch_ranges->len; i++) {
+		WatchRange *range = &g_array_index (bpm->table->watch_ranges, WatchRange, i);
+
+		max_end = MAX (max_end, range->end);
+		range->max_end = max_end;
+	}
+}
+
+void
+mono_debugger_breakpoint_manager_insert_watch_range (BreakpointManager *bpm, guint32 id, guint64 start,
+						     guint32 size, HardwareBreakpointType type)
+{
+	WatchRange range;
+	guint32 pos;
+
+	range.start = start;
+	range.end = start + size;
+	range.max_end = range.end;
+	range.id = id;
+	range.type = type;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+	mono_debugger_breakpoint_manager_unshare (bpm);
+	pos = watch_range_upper_bound (bpm, start);
+	g_array_insert_val (bpm->table->watch_ranges, pos, range);
+	update_watch_range_max_end (bpm, pos);
+	mono_debugger_breakpoint_manager_unlock (bpm);
+}
+
+gboolean
+mono_debugger_breakpoint_manager_remove_watch_range (BreakpointManager *bpm, guint32 id)
+{
+	guint32 i;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+	mono_debugger_breakpoint_manager_unshare (bpm);
+	for (i = 0; i < bpm->table->watch_ranges->len; i++) {
+		if (g_array_index (bpm->table->watch_ranges, WatchRange, i).id != id)
+			continue;
+
+		g_array_remove_index (bpm->table->watch_ranges, i);
+		update_watch_range_max_end (bpm, i);
+		mono_debugger_breakpoint_manager_unlock (bpm);
+		return TRUE;
+	}
+
+	mono_debugger_breakpoint_manager_unlock (bpm);
+	return FALSE;
+}
+
+/*
+ * Find a watch range overlapping [start, end), preferring read watches since they also
+ * catch writes.  Must be called with the lock held.
+ */
+WatchRange *
+mono_debugger_breakpoint_manager_lookup_watch_range (BreakpointManager *bpm, guint64 start, guint64 end)
+{
+	WatchRange *found = NULL;
+	gint32 i;
+
+	if (end <= start)
+		return NULL;
+
+	for (i = (gint32) watch_range_upper_bound (bpm, end - 1) - 1; i >= 0; i--) {
+		WatchRange *range = &g_array_index (bpm->table->watch_ranges, WatchRange, i);
+
+		if (range->max_end <= start)
+			break;
+		if (range->end <= start)
+			continue;
+
+		if (range->type == HARDWARE_BREAKPOINT_READ)
+			return range;
+		if (!found)
+			found = range;
+	}
+
+	return found;
+}
+
+/*
+ * Tells the debugger how to protect the pages in [start, end): HARDWARE_BREAKPOINT_READ
+ * means no access at all, HARDWARE_BREAKPOINT_WRITE read-only and HARDWARE_BREAKPOINT_NONE
+ * the original protection.
+ */
+HardwareBreakpointType
+mono_debugger_breakpoint_manager_get_watch_type (BreakpointManager *bpm, guint64 start, guint64 end)
+{
+	WatchRange *range;
+	HardwareBreakpointType type;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+	range = mono_debugger_breakpoint_manager_lookup_watch_range (bpm, start, end);
+	type = range ? range->type : HARDWARE_BREAKPOINT_NONE;
+	mono_debugger_breakpoint_manager_unlock (bpm);
+
+	return type;
+}
+
+/*
+ * While the debugger calls mprotect() in the target to unprotect or protect a page, a
+ * SIGSEGV is a real one.
+ */
+void
+mono_debugger_breakpoint_manager_set_watch_suspended (BreakpointManager *bpm, gboolean suspended)
+{
+	mono_debugger_breakpoint_manager_lock (bpm);
+	bpm->watch_suspended = suspended;
+	mono_debugger_breakpoint_manager_unlock (bpm);
+}
+
+guint32
+mono_debugger_breakpoint_manager_get_page_size (BreakpointManager *bpm)
+{
+	return bpm->page_size;
 }
 
 int
@@ -123,3 +860,40 @@ mono_debugger_breakpoint_info_get_is_enabled (BreakpointInfo *info)
 {
 	return info->enabled;
 }
+
+/*
+ * Must be called with the lock held.
+ */
+gboolean
+mono_debugger_breakpoint_info_stops_thread (BreakpointInfo *info, guint32 pid)
+{
+	guint32 i;
+
+	if (!info->threads)
+		return TRUE;
+
+	for (i = 0; i < info->n_threads; i++) {
+		if (info->threads [i] == pid)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+guint64
+mono_debugger_breakpoint_info_get_address (BreakpointInfo *info)
+{
+	return info->address;
+}
+
+guint32
+mono_debugger_breakpoint_info_get_hit_count (BreakpointInfo *info)
+{
+	return info->hit_count;
+}
+
+guint32
+mono_debugger_breakpoint_info_get_ignore_count (BreakpointInfo *info)
+{
+	return info->ignore_count;
+}
@@ -5,11 +5,36 @@
 
 G_BEGIN_DECLS
 
+typedef struct _BreakpointInfo BreakpointInfo;
+
+/*
+ * Immutable array of all breakpoints, sorted by address.  Writers replace it
+ * wholesale, so readers can use it without taking the lock.
+ */
 typedef struct {
-	GPtrArray *breakpoints;
-	GHashTable *breakpoint_hash;
-	GHashTable *breakpoint_by_addr;
-} BreakpointManager;
+	guint32 count;
+	BreakpointInfo *breakpoints [1];
+} BreakpointSnapshot;
+
+/*
+ * Ring buffer of tracepoint frames.  Each frame starts with a TraceFrameHeader; if
+ * there's no room for a new frame, the oldest ones are dropped.
+ */
+typedef struct {
+	guint8 *data;
+	guint32 size;
+	guint32 head, tail, used;
+	guint32 frames, dropped;
+} TraceBuffer;
+
+typedef struct {
+	guint32 size;
+	guint32 breakpoint;
+	guint32 thread;
+	guint32 reserved;
+} TraceFrameHeader;
+
+#define TRACE_BUFFER_DEFAULT_SIZE	1048576
 
 typedef enum {
 	HARDWARE_BREAKPOINT_NONE = 0,
@@ -18,7 +43,88 @@ typedef enum {
 	HARDWARE_BREAKPOINT_WRITE
 } HardwareBreakpointType;
 
+/*
+ * Page-protection watchpoint.  The debugger mprotect()s the pages covering [start, end),
+ * so each access to them raises a SIGSEGV; only the ones inside a watched range are
+ * reported.  The ranges are sorted by `start' and `max_end' is the largest `end' of
+ * this and all preceding ranges, so a binary search finds all ranges overlapping an
+ * address even if they overlap each other.
+ */
+typedef struct {
+	guint64 start, end;
+	guint64 max_end;
+	guint32 id;
+	HardwareBreakpointType type;
+} WatchRange;
+
+/*
+ * The breakpoints themselves.  After a fork, the child's BreakpointManager shares the
+ * parent's table until either of them modifies it; see
+ * mono_debugger_breakpoint_manager_unshare().
+ */
+typedef struct {
+	volatile gint refcount;
+	GPtrArray *breakpoints;
+	GHashTable *breakpoint_hash;
+	BreakpointSnapshot * volatile snapshot;
+	GArray *watch_ranges;
+} BreakpointTable;
+
 typedef struct {
+	GStaticRecMutex mutex;
+	BreakpointTable * volatile table;
+	volatile gint readers;
+	GSList *retired;
+	GSList *retired_tables;
+	TraceBuffer *trace_buffer;
+	guint32 page_size;
+	gboolean watch_suspended;
+	/* Still has the parent's per-process breakpoint state, see unshare(). */
+	gboolean is_fork_child;
+} BreakpointManager;
+
+/*
+ * Server-side breakpoint conditions are a small stack-based bytecode.  Each opcode is
+ * one byte, followed by its little-endian operand (if any).  All values are 64-bit;
+ * the breakpoint is only reported if the value left on the stack is non-zero.
+ */
+typedef enum {
+	BREAKPOINT_CONDITION_REGISTER = 1,	/* guint32 regnum: push a register */
+	BREAKPOINT_CONDITION_CONSTANT,		/* gint64 value: push a constant */
+	BREAKPOINT_CONDITION_LOAD,		/* guint8 size: pop an address, push the value there;
+						   size is 1, 2, 4 or 8, or'ed with 0x80 to sign-extend */
+	BREAKPOINT_CONDITION_ADD,
+	BREAKPOINT_CONDITION_EQ,
+	BREAKPOINT_CONDITION_NE,
+	BREAKPOINT_CONDITION_LT,
+	BREAKPOINT_CONDITION_LE,
+	BREAKPOINT_CONDITION_GT,
+	BREAKPOINT_CONDITION_GE,
+	BREAKPOINT_CONDITION_AND,
+	BREAKPOINT_CONDITION_OR,
+	BREAKPOINT_CONDITION_NOT
+} BreakpointConditionOpcode;
+
+#define BREAKPOINT_CONDITION_STACK_SIZE		16
+#define BREAKPOINT_CONDITION_SIGN_EXTEND	0x80
+
+/*
+ * Tracepoint actions, encoded like the conditions above.  Each action appends a block
+ * to the trace frame: the opcode byte, followed by
+ *
+ *   TRACEPOINT_ACTION_REGISTERS: guint32 count, guint64 values [count]
+ *   TRACEPOINT_ACTION_MEMORY:    guint64 address, guint32 size, guint8 data [size]
+ *
+ * If the memory can't be read, `size' is zero.
+ */
+typedef enum {
+	TRACEPOINT_ACTION_REGISTERS = 1,	/* collect all registers */
+	TRACEPOINT_ACTION_MEMORY		/* gint32 regnum (or -1), gint64 offset, guint32 size */
+} TracepointActionOpcode;
+
+#define TRACEPOINT_MAX_MEMORY_SIZE		4096
+
+struct _BreakpointInfo {
 	HardwareBreakpointType type;
 	int id;
 	int refcount;
@@ -28,7 +134,45 @@ typedef struct {
 	char saved_insn;
 	int runtime_table_slot;
 	guint64 address;
-} BreakpointInfo;
+
+	/*
+	 * Optional server-side condition and ignore count.  If the condition is false or
+	 * the breakpoint is to be ignored, the target continues at `trampoline', which
+	 * executes the original instruction and jumps back.
+	 *
+	 * `hit_count' counts the hits for which the condition was true, including the
+	 * ignored ones.
+	 */
+	guint8 *condition;
+	guint32 condition_size;
+	guint32 hit_count;
+	guint32 ignore_count;
+	guint64 trampoline;
+	int trampoline_slot;
+
+	/*
+	 * If `threads' is non-NULL, only these `n_threads' LWPs stop at this breakpoint;
+	 * all other threads continue at `trampoline' without reporting it.
+	 */
+	guint32 *threads;
+	guint32 n_threads;
+
+	/*
+	 * If this is a tracepoint, the TracepointActionOpcode's to run on each hit; the
+	 * target always continues after collecting them.
+	 */
+	guint8 *actions;
+	guint32 actions_size;
+
+	/*
+	 * Hardware watchpoints only: if `watch_size' is non-zero, the watchpoint is only
+	 * reported if the `watch_size' bytes at `address' no longer contain `watch_value',
+	 * the value they had when the filter was set or the watchpoint was last reported.
+	 * The condition is then evaluated after the access.
+	 */
+	guint32 watch_size;
+	guint64 watch_value;
+};
 
 BreakpointManager *
 mono_debugger_breakpoint_manager_new                 (void);
@@ -40,10 +184,19 @@ void
 mono_debugger_breakpoint_manager_free                (BreakpointManager *bpm);
 
 void
-mono_debugger_breakpoint_manager_lock                (void);
+mono_debugger_breakpoint_manager_lock                (BreakpointManager *bpm);
+
+void
+mono_debugger_breakpoint_manager_unlock              (BreakpointManager *bpm);
+
+gboolean
+mono_debugger_breakpoint_manager_unshare             (BreakpointManager *bpm);
+
+void
+mono_debugger_breakpoint_manager_begin_read          (BreakpointManager *bpm);
 
 void
-mono_debugger_breakpoint_manager_unlock              (void);
+mono_debugger_breakpoint_manager_end_read            (BreakpointManager *bpm);
 
 int
 mono_debugger_breakpoint_manager_get_next_id         (void);
@@ -51,6 +204,10 @@ mono_debugger_breakpoint_manager_get_next_id         (void);
 void
 mono_debugger_breakpoint_manager_insert              (BreakpointManager *bpm, BreakpointInfo *breakpoint);
 
+void
+mono_debugger_breakpoint_manager_insert_many         (BreakpointManager *bpm, BreakpointInfo **breakpoints,
+						      guint32 count);
+
 BreakpointInfo *
 mono_debugger_breakpoint_manager_lookup              (BreakpointManager *bpm, guint64 address);
 
@@ -60,15 +217,70 @@ mono_debugger_breakpoint_manager_lookup_by_id        (BreakpointManager *bpm, gu
 GPtrArray *
 mono_debugger_breakpoint_manager_get_breakpoints     (BreakpointManager *bpm);
 
+guint32
+mono_debugger_breakpoint_manager_lookup_range        (BreakpointManager *bpm, guint64 start, guint32 size,
+						      BreakpointInfo ***first);
+
 void
 mono_debugger_breakpoint_manager_remove              (BreakpointManager *bpm, BreakpointInfo *breakpoint);
 
+gboolean
+mono_debugger_breakpoint_manager_set_threads         (BreakpointManager *bpm, guint32 id,
+						      guint32 count, const guint32 *threads);
+
+gboolean
+mono_debugger_breakpoint_info_stops_thread           (BreakpointInfo *info, guint32 pid);
+
+gboolean
+mono_debugger_breakpoint_manager_set_actions         (BreakpointManager *bpm, guint32 id,
+						      const guint8 *actions, guint32 size);
+
+void
+mono_debugger_breakpoint_manager_add_trace_frame     (BreakpointManager *bpm, const guint8 *frame,
+						      guint32 size);
+
+guint32
+mono_debugger_breakpoint_manager_read_trace_frames   (BreakpointManager *bpm, guint8 *buffer,
+						      guint32 size);
+
+void
+mono_debugger_breakpoint_manager_get_trace_status    (BreakpointManager *bpm, guint32 *frames,
+						      guint32 *used, guint32 *size, guint32 *dropped);
+
+void
+mono_debugger_breakpoint_manager_insert_watch_range  (BreakpointManager *bpm, guint32 id, guint64 start,
+						      guint32 size, HardwareBreakpointType type);
+
+gboolean
+mono_debugger_breakpoint_manager_remove_watch_range  (BreakpointManager *bpm, guint32 id);
+
+WatchRange *
+mono_debugger_breakpoint_manager_lookup_watch_range  (BreakpointManager *bpm, guint64 start, guint64 end);
+
+HardwareBreakpointType
+mono_debugger_breakpoint_manager_get_watch_type      (BreakpointManager *bpm, guint64 start, guint64 end);
+
+void
+mono_debugger_breakpoint_manager_set_watch_suspended (BreakpointManager *bpm, gboolean suspended);
+
+guint32
+mono_debugger_breakpoint_manager_get_page_size       (BreakpointManager *bpm);
+
 int
 mono_debugger_breakpoint_info_get_id                 (BreakpointInfo *info);
 
 gboolean
 mono_debugger_breakpoint_info_get_is_enabled         (BreakpointInfo *info);
 
+guint64
+mono_debugger_breakpoint_info_get_address            (BreakpointInfo *info);
+
+guint32
+mono_debugger_breakpoint_info_get_hit_count          (BreakpointInfo *info);
+
+guint32
+mono_debugger_breakpoint_info_get_ignore_count       (BreakpointInfo *info);
+
 G_END_DECLS
 
 #endif
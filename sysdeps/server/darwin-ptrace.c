@@ -234,6 +234,25 @@ server_ptrace_read_memory (ServerHandle *handle, guint64 start, guint32 size, gp
 	return COMMAND_ERROR_NONE;
 }
 
+static ServerCommandError
+server_ptrace_read_memory_vector (ServerHandle *handle, guint32 count, const guint64 *addresses,
+				  const guint32 *sizes, gpointer buffer)
+{
+	ServerCommandError result;
+	guint8 *ptr = buffer;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		result = server_ptrace_read_memory (handle, addresses [i], sizes [i], ptr);
+		if (result != COMMAND_ERROR_NONE)
+			return result;
+
+		ptr += sizes [i];
+	}
+
+	return COMMAND_ERROR_NONE;
+}
+
 static ServerCommandError
 _server_ptrace_make_memory_executable (ServerHandle *handle, guint64 start, guint32 size)
 {
@@ -418,6 +437,12 @@ _server_ptrace_get_dr (InferiorHandle *inferior, int regnum, guint64 *value)
 	return COMMAND_ERROR_NONE;
 }
 
+static ServerCommandError
+_server_ptrace_get_fault_address (InferiorHandle *inferior, guint64 *address)
+{
+	return COMMAND_ERROR_NOT_IMPLEMENTED;
+}
+
 GStaticMutex wait_mutex = G_STATIC_MUTEX_INIT;
 GStaticMutex wait_mutex_2 = G_STATIC_MUTEX_INIT;
 GStaticMutex wait_mutex_3 = G_STATIC_MUTEX_INIT;
@@ -522,6 +547,22 @@ server_ptrace_global_wait (guint32 *status_ret)
 	return ret;
 }
 
+static gint32
+server_ptrace_global_wait_many (guint32 max_events, guint32 *pids, guint32 *status_ret)
+{
+	guint32 ret;
+
+	if (!max_events)
+		return 0;
+
+	ret = server_ptrace_global_wait (status_ret);
+	if ((gint32) ret <= 0)
+		return ret;
+
+	pids [0] = ret;
+	return 1;
+}
+
 static ServerCommandError
 server_ptrace_stop (ServerHandle *handle)
 {
@@ -530,6 +571,7 @@ server_ptrace_stop (ServerHandle *handle)
 	mach_msg_type_number_t info_size = sizeof(struct task_basic_info)/sizeof(int);
 
 	inferior->os.wants_to_run = FALSE;
+	inferior->stop_pending = TRUE;
 
 	if (task_info(inferior->os.task, TASK_BASIC_INFO, (task_info_t)&info, &info_size) == KERN_SUCCESS)
 	{
@@ -572,6 +614,18 @@ server_ptrace_stop_and_wait (ServerHandle *handle, guint32 *status)
 	return server_ptrace_stop (handle);
 }
 
+static ServerCommandError
+server_ptrace_stop_all (ServerHandle **handles, guint32 count, ServerCommandError *results,
+			guint32 *status_ret)
+{
+	guint32 i;
+
+	for (i = 0; i < count; i++)
+		results [i] = server_ptrace_stop_and_wait (handles [i], &status_ret [i]);
+
+	return COMMAND_ERROR_NONE;
+}
+
 thread_t
 get_application_thread_port (mach_port_t task, thread_t our_name)
 {
@@ -927,7 +981,7 @@ server_ptrace_detach_after_fork (ServerHandle *handle)
 	if (result != COMMAND_ERROR_NONE)
 		return result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
 
 	breakpoints = mono_debugger_breakpoint_manager_get_breakpoints (handle->bpm);
 	for (i = 0; i < breakpoints->len; i++) {
@@ -936,7 +990,7 @@ server_ptrace_detach_after_fork (ServerHandle *handle)
 		x86_arch_disable_breakpoint (handle, info);
 	}
 
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
 
 	if (ptrace (PT_DETACH, handle->inferior->pid, NULL, 0) != 0)
 		return _server_ptrace_check_errno (handle->inferior);
@@ -955,6 +1009,13 @@ server_ptrace_continue (ServerHandle *handle)
 
 	struct thread_basic_info th_info;
 	unsigned int info_count = THREAD_BASIC_INFO_COUNT;
+	ServerCommandError result;
+
+	result = x86_arch_flush_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+	x86_arch_invalidate_registers (handle);
+	inferior->stop_pending = FALSE;
 
 	/* Clear trap flag, if in case it had been set in server_ptrace_step */
 	_server_ptrace_get_registers(inferior, &regs);
@@ -1013,7 +1074,14 @@ server_ptrace_step (ServerHandle *handle)
 	mach_msg_type_number_t count;
 	kern_return_t err;
 	INFERIOR_REGS_TYPE regs;
+	ServerCommandError result;
 	int i;
+
+	result = x86_arch_flush_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+	x86_arch_invalidate_registers (handle);
+	inferior->stop_pending = FALSE;
 	
 	/* 
 	 * PT_STEP seems to be badly broken on OS X in multi-threaded environments.
@@ -64,6 +64,9 @@ _server_ptrace_set_dr (InferiorHandle *handle, int regnum, guint64 value);
 static ServerCommandError
 _server_ptrace_get_dr (InferiorHandle *handle, int regnum, guint64 *value);
 
+static ServerCommandError
+_server_ptrace_get_fault_address (InferiorHandle *inferior, guint64 *address);
+
 static ServerCommandError
 server_ptrace_stop (ServerHandle *handle);
 
@@ -17,6 +17,7 @@ typedef struct
 	int slot;
 	int insn_size;
 	gboolean update_ip;
+	gboolean displaced;
 	guint32 code_address;
 	guint32 original_eip;
 } CodeBufferData;
@@ -25,6 +26,7 @@ struct ArchInfo
 {
 	INFERIOR_REGS_TYPE current_regs;
 	INFERIOR_FPREGS_TYPE current_fpregs;
+	gboolean regs_valid, regs_dirty, fpregs_valid;
 	GPtrArray *callback_stack;
 	CodeBufferData *code_buffer;
 	guint64 dr_control, dr_status;
@@ -68,16 +70,34 @@ x86_arch_finalize (ArchInfo *arch)
 	g_free (arch);
 }
 
+/*
+ * The hardware breakpoints have their own BreakpointManager; lock it after
+ * `handle->bpm' whenever we look at both of them.
+ */
+static void
+lock_breakpoints (ServerHandle *handle)
+{
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
+	mono_debugger_breakpoint_manager_lock (handle->arch->hw_bpm);
+}
+
+static void
+unlock_breakpoints (ServerHandle *handle)
+{
+	mono_debugger_breakpoint_manager_unlock (handle->arch->hw_bpm);
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
+}
+
 static ServerCommandError
 server_ptrace_current_insn_is_bpt (ServerHandle *handle, guint32 *is_breakpoint)
 {
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
 	if (mono_debugger_breakpoint_manager_lookup (handle->arch->hw_bpm, INFERIOR_REG_EIP (handle->arch->current_regs)) ||
 	    mono_debugger_breakpoint_manager_lookup (handle->bpm, INFERIOR_REG_EIP (handle->arch->current_regs)))
 		*is_breakpoint = TRUE;
 	else
 		*is_breakpoint = FALSE;
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 
 	return COMMAND_ERROR_NONE;
 }
@@ -86,27 +106,25 @@ void
 x86_arch_remove_breakpoints_from_target_memory (ServerHandle *handle, guint64 start,
 						guint32 size, gpointer buffer)
 {
-	GPtrArray *breakpoints;
+	BreakpointInfo **breakpoints;
 	guint8 *ptr = buffer;
-	int i;
+	guint32 count, i;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_begin_read (handle->bpm);
 
-	breakpoints = mono_debugger_breakpoint_manager_get_breakpoints (handle->bpm);
-	for (i = 0; i < breakpoints->len; i++) {
-		BreakpointInfo *info = g_ptr_array_index (breakpoints, i);
+	count = mono_debugger_breakpoint_manager_lookup_range (handle->bpm, start, size, &breakpoints);
+	for (i = 0; i < count; i++) {
+		BreakpointInfo *info = breakpoints [i];
 		guint32 offset;
 
 		if (info->is_hardware_bpt || !info->enabled)
 			continue;
-		if ((info->address < start) || (info->address >= start+size))
-			continue;
 
 		offset = (guint32) info->address - start;
 		ptr [offset] = info->saved_insn;
 	}
 
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_end_read (handle->bpm);
 }
 
 static ServerCommandError
@@ -114,9 +132,11 @@ server_ptrace_get_frame (ServerHandle *handle, StackFrame *frame)
 {
 	ServerCommandError result;
 
-	result = x86_arch_get_registers (handle);
-	if (result != COMMAND_ERROR_NONE)
-		return result;
+	if (!handle->arch->regs_valid) {
+		result = x86_arch_get_registers (handle);
+		if (result != COMMAND_ERROR_NONE)
+			return result;
+	}
 
 	frame->address = (guint32) INFERIOR_REG_EIP (handle->arch->current_regs);
 	frame->stack_pointer = (guint32) INFERIOR_REG_ESP (handle->arch->current_regs);
@@ -145,6 +165,10 @@ server_ptrace_call_method (ServerHandle *handle, guint64 method_address,
 			  0x00, 0xcc };
 	int size = sizeof (code);
 
+	result = x86_arch_get_fp_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
 	cdata = g_new0 (CallbackData, 1);
 
 	new_esp = (guint32) INFERIOR_REG_ESP (arch->current_regs) - size;
@@ -213,6 +237,10 @@ server_ptrace_call_method_1 (ServerHandle *handle, guint64 method_address,
 	memcpy (code, static_code, static_size);
 	strcpy ((char *) (code + static_size), string_argument);
 
+	result = x86_arch_get_fp_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
 	cdata = g_new0 (CallbackData, 1);
 
 	new_esp = (guint32) INFERIOR_REG_ESP (arch->current_regs) - size;
@@ -285,6 +313,10 @@ server_ptrace_call_method_2 (ServerHandle *handle, guint64 method_address,
 	*((guint32 *) (code+52)) = INFERIOR_REG_EIP (arch->current_regs);
 	*((guint8 *) (code+data_size+56)) = 0xcc;
 
+	result = x86_arch_get_fp_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
 	cdata = g_new0 (CallbackData, 1);
 	memcpy (&cdata->saved_regs, &arch->current_regs, sizeof (arch->current_regs));
 	memcpy (&cdata->saved_fpregs, &arch->current_fpregs, sizeof (arch->current_fpregs));
@@ -359,6 +391,10 @@ server_ptrace_call_method_3 (ServerHandle *handle, guint64 method_address,
 	*((guint32 *) (code+12)) = effective_address;
 	*((guint32 *) (code+20)) = new_esp;
 
+	result = x86_arch_get_fp_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
 	cdata = g_new0 (CallbackData, 1);
 	memcpy (&cdata->saved_regs, &arch->current_regs, sizeof (arch->current_regs));
 	memcpy (&cdata->saved_fpregs, &arch->current_fpregs, sizeof (arch->current_fpregs));
@@ -434,6 +470,10 @@ server_ptrace_call_method_invoke (ServerHandle *handle, guint64 invoke_method,
 	*((guint32 *) (code+12)) = new_esp + static_size + blob_size + 4;
 	*((guint32 *) (code+16)) = new_esp + 20;
 
+	result = x86_arch_get_fp_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
 	cdata = g_new0 (CallbackData, 1);
 	memcpy (&cdata->saved_regs, &arch->current_regs, sizeof (arch->current_regs));
 	memcpy (&cdata->saved_fpregs, &arch->current_fpregs, sizeof (arch->current_fpregs));
@@ -474,15 +514,15 @@ check_breakpoint (ServerHandle *handle, guint64 address, guint64 *retval)
 {
 	BreakpointInfo *info;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
 	info = (BreakpointInfo *) mono_debugger_breakpoint_manager_lookup (handle->bpm, address);
 	if (!info || !info->enabled) {
-		mono_debugger_breakpoint_manager_unlock ();
+		mono_debugger_breakpoint_manager_unlock (handle->bpm);
 		return FALSE;
 	}
 
 	*retval = info->id;
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
 	return TRUE;
 }
 
@@ -491,12 +531,12 @@ lookup_breakpoint (ServerHandle *handle, guint32 idx, BreakpointManager **out_bp
 {
 	BreakpointInfo *info;
 
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
 	info = (BreakpointInfo *) mono_debugger_breakpoint_manager_lookup_by_id (handle->arch->hw_bpm, idx);
 	if (info) {
 		if (out_bpm)
 			*out_bpm = handle->arch->hw_bpm;
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		return info;
 	}
 
@@ -504,14 +544,14 @@ lookup_breakpoint (ServerHandle *handle, guint32 idx, BreakpointManager **out_bp
 	if (info) {
 		if (out_bpm)
 			*out_bpm = handle->bpm;
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		return info;
 	}
 
 	if (out_bpm)
 		*out_bpm = NULL;
 
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 	return info;
 }
 
@@ -524,23 +564,82 @@ get_callback_data (ArchInfo *arch)
 	return g_ptr_array_index (arch->callback_stack, arch->callback_stack->len - 1);
 }
 
+/*
+ * Write back registers which have been modified with server_ptrace_set_registers();
+ * this must be done before the target is resumed.
+ */
+static ServerCommandError
+x86_arch_flush_registers (ServerHandle *handle)
+{
+	ArchInfo *arch = handle->arch;
+	ServerCommandError result;
+
+	if (!arch->regs_dirty)
+		return COMMAND_ERROR_NONE;
+
+	result = _server_ptrace_set_registers (handle->inferior, &arch->current_regs);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
+	arch->regs_dirty = FALSE;
+	return COMMAND_ERROR_NONE;
+}
+
+static void
+x86_arch_invalidate_registers (ServerHandle *handle)
+{
+	handle->arch->regs_valid = FALSE;
+	handle->arch->fpregs_valid = FALSE;
+}
+
 static ServerCommandError
 x86_arch_get_registers (ServerHandle *handle)
 {
+	ArchInfo *arch = handle->arch;
 	ServerCommandError result;
 
-	result = _server_ptrace_get_registers (handle->inferior, &handle->arch->current_regs);
+	result = x86_arch_flush_registers (handle);
 	if (result != COMMAND_ERROR_NONE)
 		return result;
 
-	result = _server_ptrace_get_fp_registers (handle->inferior, &handle->arch->current_fpregs);
+	result = _server_ptrace_get_registers (handle->inferior, &arch->current_regs);
 	if (result != COMMAND_ERROR_NONE)
 		return result;
 
-	result = _server_ptrace_get_dr (handle->inferior, DR_STATUS, &handle->arch->dr_status);
+	/*
+	 * The FP registers are only needed when calling a method in the target, so we
+	 * fetch them lazily in x86_arch_get_fp_registers().
+	 */
+	arch->fpregs_valid = FALSE;
+
+	/*
+	 * DR_STATUS can't report anything interesting without any hardware breakpoints.
+	 */
+	if (arch->dr_control) {
+		result = _server_ptrace_get_dr (handle->inferior, DR_STATUS, &arch->dr_status);
+		if (result != COMMAND_ERROR_NONE)
+			return result;
+	} else
+		arch->dr_status = 0;
+
+	arch->regs_valid = TRUE;
+	return COMMAND_ERROR_NONE;
+}
+
+static ServerCommandError
+x86_arch_get_fp_registers (ServerHandle *handle)
+{
+	ArchInfo *arch = handle->arch;
+	ServerCommandError result;
+
+	if (arch->fpregs_valid)
+		return COMMAND_ERROR_NONE;
+
+	result = _server_ptrace_get_fp_registers (handle->inferior, &arch->current_fpregs);
 	if (result != COMMAND_ERROR_NONE)
 		return result;
 
+	arch->fpregs_valid = TRUE;
 	return COMMAND_ERROR_NONE;
 }
 
@@ -561,6 +660,9 @@ x86_arch_child_stopped (ServerHandle *handle, int stopsig,
 	if (stopsig == SIGSTOP)
 		return STOP_ACTION_INTERRUPTED;
 
+	if ((stopsig == SIGSEGV) && check_watch_fault (handle, retval, retval2))
+		return STOP_ACTION_WATCH_FAULT;
+
 #if defined(__linux__) || defined(__FreeBSD__)
 	if (stopsig != SIGTRAP)
 		return STOP_ACTION_STOPPED;
@@ -588,12 +690,23 @@ x86_arch_child_stopped (ServerHandle *handle, int stopsig,
 		if (X86_DR_WATCH_HIT (arch, i)) {
 			_server_ptrace_set_dr (inferior, DR_STATUS, 0);
 			arch->dr_status = 0;
+			if (!check_watch_value (handle, arch->hw_bpm, arch->dr_regs [i]))
+				return STOP_ACTION_RESUME;
 			*retval = arch->dr_regs [i];
 			return STOP_ACTION_BREAKPOINT_HIT;
 		}
 	}
 
 	if (check_breakpoint (handle, (guint32) INFERIOR_REG_EIP (arch->current_regs) - 1, retval)) {
+		guint64 trampoline;
+
+		trampoline = check_breakpoint_condition (handle, (guint32) INFERIOR_REG_EIP (arch->current_regs) - 1);
+		if (trampoline) {
+			INFERIOR_REG_EIP (arch->current_regs) = (guint32) trampoline;
+			_server_ptrace_set_registers (inferior, &arch->current_regs);
+			return STOP_ACTION_RESUME;
+		}
+
 		INFERIOR_REG_EIP (arch->current_regs)--;
 		_server_ptrace_set_registers (inferior, &arch->current_regs);
 		return STOP_ACTION_BREAKPOINT_HIT;
@@ -670,19 +783,27 @@ x86_arch_child_stopped (ServerHandle *handle, int stopsig,
 
 	cbuffer = arch->code_buffer;
 	if (cbuffer) {
-		handle->mono_runtime->executable_code_bitfield [cbuffer->slot] = 0;
-
-		if (cbuffer->code_address + cbuffer->insn_size != INFERIOR_REG_EIP (arch->current_regs)) {
+		runtime_free_code_buffer_slot (handle->mono_runtime, cbuffer->slot);
+
+		if (cbuffer->displaced) {
+			/*
+			 * A relative branch which was taken landed relative to the code buffer,
+			 * everything else stopped right behind the copied instruction.
+			 */
+			INFERIOR_REG_EIP (arch->current_regs) = cbuffer->original_eip +
+				INFERIOR_REG_EIP (arch->current_regs) - cbuffer->code_address;
+		} else if (cbuffer->code_address + cbuffer->insn_size != INFERIOR_REG_EIP (arch->current_regs)) {
 			g_warning (G_STRLOC ": %x - %x,%d - %x - %x", cbuffer->original_eip,
 				   cbuffer->code_address, cbuffer->insn_size,
 				   cbuffer->code_address + cbuffer->insn_size,
 				   INFERIOR_REG_EIP (arch->current_regs));
 			return STOP_ACTION_STOPPED;
+		} else {
+			INFERIOR_REG_EIP (arch->current_regs) = cbuffer->original_eip;
+			if (cbuffer->update_ip)
+				INFERIOR_REG_EIP (arch->current_regs) += cbuffer->insn_size;
 		}
 
-		INFERIOR_REG_EIP (arch->current_regs) = cbuffer->original_eip;
-		if (cbuffer->update_ip)
-			INFERIOR_REG_EIP (arch->current_regs) += cbuffer->insn_size;
 		if (_server_ptrace_set_registers (inferior, &arch->current_regs) != COMMAND_ERROR_NONE) {
 			g_error (G_STRLOC ": Can't restore registers");
 		}
@@ -762,7 +883,11 @@ server_ptrace_set_registers (ServerHandle *handle, guint64 *values)
 	INFERIOR_REG_ESP (arch->current_regs) = values [DEBUGGER_REG_RSP];
 	INFERIOR_REG_SS (arch->current_regs) = values [DEBUGGER_REG_SS];
 
-	return _server_ptrace_set_registers (handle->inferior, &arch->current_regs);
+	/*
+	 * Written back by x86_arch_flush_registers() before the target is resumed.
+	 */
+	arch->regs_dirty = TRUE;
+	return COMMAND_ERROR_NONE;
 }
 
 static ServerCommandError
@@ -772,9 +897,13 @@ server_ptrace_push_registers (ServerHandle *handle, guint64 *new_esp)
 	ServerCommandError result;
 
 	INFERIOR_REG_ESP (arch->current_regs) -= sizeof (arch->current_regs);
-	result = _server_ptrace_set_registers (handle->inferior, &arch->current_regs);
-	if (result != COMMAND_ERROR_NONE)
-		return result;
+
+	/*
+	 * Only the cached copy is changed; when pushing the registers of all threads
+	 * for a global thread lock, this saves a PT_SETREGS per thread and the one
+	 * from the matching pop_registers() is merged into it.
+	 */
+	arch->regs_dirty = TRUE;
 
 	*new_esp = INFERIOR_REG_ESP (arch->current_regs);
 
@@ -790,13 +919,10 @@ static ServerCommandError
 server_ptrace_pop_registers (ServerHandle *handle)
 {
 	ArchInfo *arch = handle->arch;
-	ServerCommandError result;
 
 	INFERIOR_REG_ESP (arch->current_regs) += sizeof (arch->current_regs);
-	result = _server_ptrace_set_registers (handle->inferior, &arch->current_regs);
-	if (result != COMMAND_ERROR_NONE)
-		return result;
 
+	arch->regs_dirty = TRUE;
 	return COMMAND_ERROR_NONE;
 }
 
@@ -826,17 +952,7 @@ server_ptrace_get_registers_from_core_file (guint64 *values, const guint8 *buffe
 static int
 find_breakpoint_table_slot (MonoRuntimeInfo *runtime)
 {
-	int i;
-
-	for (i = 1; i < runtime->breakpoint_table_size; i++) {
-		if (runtime->breakpoint_table_bitfield [i])
-			continue;
-
-		runtime->breakpoint_table_bitfield [i] = 1;
-		return i;
-	}
-
-	return -1;
+	return runtime_alloc_breakpoint_slot (runtime);
 }
 
 static ServerCommandError
@@ -885,14 +1001,18 @@ runtime_info_disable_breakpoint (ServerHandle *handle, BreakpointInfo *breakpoin
 	runtime = handle->mono_runtime;
 	g_assert (runtime);
 
+	/* Copied from the other process after a fork, see copy_breakpoint_info(). */
 	slot = breakpoint->runtime_table_slot;
+	if (slot < 0)
+		return COMMAND_ERROR_NONE;
+
 	index_address = runtime->breakpoint_table + runtime->address_size * slot;
 
 	result = server_ptrace_poke_word (handle, index_address, 0);
 	if (result != COMMAND_ERROR_NONE)
 		return result;
 
-	runtime->breakpoint_table_bitfield [slot] = 0;
+	runtime_free_breakpoint_slot (runtime, slot);
 
 	return COMMAND_ERROR_NONE;
 }
@@ -997,7 +1117,8 @@ server_ptrace_insert_breakpoint (ServerHandle *handle, guint64 address, guint32
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
+	mono_debugger_breakpoint_manager_unshare (handle->bpm);
 	breakpoint = (BreakpointInfo *) mono_debugger_breakpoint_manager_lookup (handle->bpm, address);
 	if (breakpoint) {
 		breakpoint->refcount++;
@@ -1014,7 +1135,7 @@ server_ptrace_insert_breakpoint (ServerHandle *handle, guint64 address, guint32
 
 	result = x86_arch_enable_breakpoint (handle, breakpoint);
 	if (result != COMMAND_ERROR_NONE) {
-		mono_debugger_breakpoint_manager_unlock ();
+		mono_debugger_breakpoint_manager_unlock (handle->bpm);
 		g_free (breakpoint);
 		return result;
 	}
@@ -1023,7 +1144,7 @@ server_ptrace_insert_breakpoint (ServerHandle *handle, guint64 address, guint32
 	mono_debugger_breakpoint_manager_insert (handle->bpm, (BreakpointInfo *) breakpoint);
  done:
 	*bhandle = breakpoint->id;
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
 
 	return COMMAND_ERROR_NONE;
 }
@@ -1035,7 +1156,8 @@ server_ptrace_remove_breakpoint (ServerHandle *handle, guint32 idx)
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
+	mono_debugger_breakpoint_manager_unshare (handle->bpm);
 	breakpoint = lookup_breakpoint (handle, idx, &bpm);
 	if (!breakpoint) {
 		result = COMMAND_ERROR_NO_SUCH_BREAKPOINT;
@@ -1052,10 +1174,11 @@ server_ptrace_remove_breakpoint (ServerHandle *handle, guint32 idx)
 		goto out;
 
 	breakpoint->enabled = FALSE;
+	free_breakpoint_condition (handle, breakpoint);
 	mono_debugger_breakpoint_manager_remove (bpm, breakpoint);
 
  out:
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 	return result;
 }
 
@@ -1096,11 +1219,11 @@ server_ptrace_insert_hw_breakpoint (ServerHandle *handle, guint32 type, guint32
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
 
 	result = find_free_hw_register (handle, idx);
 	if (result != COMMAND_ERROR_NONE) {
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		return result;
 	}
 
@@ -1114,7 +1237,7 @@ server_ptrace_insert_hw_breakpoint (ServerHandle *handle, guint32 type, guint32
 
 	result = x86_arch_enable_breakpoint (handle, breakpoint);
 	if (result != COMMAND_ERROR_NONE) {
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		g_free (breakpoint);
 		return result;
 	}
@@ -1124,7 +1247,7 @@ server_ptrace_insert_hw_breakpoint (ServerHandle *handle, guint32 type, guint32
 
  done:
 	*bhandle = breakpoint->id;
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 
 	return COMMAND_ERROR_NONE;
 }
@@ -1135,16 +1258,17 @@ server_ptrace_enable_breakpoint (ServerHandle *handle, guint32 idx)
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
+	mono_debugger_breakpoint_manager_unshare (handle->bpm);
 	breakpoint = lookup_breakpoint (handle, idx, NULL);
 	if (!breakpoint) {
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		return COMMAND_ERROR_NO_SUCH_BREAKPOINT;
 	}
 
 	result = x86_arch_enable_breakpoint (handle, breakpoint);
 	breakpoint->enabled = TRUE;
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 	return result;
 }
 
@@ -1154,16 +1278,17 @@ server_ptrace_disable_breakpoint (ServerHandle *handle, guint32 idx)
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
+	mono_debugger_breakpoint_manager_unshare (handle->bpm);
 	breakpoint = lookup_breakpoint (handle, idx, NULL);
 	if (!breakpoint) {
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		return COMMAND_ERROR_NO_SUCH_BREAKPOINT;
 	}
 
 	result = x86_arch_disable_breakpoint (handle, breakpoint);
 	breakpoint->enabled = FALSE;
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 	return result;
 }
 
@@ -1173,7 +1298,7 @@ server_ptrace_get_breakpoints (ServerHandle *handle, guint32 *count, guint32 **r
 	int i;
 	GPtrArray *breakpoints;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
 	breakpoints = mono_debugger_breakpoint_manager_get_breakpoints (handle->bpm);
 	*count = breakpoints->len;
 	*retval = g_new0 (guint32, breakpoints->len);
@@ -1183,7 +1308,7 @@ server_ptrace_get_breakpoints (ServerHandle *handle, guint32 *count, guint32 **r
 
 		(*retval) [i] = info->id;
 	}
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
 
 	return COMMAND_ERROR_NONE;	
 }
@@ -1191,28 +1316,44 @@ server_ptrace_get_breakpoints (ServerHandle *handle, guint32 *count, guint32 **r
 static int
 find_code_buffer_slot (MonoRuntimeInfo *runtime)
 {
-	int i;
+	return runtime_alloc_code_buffer_slot (runtime);
+}
 
-	for (i = runtime->executable_code_last_slot + 1; i < runtime->executable_code_total_chunks; i++) {
-		if (runtime->executable_code_bitfield [i])
-			continue;
+/*
+ * Single-step the instruction in `data', which has already been copied into its
+ * code buffer slot.  On error, the slot is released and the registers are left
+ * alone, so the caller may just try again.
+ */
+static ServerCommandError
+start_code_buffer (ServerHandle *handle, CodeBufferData *data)
+{
+	ArchInfo *arch = handle->arch;
+	ServerCommandError result;
+	guint32 saved_orig_eax;
 
-		runtime->executable_code_bitfield [i] = 1;
-		runtime->executable_code_last_slot = i;
-		return i;
-	}
+	saved_orig_eax = INFERIOR_REG_ORIG_EAX (arch->current_regs);
 
-	runtime->executable_code_last_slot = 0;
-	for (i = 0; i < runtime->executable_code_total_chunks; i++) {
-		if (runtime->executable_code_bitfield [i])
-			continue;
+	arch->code_buffer = data;
+
+	INFERIOR_REG_ORIG_EAX (arch->current_regs) = -1;
+	INFERIOR_REG_EIP (arch->current_regs) = data->code_address;
 
-		runtime->executable_code_bitfield [i] = 1;
-		runtime->executable_code_last_slot = i;
-		return i;
+	result = _server_ptrace_set_registers (handle->inferior, &arch->current_regs);
+	if (result == COMMAND_ERROR_NONE) {
+		result = server_ptrace_step (handle);
+		if (result == COMMAND_ERROR_NONE)
+			return COMMAND_ERROR_NONE;
 	}
 
-	return -1;
+	INFERIOR_REG_ORIG_EAX (arch->current_regs) = saved_orig_eax;
+	INFERIOR_REG_EIP (arch->current_regs) = data->original_eip;
+	_server_ptrace_set_registers (handle->inferior, &arch->current_regs);
+
+	runtime_free_code_buffer_slot (handle->mono_runtime, data->slot);
+	arch->code_buffer = NULL;
+	g_free (data);
+
+	return result;
 }
 
 static ServerCommandError
@@ -1230,16 +1371,15 @@ server_ptrace_execute_instruction (ServerHandle *handle, const guint8 *instructi
 
 	if (!runtime->executable_code_buffer)
 		return COMMAND_ERROR_INTERNAL_ERROR;
-
-	slot = find_code_buffer_slot (runtime);
-	if (slot < 0)
-		return COMMAND_ERROR_INTERNAL_ERROR;
-
 	if (size > runtime->executable_code_chunk_size)
 		return COMMAND_ERROR_INTERNAL_ERROR;
 	if (handle->arch->code_buffer)
 		return COMMAND_ERROR_INTERNAL_ERROR;
 
+	slot = find_code_buffer_slot (runtime);
+	if (slot < 0)
+		return COMMAND_ERROR_INTERNAL_ERROR;
+
 	code_address = runtime->executable_code_buffer + slot * runtime->executable_code_chunk_size;
 
 	data = g_new0 (CodeBufferData, 1);
@@ -1249,20 +1389,88 @@ server_ptrace_execute_instruction (ServerHandle *handle, const guint8 *instructi
 	data->original_eip = INFERIOR_REG_EIP (handle->arch->current_regs);
 	data->code_address = code_address;
 
-	handle->arch->code_buffer = data;
-
 	result = server_ptrace_write_memory (handle, code_address, size, instruction);
-	if (result != COMMAND_ERROR_NONE)
+	if (result != COMMAND_ERROR_NONE) {
+		runtime_free_code_buffer_slot (runtime, slot);
+		g_free (data);
 		return result;
+	}
 
-	INFERIOR_REG_ORIG_EAX (handle->arch->current_regs) = -1;
-	INFERIOR_REG_EIP (handle->arch->current_regs) = code_address;
+	return start_code_buffer (handle, data);
+}
 
-	result = _server_ptrace_set_registers (handle->inferior, &handle->arch->current_regs);
-	if (result != COMMAND_ERROR_NONE)
+static ServerCommandError
+x86_arch_write_trampoline (ServerHandle *handle, guint64 trampoline, guint32 trampoline_size,
+			   guint64 address, const guint8 *instruction, guint32 insn_size,
+			   gint32 displacement_offset)
+{
+	guint8 code [BREAKPOINT_TRAMPOLINE_CHUNKS * EXECUTABLE_CODE_CHUNK_SIZE];
+	guint32 jump_target;
+
+	/* There is no IP-relative addressing on i386. */
+	if (displacement_offset >= 0)
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	/* The instruction, followed by a `jmp rel32' back to the breakpoint's successor. */
+	if ((insn_size + 5 > trampoline_size) || (insn_size + 5 > sizeof (code)))
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	memcpy (code, instruction, insn_size);
+	jump_target = (guint32) (address + insn_size) - (guint32) (trampoline + insn_size + 5);
+	code [insn_size] = 0xe9;
+	memcpy (code + insn_size + 1, &jump_target, 4);
+
+	return server_ptrace_write_memory (handle, trampoline, insn_size + 5, code);
+}
+
+static ServerCommandError
+server_ptrace_execute_displaced_instruction (ServerHandle *handle, const guint8 *instruction,
+					     guint32 size, gint32 displacement_offset)
+{
+	MonoRuntimeInfo *runtime;
+	ServerCommandError result;
+	CodeBufferData *data;
+	guint8 code [EXECUTABLE_CODE_CHUNK_SIZE];
+	guint32 code_address, original_eip;
+	int slot;
+
+	runtime = handle->mono_runtime;
+	g_assert (runtime);
+
+	if (!runtime->executable_code_buffer)
+		return COMMAND_ERROR_INTERNAL_ERROR;
+	if ((size > runtime->executable_code_chunk_size) || (size > sizeof (code)))
+		return COMMAND_ERROR_INTERNAL_ERROR;
+	if (handle->arch->code_buffer)
+		return COMMAND_ERROR_INTERNAL_ERROR;
+
+	/* There is no IP-relative addressing outside of branches on i386. */
+	if (displacement_offset >= 0)
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	slot = find_code_buffer_slot (runtime);
+	if (slot < 0)
+		return COMMAND_ERROR_INTERNAL_ERROR;
+
+	code_address = runtime->executable_code_buffer + slot * runtime->executable_code_chunk_size;
+	original_eip = INFERIOR_REG_EIP (handle->arch->current_regs);
+
+	memcpy (code, instruction, size);
+
+	result = server_ptrace_write_memory (handle, code_address, size, code);
+	if (result != COMMAND_ERROR_NONE) {
+		runtime_free_code_buffer_slot (runtime, slot);
 		return result;
+	}
+
+	data = g_new0 (CodeBufferData, 1);
+	data->slot = slot;
+	data->insn_size = size;
+	data->displaced = TRUE;
+	data->original_eip = original_eip;
+	data->code_address = code_address;
 
-	return server_ptrace_step (handle);
+	return start_code_buffer (handle, data);
 }
 
 static ServerCommandError
@@ -1,5 +1,6 @@
 #include <config.h>
 #include <server.h>
+#include <memory-cache.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -52,9 +53,10 @@ mono_debugger_server_get_server_type (void)
 }
 
 void
-mono_debugger_server_io_thread_main (IOThreadData *io_data, ChildOutputFunc func)
+mono_debugger_server_io_thread_main (IOThreadData *io_data, ChildOutputFunc func,
+				     guint32 flush_latency, gint32 tee_fd)
 {
-	(global_vtable->io_thread_main) (io_data, func);
+	(global_vtable->io_thread_main) (io_data, func, flush_latency, tee_fd);
 }
 
 ServerCommandError
@@ -99,6 +101,11 @@ mono_debugger_server_attach (ServerHandle *handle, guint32 pid)
 void
 mono_debugger_server_finalize (ServerHandle *handle)
 {
+	if (handle->memory_cache) {
+		mono_debugger_memory_cache_free (handle->memory_cache);
+		handle->memory_cache = NULL;
+	}
+
 	(* global_vtable->finalize) (handle);
 }
 
@@ -114,11 +121,35 @@ mono_debugger_server_global_wait (guint32 *status)
 	return (* global_vtable->global_wait) (status);
 }
 
+gint32
+mono_debugger_server_global_wait_many (guint32 max_events, guint32 *pids, guint32 *status)
+{
+	gint32 pid;
+
+	if (global_vtable->global_wait_many)
+		return (* global_vtable->global_wait_many) (max_events, pids, status);
+
+	if (!max_events)
+		return 0;
+
+	pid = (* global_vtable->global_wait) (status);
+	if (pid <= 0)
+		return pid;
+
+	pids [0] = pid;
+	return 1;
+}
+
 ServerStatusMessageType
 mono_debugger_server_dispatch_event (ServerHandle *handle, guint32 status, guint64 *arg,
 				     guint64 *data1, guint64 *data2, guint32 *opt_data_size,
 				     gpointer *opt_data)
 {
+	/*
+	 * The target has been running, this also covers MESSAGE_CHILD_MEMORY_CHANGED.
+	 */
+	mono_debugger_memory_cache_invalidate ();
+
 	return (*global_vtable->dispatch_event) (
 		handle, status, arg, data1, data2, opt_data_size, opt_data);
 }
@@ -164,6 +195,8 @@ mono_debugger_server_step (ServerHandle *handle)
 	if (!global_vtable->step)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->step) (handle);
 }
 
@@ -173,6 +206,8 @@ mono_debugger_server_continue (ServerHandle *handle)
 	if (!global_vtable->run)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->run) (handle);
 }
 
@@ -182,6 +217,8 @@ mono_debugger_server_resume (ServerHandle *handle)
 	if (!global_vtable->resume)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->resume) (handle);
 }
 
@@ -191,6 +228,8 @@ mono_debugger_server_detach (ServerHandle *handle)
 	if (!global_vtable->detach)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->detach) (handle);
 }
 
@@ -209,15 +248,48 @@ mono_debugger_server_read_memory (ServerHandle *handle, guint64 start, guint32 s
 	if (!global_vtable->read_memory)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	if (handle->memory_cache && !handle->memory_cache_suspended)
+		return mono_debugger_memory_cache_read (
+			handle->memory_cache, handle, global_vtable->read_memory, start, size, data);
+
 	return (* global_vtable->read_memory) (handle, start, size, data);
 }
 
+/*
+ * Scalar reads for the managed side, which would otherwise need a buffer for
+ * each integer or pointer it reads; these go through the memory cache and
+ * breakpoint masking just like mono_debugger_server_read_memory().
+ */
+ServerCommandError
+mono_debugger_server_read_u32 (ServerHandle *handle, guint64 start, guint32 *value)
+{
+	return mono_debugger_server_read_memory (handle, start, sizeof (guint32), value);
+}
+
+ServerCommandError
+mono_debugger_server_read_u64 (ServerHandle *handle, guint64 start, guint64 *value)
+{
+	return mono_debugger_server_read_memory (handle, start, sizeof (guint64), value);
+}
+
+ServerCommandError
+mono_debugger_server_read_memory_vector (ServerHandle *handle, guint32 count, const guint64 *addresses,
+					 const guint32 *sizes, gpointer data)
+{
+	if (!global_vtable->read_memory_vector)
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	return (* global_vtable->read_memory_vector) (handle, count, addresses, sizes, data);
+}
+
 ServerCommandError
 mono_debugger_server_write_memory (ServerHandle *handle, guint64 start, guint32 size, gconstpointer data)
 {
 	if (!global_vtable->write_memory)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->write_memory) (handle, start, size, data);
 }
 
@@ -229,6 +301,8 @@ mono_debugger_server_call_method (ServerHandle *handle, guint64 method_address,
 	if (!global_vtable->call_method)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->call_method) (
 		handle, method_address, method_argument1, method_argument2,
 		callback_argument);
@@ -243,6 +317,8 @@ mono_debugger_server_call_method_1 (ServerHandle *handle, guint64 method_address
 	if (!global_vtable->call_method_1)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->call_method_1) (
 		handle, method_address, method_argument, data_argument,
 		data_argument2, string_argument, callback_argument);
@@ -256,6 +332,8 @@ mono_debugger_server_call_method_2 (ServerHandle *handle, guint64 method_address
 	if (!global_vtable->call_method_2)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->call_method_2) (
 		handle, method_address, data_size, data_buffer, callback_argument);
 }
@@ -269,6 +347,8 @@ mono_debugger_server_call_method_3 (ServerHandle *handle, guint64 method_address
 	if (!global_vtable->call_method_2)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->call_method_3) (
 		handle, method_address, method_argument, address_argument, blob_size,
 		blob_data, callback_argument);
@@ -284,6 +364,8 @@ mono_debugger_server_call_method_invoke (ServerHandle *handle, guint64 invoke_me
 	if (!global_vtable->call_method_invoke)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->call_method_invoke) (
 		handle, invoke_method, method_argument, num_params, blob_size,
 		param_data, offset_data, blob_data, callback_argument, debug);
@@ -296,10 +378,25 @@ mono_debugger_server_execute_instruction (ServerHandle *handle, const guint8 *in
 	if (!global_vtable->execute_instruction)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->execute_instruction) (
 		handle, instruction, insn_size, update_ip);
 }
 
+ServerCommandError
+mono_debugger_server_execute_displaced_instruction (ServerHandle *handle, const guint8 *instruction,
+						    guint32 insn_size, gint32 displacement_offset)
+{
+	if (!global_vtable->execute_displaced_instruction)
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	mono_debugger_memory_cache_invalidate ();
+
+	return (* global_vtable->execute_displaced_instruction) (
+		handle, instruction, insn_size, displacement_offset);
+}
+
 ServerCommandError
 mono_debugger_server_mark_rti_frame (ServerHandle *handle)
 {
@@ -315,6 +412,8 @@ mono_debugger_server_abort_invoke (ServerHandle *handle, guint64 rti_id)
 	if (!global_vtable->abort_invoke)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->abort_invoke) (handle, rti_id);
 }
 
@@ -324,9 +423,23 @@ mono_debugger_server_insert_breakpoint (ServerHandle *handle, guint64 address, g
 	if (!global_vtable->insert_breakpoint)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->insert_breakpoint) (handle, address, breakpoint);
 }
 
+ServerCommandError
+mono_debugger_server_insert_breakpoints (ServerHandle *handle, guint32 count, const guint64 *addresses,
+					 guint32 *breakpoints)
+{
+	if (!global_vtable->insert_breakpoints)
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	mono_debugger_memory_cache_invalidate ();
+
+	return (* global_vtable->insert_breakpoints) (handle, count, addresses, breakpoints);
+}
+
 ServerCommandError
 mono_debugger_server_insert_hw_breakpoint (ServerHandle *handle, guint32 type, guint32 *idx,
 					   guint64 address, guint32 *breakpoint)
@@ -334,6 +447,8 @@ mono_debugger_server_insert_hw_breakpoint (ServerHandle *handle, guint32 type, g
 	if (!global_vtable->insert_hw_breakpoint)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->insert_hw_breakpoint) (
 		handle, type, idx, address, breakpoint);
 }
@@ -344,6 +459,8 @@ mono_debugger_server_remove_breakpoint (ServerHandle *handle, guint32 breakpoint
 	if (!global_vtable->remove_breakpoint)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->remove_breakpoint) (handle, breakpoint);
 }
 
@@ -353,6 +470,8 @@ mono_debugger_server_enable_breakpoint (ServerHandle *handle, guint32 breakpoint
 	if (!global_vtable->enable_breakpoint)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->enable_breakpoint) (handle, breakpoint);
 }
 
@@ -362,9 +481,57 @@ mono_debugger_server_disable_breakpoint (ServerHandle *handle, guint32 breakpoin
 	if (!global_vtable->disable_breakpoint)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->disable_breakpoint) (handle, breakpoint);
 }
 
+ServerCommandError
+mono_debugger_server_set_breakpoints_enabled (ServerHandle *handle, guint32 count,
+					      const guint32 *breakpoints, gboolean enabled)
+{
+	if (!global_vtable->set_breakpoints_enabled)
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	mono_debugger_memory_cache_invalidate ();
+
+	return (* global_vtable->set_breakpoints_enabled) (handle, count, breakpoints, enabled);
+}
+
+ServerCommandError
+mono_debugger_server_set_breakpoint_condition (ServerHandle *handle, guint32 breakpoint,
+					       const guint8 *condition, guint32 condition_size,
+					       guint32 ignore_count, const guint8 *instruction,
+					       guint32 insn_size, gint32 displacement_offset)
+{
+	if (!global_vtable->set_breakpoint_condition)
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	return (* global_vtable->set_breakpoint_condition) (
+		handle, breakpoint, condition, condition_size, ignore_count, instruction,
+		insn_size, displacement_offset);
+}
+
+ServerCommandError
+mono_debugger_server_free_retired_trampolines (ServerHandle *handle, const guint64 *ips, guint32 count)
+{
+	if (!global_vtable->free_retired_trampolines)
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	return (* global_vtable->free_retired_trampolines) (handle, ips, count);
+}
+
+ServerCommandError
+mono_debugger_server_set_watch_filter (ServerHandle *handle, guint32 breakpoint, guint32 value_size,
+				       const guint8 *condition, guint32 condition_size)
+{
+	if (!global_vtable->set_watch_filter)
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	return (* global_vtable->set_watch_filter) (
+		handle, breakpoint, value_size, condition, condition_size);
+}
+
 ServerCommandError
 mono_debugger_server_get_registers (ServerHandle *handle, guint64 *values)
 {
@@ -380,6 +547,8 @@ mono_debugger_server_set_registers (ServerHandle *handle, guint64 *values)
 	if (!global_vtable->set_registers)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->set_registers) (handle, values);
 }
 
@@ -401,6 +570,25 @@ mono_debugger_server_stop_and_wait (ServerHandle *handle, guint32 *status)
 	return (* global_vtable->stop_and_wait) (handle, status);
 }
 
+ServerCommandError
+mono_debugger_server_stop_all (ServerHandle **handles, guint32 count, ServerCommandError *results,
+			       guint32 *status)
+{
+	if (!global_vtable->stop_all)
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	return (* global_vtable->stop_all) (handles, count, results, status);
+}
+
+ServerCommandError
+mono_debugger_server_set_stop_pending (ServerHandle *handle)
+{
+	if (!global_vtable->set_stop_pending)
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	return (* global_vtable->set_stop_pending) (handle);
+}
+
 ServerCommandError
 mono_debugger_server_set_signal (ServerHandle *handle, guint32 sig, guint32 send_it)
 {
@@ -422,6 +610,8 @@ mono_debugger_server_get_pending_signal  (ServerHandle *handle, guint32 *signal)
 ServerCommandError
 mono_debugger_server_kill (ServerHandle *handle)
 {
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->kill) (handle);
 }
 
@@ -469,6 +659,8 @@ mono_debugger_server_detach_after_fork (ServerHandle *handle)
 	if (!global_vtable->detach_after_fork)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->detach_after_fork) (handle);
 }
 
@@ -478,6 +670,8 @@ mono_debugger_server_push_registers (ServerHandle *handle, guint64 *new_rsp)
 	if (!global_vtable->push_registers)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->push_registers) (handle, new_rsp);
 }
 
@@ -487,6 +681,8 @@ mono_debugger_server_pop_registers (ServerHandle *handle)
 	if (!global_vtable->pop_registers)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->pop_registers) (handle);
 }
 
@@ -507,6 +703,8 @@ mono_debugger_server_restart_notification (ServerHandle *handle)
 	if (!global_vtable->restart_notification)
 		return COMMAND_ERROR_NOT_IMPLEMENTED;
 
+	mono_debugger_memory_cache_invalidate ();
+
 	return (* global_vtable->restart_notification) (handle);
 }
 
@@ -515,3 +713,38 @@ mono_debugger_server_get_registers_from_core_file (guint64 *values, const guint8
 {
 	(* global_vtable->get_registers_from_core_file) (values, buffer);
 }
+
+void
+mono_debugger_server_set_memory_cache (ServerHandle *handle, gboolean enabled)
+{
+	if (enabled && !handle->memory_cache)
+		handle->memory_cache = mono_debugger_memory_cache_new ();
+	else if (!enabled && handle->memory_cache) {
+		mono_debugger_memory_cache_free (handle->memory_cache);
+		handle->memory_cache = NULL;
+	}
+}
+
+/*
+ * The epoch is only bumped when a thread is resumed through us, so the managed side
+ * suspends the cache while any thread of this handle's process is running.
+ */
+void
+mono_debugger_server_suspend_memory_cache (ServerHandle *handle, gboolean suspended)
+{
+	if (handle->memory_cache_suspended && !suspended)
+		mono_debugger_memory_cache_invalidate ();
+
+	handle->memory_cache_suspended = suspended;
+}
+
+void
+mono_debugger_server_get_memory_cache_stats (ServerHandle *handle, guint64 *hits, guint64 *misses)
+{
+	if (!handle->memory_cache) {
+		*hits = *misses = 0;
+		return;
+	}
+
+	mono_debugger_memory_cache_get_stats (handle->memory_cache, hits, misses);
+}
@@ -0,0 +1,114 @@
+#include <memory-cache.h>
+#include <string.h>
+
+typedef struct {
+	guint64 address;
+	gint epoch;
+	gboolean valid;
+	guint8 data [MEMORY_CACHE_PAGE_SIZE];
+} MemoryCachePage;
+
+struct MemoryCache {
+	MemoryCachePage pages [MEMORY_CACHE_NUM_PAGES];
+	guint64 hits;
+	guint64 misses;
+};
+
+static volatile gint memory_cache_epoch = 0;
+
+MemoryCache *
+mono_debugger_memory_cache_new (void)
+{
+	return g_new0 (MemoryCache, 1);
+}
+
+void
+mono_debugger_memory_cache_free (MemoryCache *cache)
+{
+	g_free (cache);
+}
+
+void
+mono_debugger_memory_cache_invalidate (void)
+{
+	g_atomic_int_inc (&memory_cache_epoch);
+}
+
+static ServerCommandError
+get_page (MemoryCache *cache, ServerHandle *handle, MemoryCacheReadFunc read_func,
+	  guint64 address, gint epoch, MemoryCachePage **retval)
+{
+	MemoryCachePage *page;
+	ServerCommandError result;
+
+	page = &cache->pages [(address / MEMORY_CACHE_PAGE_SIZE) % MEMORY_CACHE_NUM_PAGES];
+	if (page->valid && (page->address == address) && (page->epoch == epoch)) {
+		cache->hits++;
+		*retval = page;
+		return COMMAND_ERROR_NONE;
+	}
+
+	cache->misses++;
+	page->valid = FALSE;
+
+	result = (* read_func) (handle, address, MEMORY_CACHE_PAGE_SIZE, page->data);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
+	page->address = address;
+	page->epoch = epoch;
+	page->valid = TRUE;
+
+	*retval = page;
+	return COMMAND_ERROR_NONE;
+}
+
+ServerCommandError
+mono_debugger_memory_cache_read (MemoryCache *cache, ServerHandle *handle,
+				 MemoryCacheReadFunc read_func, guint64 start,
+				 guint32 size, gpointer buffer)
+{
+	guint8 *ptr = buffer;
+	guint64 end = start + size;
+	guint64 address;
+	gint epoch;
+
+	/*
+	 * Large reads would just thrash the cache.
+	 */
+	if (size > MEMORY_CACHE_PAGE_SIZE * (MEMORY_CACHE_NUM_PAGES / 4))
+		return (* read_func) (handle, start, size, buffer);
+
+	epoch = g_atomic_int_get (&memory_cache_epoch);
+
+	for (address = start & ~((guint64) MEMORY_CACHE_PAGE_SIZE - 1); address < end;
+	     address += MEMORY_CACHE_PAGE_SIZE) {
+		MemoryCachePage *page;
+		ServerCommandError result;
+		guint64 copy_start, copy_end;
+
+		result = get_page (cache, handle, read_func, address, epoch, &page);
+		if (result != COMMAND_ERROR_NONE) {
+			/*
+			 * The page may only be partially readable, let the backend
+			 * figure out whether the range we actually need is.
+			 */
+			return (* read_func) (handle, start, size, buffer);
+		}
+
+		copy_start = MAX (address, start);
+		copy_end = MIN (address + MEMORY_CACHE_PAGE_SIZE, end);
+
+		memcpy (ptr + (copy_start - start), page->data + (copy_start - address),
+			copy_end - copy_start);
+	}
+
+	return COMMAND_ERROR_NONE;
+}
+
+void
+mono_debugger_memory_cache_get_stats (MemoryCache *cache, guint64 *hits, guint64 *misses)
+{
+	*hits = cache->hits;
+	*misses = cache->misses;
+}
@@ -0,0 +1,44 @@
+#ifndef __MONO_DEBUGGER_MEMORY_CACHE_H__
+#define __MONO_DEBUGGER_MEMORY_CACHE_H__
+
+#include <server.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Optional page-granular cache for mono_debugger_server_read_memory().
+ *
+ * There is a single, global "stop epoch" which is bumped each time any inferior
+ * is resumed or modified; cached pages from an older epoch are stale.  This is a
+ * lot cheaper than tracking which thread may have touched which page.  Since a
+ * thread which was never stopped doesn't bump the epoch, the cache is suspended
+ * while any thread of the process is running, see
+ * mono_debugger_server_suspend_memory_cache().
+ */
+
+#define MEMORY_CACHE_PAGE_SIZE		4096
+#define MEMORY_CACHE_NUM_PAGES		32
+
+typedef ServerCommandError (* MemoryCacheReadFunc) (ServerHandle *handle, guint64 start,
+						    guint32 size, gpointer buffer);
+
+MemoryCache *
+mono_debugger_memory_cache_new           (void);
+
+void
+mono_debugger_memory_cache_free          (MemoryCache *cache);
+
+void
+mono_debugger_memory_cache_invalidate    (void);
+
+ServerCommandError
+mono_debugger_memory_cache_read          (MemoryCache *cache, ServerHandle *handle,
+					  MemoryCacheReadFunc read_func, guint64 start,
+					  guint32 size, gpointer buffer);
+
+void
+mono_debugger_memory_cache_get_stats     (MemoryCache *cache, guint64 *hits, guint64 *misses);
+
+G_END_DECLS
+
+#endif
@@ -56,7 +56,9 @@ typedef enum {
 	MESSAGE_CHILD_NOTIFICATION,
 	MESSAGE_CHILD_INTERRUPTED,
 	MESSAGE_RUNTIME_INVOKE_DONE,
-	MESSAGE_INTERNAL_ERROR
+	MESSAGE_INTERNAL_ERROR,
+	MESSAGE_CHILD_RESUMED,
+	MESSAGE_CHILD_WATCH_FAULT
 } ServerStatusMessageType;
 
 typedef struct {
@@ -94,15 +96,18 @@ typedef struct
 	guint32 breakpoint_table_size;
 
 	/* Private */
-	guint8 *breakpoint_table_bitfield;
-	guint8 *executable_code_bitfield;
+	guint32 *breakpoint_table_bitfield;
+	guint32 breakpoint_table_first_free;
+	guint32 *executable_code_bitfield;
 	guint32 executable_code_last_slot;
+	GArray *retired_trampolines;
 } MonoRuntimeInfo;
 
 typedef enum {
 	SERVER_CAPABILITIES_NONE		= 0,
 	SERVER_CAPABILITIES_THREAD_EVENTS	= 1,
-	SERVER_CAPABILITIES_CAN_DETACH_ANY	= 2
+	SERVER_CAPABILITIES_CAN_DETACH_ANY	= 2,
+	SERVER_CAPABILITIES_NEW_THREAD_STOPS	= 4
 } ServerCapabilities;
 
 typedef enum {
@@ -117,6 +122,7 @@ typedef struct InferiorVTable InferiorVTable;
 typedef struct InferiorHandle InferiorHandle;
 typedef struct ServerHandle ServerHandle;
 typedef struct ArchInfo ArchInfo;
+typedef struct MemoryCache MemoryCache;
 
 typedef struct IOThreadData IOThreadData;
 
@@ -155,6 +161,8 @@ struct ServerHandle {
 	InferiorHandle *inferior;
 	MonoRuntimeInfo *mono_runtime;
 	BreakpointManager *bpm;
+	MemoryCache *memory_cache;
+	gboolean memory_cache_suspended;
 };
 
 struct InferiorVTable {
@@ -176,8 +184,15 @@ struct InferiorVTable {
 	void                  (* set_runtime_info)    (ServerHandle       *handle,
 						       MonoRuntimeInfo    *mono_runtime_info);
 
+	/*
+	 * Forward the target's output to `func'.  Output is batched and delivered at most
+	 * `flush_latency' milliseconds after it arrived; if `tee_fd' is not -1, it's also
+	 * written to that file descriptor as soon as it's read.
+	 */
 	void                  (* io_thread_main)      (IOThreadData       *io_data,
-						       ChildOutputFunc     func);
+						       ChildOutputFunc     func,
+						       guint32             flush_latency,
+						       gint32              tee_fd);
 
 	ServerCommandError    (* spawn)               (ServerHandle       *handle,
 						       const gchar        *working_directory,
@@ -197,9 +212,35 @@ struct InferiorVTable {
 
 	guint32               (* global_wait)         (guint32             *status_ret);
 
+	/*
+	 * Like global_wait(), but once the first event arrived, also collect all the
+	 * other events which are already pending without blocking again.
+	 * Returns the number of events stored in `pids' and `status_ret', 0 if the
+	 * wait was interrupted and -1 if there are no more children.
+	 */
+	gint32                (* global_wait_many)    (guint32             max_events,
+						       guint32            *pids,
+						       guint32            *status_ret);
+
 	ServerCommandError    (* stop_and_wait)       (ServerHandle        *handle,
 						       guint32             *status);
 
+	/*
+	 * Like stop_and_wait() for each of the `handles', but signal all of them
+	 * before waiting for any, so they stop in parallel.  `results' receives
+	 * the per-thread error and `status_ret' the stop status.
+	 */
+	ServerCommandError    (* stop_all)            (ServerHandle       **handles,
+						       guint32             count,
+						       ServerCommandError *results,
+						       guint32            *status_ret);
+
+	/*
+	 * The debugger is about to dispatch an event which it took from its own queue
+	 * instead of calling stop(); make sure it's reported like a stop we requested.
+	 */
+	ServerCommandError    (* set_stop_pending)    (ServerHandle        *handle);
+
 	ServerStatusMessageType (* dispatch_event)    (ServerHandle        *handle,
 						       guint32              status,
 						       guint64             *arg,
@@ -260,6 +301,18 @@ struct InferiorVTable {
 						       guint32           size,
 						       gpointer          buffer);
 
+	/*
+	 * Read `count' ranges from the target's address space in one operation.
+	 * Range `i' starts at `addresses [i]' and is `sizes [i]' bytes long; the results
+	 * are stored back-to-back in `buffer' (which has been allocated by the caller and
+	 * must be large enough to hold the sum of all `sizes').
+	 */
+	ServerCommandError    (* read_memory_vector)  (ServerHandle     *handle,
+						       guint32           count,
+						       const guint64    *addresses,
+						       const guint32    *sizes,
+						       gpointer          buffer);
+
 	/*
 	 * Write `size' bytes from `buffer' to the target's address space starting at `start'.
 	 */
@@ -325,6 +378,19 @@ struct InferiorVTable {
 						       guint32           size,
 						       gboolean          update_ip);
 
+	/*
+	 * Single-step a copy of the instruction at the current address in the runtime's
+	 * code buffer, as if it was executed in place.  Only the current thread runs.
+	 * `displacement_offset' is the offset of an IP-relative disp32 operand in the
+	 * instruction or -1.  Relative branches are mapped back to the original address;
+	 * the instruction must not be an absolute control transfer or a call.
+	 * Returns COMMAND_ERROR_NOT_IMPLEMENTED if the operand can't be relocated.
+	 */
+	ServerCommandError    (* execute_displaced_instruction) (ServerHandle     *handle,
+								 const guint8     *instruction,
+								 guint32           size,
+								 gint32            displacement_offset);
+
 	ServerCommandError    (* mark_rti_frame)      (ServerHandle     *handle);
 
 	ServerCommandError    (* abort_invoke)        (ServerHandle     *handle,
@@ -339,6 +405,15 @@ struct InferiorVTable {
 						       guint64           address,
 						       guint32          *bhandle);
 
+	/*
+	 * Insert `count' breakpoints at once, returning their handles in `bhandles'.
+	 * Breakpoints on the same page are inserted with a single memory write.
+	 */
+	ServerCommandError    (* insert_breakpoints)  (ServerHandle     *handle,
+						       guint32           count,
+						       const guint64    *addresses,
+						       guint32          *bhandles);
+
 	/*
 	 * Insert a hardware breakpoint at address `address' in the target's address space.
 	 * Returns a breakpoint handle in `bhandle' which can be passed to `remove_breakpoint'
@@ -368,6 +443,60 @@ struct InferiorVTable {
 	ServerCommandError    (* disable_breakpoint)  (ServerHandle     *handle,
 						       guint32           bhandle);
 
+	/*
+	 * Enables or disables `count' breakpoints at once.
+	 */
+	ServerCommandError    (* set_breakpoints_enabled) (ServerHandle *handle,
+						       guint32           count,
+						       const guint32    *bhandles,
+						       gboolean          enabled);
+
+	/*
+	 * Attaches a condition (see BreakpointConditionOpcode) and an ignore count to
+	 * breakpoint `bhandle'; a zero `condition_size' removes the condition.  The first
+	 * `ignore_count' hits for which the condition is true are not reported, but still
+	 * counted in the breakpoint's hit count.
+	 *
+	 * `instruction' is the original instruction at the breakpoint's address; it is
+	 * copied into a trampoline in the code buffer, so the target can continue there
+	 * without reporting a MESSAGE_CHILD_HIT_BREAKPOINT.  `displacement_offset' is the
+	 * offset of its IP-relative displacement or -1.  The trampoline is also used for
+	 * threads excluded by mono_debugger_breakpoint_manager_set_threads(), which must be
+	 * called first.
+	 *
+	 * Returns COMMAND_ERROR_NOT_IMPLEMENTED if the server can't set up a trampoline; the
+	 * condition and ignore count are still recorded then, but the breakpoint is always
+	 * reported and the caller must check them itself.
+	 */
+	ServerCommandError    (* set_breakpoint_condition) (ServerHandle *handle,
+						       guint32           bhandle,
+						       const guint8     *condition,
+						       guint32           condition_size,
+						       guint32           ignore_count,
+						       const guint8     *instruction,
+						       guint32           insn_size,
+						       gint32            displacement_offset);
+
+	/*
+	 * Free the trampolines of removed breakpoints unless one of the `count'
+	 * instruction pointers in `ips' is still inside them.
+	 */
+	ServerCommandError    (* free_retired_trampolines) (ServerHandle *handle,
+							const guint64    *ips,
+							guint32           count);
+
+	/*
+	 * Filters the hits of hardware watchpoint `bhandle'.  If `value_size' is non-zero,
+	 * the watchpoint is only reported if the `value_size' bytes at its address changed;
+	 * if there's a `condition', only if it's true after the access.  Otherwise, the
+	 * target continues without a MESSAGE_CHILD_HIT_BREAKPOINT.
+	 */
+	ServerCommandError    (* set_watch_filter) (ServerHandle *handle,
+						    guint32           bhandle,
+						    guint32           value_size,
+						    const guint8     *condition,
+						    guint32           condition_size);
+
 	/*
 	 * Get all breakpoints.  Writes number of breakpoints into `count' and returns a g_new0()
 	 * allocated list of guint32's in `breakpoints'.  The caller is responsible for freeing this
@@ -475,7 +604,9 @@ mono_debugger_server_initialize_thread    (ServerHandle       *handle,
 
 void
 mono_debugger_server_io_thread_main       (IOThreadData       *io_data,
-					   ChildOutputFunc     func);
+					   ChildOutputFunc     func,
+					   guint32             flush_latency,
+					   gint32              tee_fd);
 
 ServerCommandError
 mono_debugger_server_spawn                (ServerHandle       *handle,
@@ -497,6 +628,11 @@ mono_debugger_server_finalize             (ServerHandle       *handle);
 guint32
 mono_debugger_server_global_wait          (guint32                 *status);
 
+gint32
+mono_debugger_server_global_wait_many     (guint32                  max_events,
+					   guint32                 *pids,
+					   guint32                 *status);
+
 ServerStatusMessageType
 mono_debugger_server_dispatch_event       (ServerHandle            *handle,
 					   guint32                  status,
@@ -543,6 +679,23 @@ mono_debugger_server_read_memory          (ServerHandle       *handle,
 					   guint32             size,
 					   gpointer            data);
 
+ServerCommandError
+mono_debugger_server_read_u32             (ServerHandle       *handle,
+					   guint64             start,
+					   guint32            *value);
+
+ServerCommandError
+mono_debugger_server_read_u64             (ServerHandle       *handle,
+					   guint64             start,
+					   guint64            *value);
+
+ServerCommandError
+mono_debugger_server_read_memory_vector   (ServerHandle       *handle,
+					   guint32             count,
+					   const guint64      *addresses,
+					   const guint32      *sizes,
+					   gpointer            data);
+
 ServerCommandError
 mono_debugger_server_write_memory         (ServerHandle       *handle,
 					   guint64             start,
@@ -599,6 +752,12 @@ mono_debugger_execute_instruction         (ServerHandle        *handle,
 					   guint32              instruction_size,
 					   gboolean             update_ip);
 
+ServerCommandError
+mono_debugger_server_execute_displaced_instruction (ServerHandle        *handle,
+						    const guint8        *instruction,
+						    guint32              instruction_size,
+						    gint32               displacement_offset);
+
 ServerCommandError
 mono_debugger_mark_rti_framenvoke        (ServerHandle        *handle);
 
@@ -611,6 +770,12 @@ mono_debugger_server_insert_breakpoint   (ServerHandle        *handle,
 					  guint64              address,
 					  guint32             *breakpoint);
 
+ServerCommandError
+mono_debugger_server_insert_breakpoints  (ServerHandle        *handle,
+					  guint32              count,
+					  const guint64       *addresses,
+					  guint32             *breakpoints);
+
 ServerCommandError
 mono_debugger_server_insert_hw_breakpoint(ServerHandle        *handle,
 					  guint32              type,
@@ -630,6 +795,34 @@ ServerCommandError
 mono_debugger_server_disable_breakpoint  (ServerHandle        *handle,
 					  guint32              breakpoint);
 
+ServerCommandError
+mono_debugger_server_set_breakpoints_enabled (ServerHandle    *handle,
+					      guint32          count,
+					      const guint32   *breakpoints,
+					      gboolean         enabled);
+
+ServerCommandError
+mono_debugger_server_set_breakpoint_condition (ServerHandle   *handle,
+					       guint32         breakpoint,
+					       const guint8   *condition,
+					       guint32         condition_size,
+					       guint32         ignore_count,
+					       const guint8   *instruction,
+					       guint32         insn_size,
+					       gint32          displacement_offset);
+
+ServerCommandError
+mono_debugger_server_free_retired_trampolines (ServerHandle   *handle,
+					       const guint64  *ips,
+					       guint32         count);
+
+ServerCommandError
+mono_debugger_server_set_watch_filter    (ServerHandle        *handle,
+					  guint32              breakpoint,
+					  guint32              value_size,
+					  const guint8        *condition,
+					  guint32              condition_size);
+
 ServerCommandError
 mono_debugger_server_get_registers       (ServerHandle        *handle,
 					  guint64             *values);
@@ -645,6 +838,15 @@ ServerCommandError
 mono_debugger_server_stop_and_wait       (ServerHandle        *handle,
 					  guint32             *status);
 
+ServerCommandError
+mono_debugger_server_stop_all            (ServerHandle       **handles,
+					  guint32              count,
+					  ServerCommandError  *results,
+					  guint32             *status);
+
+ServerCommandError
+mono_debugger_server_set_stop_pending    (ServerHandle        *handle);
+
 ServerCommandError
 mono_debugger_server_set_signal          (ServerHandle        *handle,
 					  guint32              sig,
@@ -717,6 +919,19 @@ void
 mono_debugger_server_get_registers_from_core_file (guint64 *values,
 						   const guint8 *buffer);
 
+void
+mono_debugger_server_set_memory_cache    (ServerHandle        *handle,
+					  gboolean             enabled);
+
+void
+mono_debugger_server_suspend_memory_cache (ServerHandle        *handle,
+					   gboolean             suspended);
+
+void
+mono_debugger_server_get_memory_cache_stats (ServerHandle      *handle,
+					     guint64           *hits,
+					     guint64           *misses);
+
 guint32
 mono_debugger_server_get_current_pid (void);
 
@@ -13,7 +13,9 @@ typedef enum {
 	STOP_ACTION_CALLBACK_COMPLETED,
 	STOP_ACTION_NOTIFICATION,
 	STOP_ACTION_RTI_DONE,
-	STOP_ACTION_INTERNAL_ERROR
+	STOP_ACTION_INTERNAL_ERROR,
+	STOP_ACTION_RESUME,
+	STOP_ACTION_WATCH_FAULT
 } ChildStoppedAction;
 
 typedef enum {
@@ -74,12 +76,26 @@ x86_arch_child_stopped (ServerHandle *handle, int stopsig,
 static ServerCommandError
 x86_arch_get_registers (ServerHandle *handle);
 
+static ServerCommandError
+x86_arch_get_fp_registers (ServerHandle *handle);
+
+static ServerCommandError
+x86_arch_flush_registers (ServerHandle *handle);
+
+static void
+x86_arch_invalidate_registers (ServerHandle *handle);
+
 static ServerCommandError
 x86_arch_disable_breakpoint (ServerHandle *handle, BreakpointInfo *breakpoint);
 
 static ServerCommandError
 x86_arch_enable_breakpoint (ServerHandle *handle, BreakpointInfo *breakpoint);
 
+static ServerCommandError
+x86_arch_write_trampoline (ServerHandle *handle, guint64 trampoline, guint32 trampoline_size,
+			   guint64 address, const guint8 *instruction, guint32 insn_size,
+			   gint32 displacement_offset);
+
 #if defined(__i386__)
 #include "i386-arch.h"
 #elif defined(__x86_64__)
@@ -4,10 +4,18 @@ server_ptrace_get_server_type (void)
 	return SERVER_TYPE_LINUX_PTRACE;
 }
 
+static gboolean use_ptrace_seize;
+
 static ServerCapabilities
 server_ptrace_get_capabilities (void)
 {
-	return SERVER_CAPABILITIES_THREAD_EVENTS | SERVER_CAPABILITIES_CAN_DETACH_ANY;
+	ServerCapabilities capabilities;
+
+	capabilities = SERVER_CAPABILITIES_THREAD_EVENTS | SERVER_CAPABILITIES_CAN_DETACH_ANY;
+	if (use_ptrace_seize)
+		capabilities |= SERVER_CAPABILITIES_NEW_THREAD_STOPS;
+
+	return capabilities;
 }
 
 static ServerCommandError
@@ -111,23 +119,110 @@ server_ptrace_read_memory (ServerHandle *handle, guint64 start, guint32 size, gp
 	return COMMAND_ERROR_NONE;
 }
 
+#ifdef HAVE_PROCESS_VM_READV
+/*
+ * Cleared the first time process_vm_readv() fails with ENOSYS or EPERM, so we don't
+ * keep retrying on kernels which don't support it.
+ */
+static gboolean have_process_vm_readv = TRUE;
+#endif
+
 static ServerCommandError
-server_ptrace_write_memory (ServerHandle *handle, guint64 start,
-			    guint32 size, gconstpointer buffer)
+_server_ptrace_read_memory_vector (ServerHandle *handle, guint32 count, const guint64 *addresses,
+				   const guint32 *sizes, gpointer buffer)
+{
+	ServerCommandError result;
+	guint8 *ptr = buffer;
+	guint32 i = 0;
+
+#ifdef HAVE_PROCESS_VM_READV
+	while (have_process_vm_readv && (i < count)) {
+		struct iovec local, remote [IOV_MAX];
+		guint32 first = i, nranges = 0;
+		gsize total = 0;
+		ssize_t ret;
+
+		/*
+		 * The caller's buffer is contiguous, so a single local iovec covers all
+		 * the remote ranges of one batch.
+		 */
+		for (; (i < count) && (nranges < IOV_MAX); i++, nranges++) {
+			remote [nranges].iov_base = GSIZE_TO_POINTER (addresses [i]);
+			remote [nranges].iov_len = sizes [i];
+			total += sizes [i];
+		}
+
+		local.iov_base = ptr;
+		local.iov_len = total;
+
+		ret = process_vm_readv (handle->inferior->pid, &local, 1, remote, nranges, 0);
+		if (ret == total) {
+			ptr += total;
+			continue;
+		}
+
+		if ((ret < 0) && ((errno == ENOSYS) || (errno == EPERM)))
+			have_process_vm_readv = FALSE;
+
+		/*
+		 * Short read: one of the ranges is not (entirely) readable.  Fall back to
+		 * reading the remaining ranges of this batch one at a time, this gives us
+		 * the correct error code for the faulting range.
+		 */
+		i = first;
+		break;
+	}
+#endif
+
+	for (; i < count; i++) {
+		result = _server_ptrace_read_memory (handle, addresses [i], sizes [i], ptr);
+		if (result != COMMAND_ERROR_NONE)
+			return result;
+
+		ptr += sizes [i];
+	}
+
+	return COMMAND_ERROR_NONE;
+}
+
+static ServerCommandError
+server_ptrace_read_memory_vector (ServerHandle *handle, guint32 count, const guint64 *addresses,
+				  const guint32 *sizes, gpointer buffer)
+{
+	ServerCommandError result;
+	guint8 *ptr = buffer;
+	int i;
+
+	result = _server_ptrace_read_memory_vector (handle, count, addresses, sizes, buffer);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
+	for (i = 0; i < count; i++) {
+		x86_arch_remove_breakpoints_from_target_memory (handle, addresses [i], sizes [i], ptr);
+		ptr += sizes [i];
+	}
+
+	return COMMAND_ERROR_NONE;
+}
+
+static ServerCommandError
+_server_ptrace_write_memory_ptrace (ServerHandle *handle, guint64 start,
+				    guint32 size, gconstpointer buffer)
 {
 	InferiorHandle *inferior = handle->inferior;
 	ServerCommandError result;
-	const long *ptr = buffer;
+	const guint8 *ptr = buffer;
 	guint64 addr = start;
-	char temp [8];
+	long word;
 
 	while (size >= sizeof (long)) {
-		long word = *ptr++;
+		memcpy (&word, ptr, sizeof (long));
 
 		errno = 0;
 		if (ptrace (PT_WRITE_D, inferior->pid, GSIZE_TO_POINTER (addr), word) != 0)
 			return _server_ptrace_check_errno (inferior);
 
+		ptr += sizeof (long);
 		addr += sizeof (long);
 		size -= sizeof (long);
 	}
@@ -135,13 +230,101 @@ server_ptrace_write_memory (ServerHandle *handle, guint64 start,
 	if (!size)
 		return COMMAND_ERROR_NONE;
 
-	result = _server_ptrace_read_memory (handle, addr, sizeof (long), &temp);
+	/* Read-modify-write the unaligned tail. */
+	result = _server_ptrace_read_memory (handle, addr, sizeof (long), &word);
 	if (result != COMMAND_ERROR_NONE)
 		return result;
 
-	memcpy (&temp, ptr, size);
+	memcpy (&word, ptr, size);
+
+	errno = 0;
+	if (ptrace (PT_WRITE_D, inferior->pid, GSIZE_TO_POINTER (addr), word) != 0)
+		return _server_ptrace_check_errno (inferior);
+
+	return COMMAND_ERROR_NONE;
+}
+
+#ifdef HAVE_PROCESS_VM_WRITEV
+static gboolean have_process_vm_writev = TRUE;
+#endif
+
+/*
+ * Try to write the whole block with a single system call, either through pwrite()
+ * on /proc/pid/mem or with process_vm_writev().  Returns the number of bytes which
+ * have actually been written; the caller falls back to PT_WRITE_D for the rest
+ * (process_vm_writev() can't write to read-only text pages, for instance).
+ */
+static guint32
+_server_ptrace_write_memory_bulk (ServerHandle *handle, guint64 start,
+				  guint32 size, gconstpointer buffer)
+{
+	InferiorHandle *inferior = handle->inferior;
+	const guint8 *ptr = buffer;
+	guint32 done = 0;
+
+	if (inferior->os.mem_fd_writable) {
+		while (done < size) {
+			int ret = pwrite64 (inferior->os.mem_fd, ptr + done, size - done, start + done);
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				break;
+			} else if (ret == 0)
+				break;
+
+			done += ret;
+		}
+
+		if (done == size)
+			return done;
+	}
+
+#ifdef HAVE_PROCESS_VM_WRITEV
+	while (have_process_vm_writev && (done < size)) {
+		struct iovec local, remote;
+		ssize_t ret;
+
+		local.iov_base = (gpointer) (ptr + done);
+		local.iov_len = size - done;
+		remote.iov_base = GSIZE_TO_POINTER (start + done);
+		remote.iov_len = size - done;
 
-	return server_ptrace_write_memory (handle, addr, sizeof (long), &temp);
+		ret = process_vm_writev (inferior->pid, &local, 1, &remote, 1, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == ENOSYS) || (errno == EPERM))
+				have_process_vm_writev = FALSE;
+			break;
+		} else if (ret == 0)
+			break;
+
+		done += ret;
+	}
+#endif
+
+	return done;
+}
+
+static ServerCommandError
+server_ptrace_write_memory (ServerHandle *handle, guint64 start,
+			    guint32 size, gconstpointer buffer)
+{
+	const guint8 *ptr = buffer;
+	guint32 done;
+
+	/*
+	 * Don't bother with the bulk path for single words, that's what breakpoint
+	 * insertion and most of the runtime table patching do.
+	 */
+	if (size <= sizeof (long))
+		return _server_ptrace_write_memory_ptrace (handle, start, size, buffer);
+
+	done = _server_ptrace_write_memory_bulk (handle, start, size, buffer);
+	if (done == size)
+		return COMMAND_ERROR_NONE;
+
+	return _server_ptrace_write_memory_ptrace (handle, start + done, size - done, ptr + done);
 }
 
 static ServerCommandError
@@ -184,13 +367,47 @@ _server_ptrace_get_dr (InferiorHandle *handle, int regnum, guint64 *value)
 	return COMMAND_ERROR_NONE;
 }
 
+/*
+ * The address which caused the SIGSEGV the inferior just stopped with.
+ */
+static ServerCommandError
+_server_ptrace_get_fault_address (InferiorHandle *inferior, guint64 *address)
+{
+	siginfo_t si;
+
+	if (ptrace (PTRACE_GETSIGINFO, inferior->pid, NULL, &si))
+		return _server_ptrace_check_errno (inferior);
+
+	*address = GPOINTER_TO_SIZE (si.si_addr);
+	return COMMAND_ERROR_NONE;
+}
+
 static ServerCommandError
 server_ptrace_continue (ServerHandle *handle)
 {
 	InferiorHandle *inferior = handle->inferior;
+	ServerCommandError result;
+
+	result = x86_arch_flush_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+	x86_arch_invalidate_registers (handle);
 
 	errno = 0;
 	inferior->stepping = FALSE;
+	inferior->stop_pending = FALSE;
+
+	if (inferior->os.group_stop) {
+		/*
+		 * The thread is in a group-stop: don't override job control, but let it report
+		 * events to us again once it gets a SIGCONT.
+		 */
+		inferior->os.group_stop = FALSE;
+		if (ptrace (PTRACE_LISTEN, inferior->pid, NULL, 0))
+			return _server_ptrace_check_errno (inferior);
+		return COMMAND_ERROR_NONE;
+	}
+
 	if (ptrace (PT_CONTINUE, inferior->pid, (caddr_t) 1, inferior->last_signal)) {
 		return _server_ptrace_check_errno (inferior);
 	}
@@ -202,9 +419,17 @@ static ServerCommandError
 server_ptrace_step (ServerHandle *handle)
 {
 	InferiorHandle *inferior = handle->inferior;
+	ServerCommandError result;
+
+	result = x86_arch_flush_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+	x86_arch_invalidate_registers (handle);
 
 	errno = 0;
 	inferior->stepping = TRUE;
+	inferior->stop_pending = FALSE;
+	inferior->os.group_stop = FALSE;
 	if (ptrace (PT_STEP, inferior->pid, (caddr_t) 1, inferior->last_signal))
 		return _server_ptrace_check_errno (inferior);
 
@@ -251,9 +476,83 @@ do_wait (int pid, guint32 *status, gboolean nohang)
 	return ret;
 }
 
+/*
+ * PTRACE_SEIZE (Linux >= 3.4) lets us attach without sending a SIGSTOP, stop a thread
+ * with PTRACE_INTERRUPT and reports group-stops as PTRACE_EVENT_STOP, so we don't need to
+ * overload SIGSTOP.  We check once whether the kernel supports it and fall back to
+ * PT_TRACE_ME / PT_ATTACH and tkill (SIGSTOP) if it doesn't.
+ */
+static gboolean use_ptrace_seize = FALSE;
+
+#define PTRACE_TRACE_OPTIONS (PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK | \
+			      PTRACE_O_TRACEVFORK | PTRACE_O_TRACEEXEC)
+
 static int stop_requested = 0;
 static int stop_status = 0;
 
+/*
+ * With PTRACE_SEIZE, both a PTRACE_INTERRUPT and the initial stop of a new thread are
+ * reported as PTRACE_EVENT_STOP with SIGTRAP.  We remember which threads we interrupted
+ * so we can tell them apart and keep the "early" stops of new threads from ever reaching
+ * the managed code; _server_ptrace_wait_for_new_thread() picks them up from here.
+ */
+static GStaticMutex new_thread_mutex = G_STATIC_MUTEX_INIT;
+static GHashTable *interrupted_pids = NULL;
+static GHashTable *new_thread_stops = NULL;
+
+/*
+ * Returns TRUE if `status' is the initial stop of a new thread which must be swallowed.
+ */
+static gboolean
+check_new_thread_stop (int pid, guint32 status)
+{
+	gboolean swallow = FALSE;
+
+	if (!use_ptrace_seize || !WIFSTOPPED (status) ||
+	    ((status >> 16) != PTRACE_EVENT_STOP) || (WSTOPSIG (status) != SIGTRAP))
+		return FALSE;
+
+	g_static_mutex_lock (&new_thread_mutex);
+	if (g_hash_table_lookup (interrupted_pids, GINT_TO_POINTER (pid)))
+		g_hash_table_remove (interrupted_pids, GINT_TO_POINTER (pid));
+	else {
+		g_hash_table_insert (new_thread_stops, GINT_TO_POINTER (pid), GINT_TO_POINTER (status));
+		swallow = TRUE;
+	}
+	g_static_mutex_unlock (&new_thread_mutex);
+
+	return swallow;
+}
+
+/*
+ * Pending server_ptrace_stop_all() request; protected by the `wait_mutex_2'.
+ */
+static guint32 stop_all_count = 0;
+static guint32 *stop_all_pids = NULL;
+static guint32 *stop_all_status = NULL;
+static gboolean *stop_all_done = NULL;
+
+/*
+ * Must be called with the `wait_mutex_2' held.  If `pid' is one of the threads
+ * server_ptrace_stop_all() is waiting for, store its status and return TRUE.
+ */
+static gboolean
+check_stop_all_request (int pid, guint32 status)
+{
+	gboolean found = FALSE;
+	guint32 i;
+
+	for (i = 0; i < stop_all_count; i++) {
+		if (!stop_all_done [i] && (stop_all_pids [i] == pid)) {
+			stop_all_status [i] = status;
+			stop_all_done [i] = TRUE;
+			found = TRUE;
+		}
+	}
+
+	return found;
+}
+
 static guint32
 server_ptrace_global_wait (guint32 *status_ret)
 {
@@ -269,6 +568,11 @@ server_ptrace_global_wait (guint32 *status_ret)
 	g_message (G_STRLOC ": global wait finished: %d - %x", ret, status);
 #endif
 
+	if (check_new_thread_stop (ret, status)) {
+		g_static_mutex_unlock (&wait_mutex);
+		goto again;
+	}
+
 	g_static_mutex_lock (&wait_mutex_2);
 
 #if DEBUG_WAIT
@@ -286,6 +590,19 @@ server_ptrace_global_wait (guint32 *status_ret)
 		g_static_mutex_unlock (&wait_mutex_3);
 		goto again;
 	}
+
+	if (check_stop_all_request (ret, status)) {
+		g_static_mutex_unlock (&wait_mutex_2);
+		g_static_mutex_unlock (&wait_mutex);
+
+		/*
+		 * Let server_ptrace_stop_all() have the `wait_mutex' and wait until it's
+		 * done; it collects the remaining stops itself.
+		 */
+		g_static_mutex_lock (&wait_mutex_3);
+		g_static_mutex_unlock (&wait_mutex_3);
+		goto again;
+	}
 	g_static_mutex_unlock (&wait_mutex_2);
 
 	*status_ret = status;
@@ -294,6 +611,79 @@ server_ptrace_global_wait (guint32 *status_ret)
 	return ret;
 }
 
+static gint32
+server_ptrace_global_wait_many (guint32 max_events, guint32 *pids, guint32 *status_ret)
+{
+	gboolean wait_for_stop = FALSE;
+	guint32 count;
+	int ret;
+	guint32 status;
+
+	if (!max_events)
+		return 0;
+
+	ret = server_ptrace_global_wait (&status);
+	if (ret <= 0)
+		return ret;
+
+	pids [0] = ret;
+	status_ret [0] = status;
+	count = 1;
+
+	/*
+	 * Now reap everything else which is already pending, so the caller can hand
+	 * all of it to the engine thread in one go.
+	 */
+
+	g_static_mutex_lock (&wait_mutex);
+	while (count < max_events) {
+		ret = do_wait (-1, &status, TRUE);
+		if (ret <= 0)
+			break;
+
+#if DEBUG_WAIT
+		g_message (G_STRLOC ": global wait many: %d - %x", ret, status);
+#endif
+
+		if (check_new_thread_stop (ret, status))
+			continue;
+
+		g_static_mutex_lock (&wait_mutex_2);
+		if (ret == stop_requested) {
+			/*
+			 * server_ptrace_stop_and_wait() is blocking on the `wait_mutex' to
+			 * get this; pass it on and return what we have so far.
+			 */
+			stop_status = status;
+			g_static_mutex_unlock (&wait_mutex_2);
+			wait_for_stop = TRUE;
+			break;
+		}
+		if (check_stop_all_request (ret, status)) {
+			g_static_mutex_unlock (&wait_mutex_2);
+			wait_for_stop = TRUE;
+			break;
+		}
+		g_static_mutex_unlock (&wait_mutex_2);
+
+		pids [count] = ret;
+		status_ret [count] = status;
+		count++;
+	}
+	g_static_mutex_unlock (&wait_mutex);
+
+	/*
+	 * As in server_ptrace_global_wait(), don't return before whoever we passed the
+	 * `wait_mutex' to is done.
+	 */
+	if (wait_for_stop) {
+		g_static_mutex_lock (&wait_mutex_3);
+		g_static_mutex_unlock (&wait_mutex_3);
+	}
+
+	return count;
+}
+
 static gboolean
 _server_ptrace_wait_for_new_thread (ServerHandle *handle)
 {
@@ -309,7 +699,9 @@ _server_ptrace_wait_for_new_thread (ServerHandle *handle)
 	 * any "early" stopping events.
 	 *
 	 * See also bugs #423518 and #466012.
-.	 *
+	 *
+	 * With PTRACE_SEIZE, the global wait already swallowed that event if it arrived
+	 * before the `PTRACE_EVENT_CLONE'.
 	 */
 
 	if (!g_static_mutex_trylock (&wait_mutex)) {
@@ -323,7 +715,22 @@ _server_ptrace_wait_for_new_thread (ServerHandle *handle)
 	 * and we can safely wait for it here.
 	 */
 
-	ret = waitpid (handle->inferior->pid, &status, WUNTRACED | __WALL | __WCLONE);
+	ret = 0;
+	if (use_ptrace_seize) {
+		gpointer early_status;
+
+		g_static_mutex_lock (&new_thread_mutex);
+		early_status = g_hash_table_lookup (new_thread_stops, GINT_TO_POINTER (handle->inferior->pid));
+		if (early_status) {
+			g_hash_table_remove (new_thread_stops, GINT_TO_POINTER (handle->inferior->pid));
+			status = GPOINTER_TO_INT (early_status);
+			ret = handle->inferior->pid;
+		}
+		g_static_mutex_unlock (&new_thread_mutex);
+	}
+
+	if (!ret)
+		ret = waitpid (handle->inferior->pid, &status, WUNTRACED | __WALL | __WCLONE);
 
 	/*
 	 * Safety check: make sure we got the correct event.
@@ -350,10 +757,99 @@ _server_ptrace_wait_for_new_thread (ServerHandle *handle)
 	return TRUE;
 }
 
+static gboolean
+_server_ptrace_using_seize (void)
+{
+	return use_ptrace_seize;
+}
+
+static int
+_server_ptrace_seize_attach (guint32 pid)
+{
+	if (ptrace (PTRACE_SEIZE, pid, NULL, (caddr_t) PTRACE_TRACE_OPTIONS))
+		return -1;
+
+	/*
+	 * Unlike PT_ATTACH, PTRACE_SEIZE doesn't stop the target.
+	 */
+	return ptrace (PTRACE_INTERRUPT, pid, NULL, 0);
+}
+
+static ServerCommandError
+_server_ptrace_seize_new_child (ServerHandle *handle, int pid)
+{
+	ServerCommandError result = COMMAND_ERROR_INTERNAL_ERROR;
+	int ret, status;
+
+	if (!g_static_mutex_trylock (&wait_mutex)) {
+		g_warning (G_STRLOC ": Can't lock mutex: %d", pid);
+		kill (pid, SIGKILL);
+		return COMMAND_ERROR_INTERNAL_ERROR;
+	}
+
+	/*
+	 * The child stopped itself with SIGSTOP before calling execve().
+	 */
+
+	ret = waitpid (pid, &status, WUNTRACED);
+	if ((ret != pid) || !WIFSTOPPED (status)) {
+		g_warning (G_STRLOC ": Wait failed: %d, got pid %d, status %x", pid, ret, status);
+		goto out;
+	}
+
+	if (ptrace (PTRACE_SEIZE, pid, NULL, (caddr_t) PTRACE_TRACE_OPTIONS)) {
+		g_warning (G_STRLOC ": Can't PTRACE_SEIZE %d: %s", pid, g_strerror (errno));
+		goto out;
+	}
+
+	kill (pid, SIGCONT);
+
+	/*
+	 * Let it run up to the PTRACE_EVENT_EXEC stop, suppressing the SIGCONT.  If
+	 * execve() failed, the child exits and our caller reads the error message.
+	 */
+
+	for (;;) {
+		ret = waitpid (pid, &status, __WALL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (!WIFSTOPPED (status)) {
+			result = COMMAND_ERROR_CANNOT_START_TARGET;
+			break;
+		}
+
+		if ((status >> 16) == PTRACE_EVENT_EXEC) {
+			handle->inferior->pid = pid;
+			result = x86_arch_get_registers (handle);
+			break;
+		}
+
+		if (ptrace (PT_CONTINUE, pid, (caddr_t) 1, 0))
+			break;
+	}
+
+ out:
+	if ((result != COMMAND_ERROR_NONE) && (result != COMMAND_ERROR_CANNOT_START_TARGET)) {
+		kill (pid, SIGKILL);
+		waitpid (pid, &status, __WALL);
+	}
+
+	g_static_mutex_unlock (&wait_mutex);
+	return result;
+}
+
 static ServerCommandError
 server_ptrace_stop (ServerHandle *handle)
 {
 	ServerCommandError result;
+	int ret;
+
+	/* Don't let a conditional breakpoint swallow the stop we're requesting. */
+	handle->inferior->stop_pending = TRUE;
 
 	/*
 	 * Try to get the thread's registers.  If we suceed, then it's already stopped
@@ -363,7 +859,22 @@ server_ptrace_stop (ServerHandle *handle)
 	if (result == COMMAND_ERROR_NONE)
 		return COMMAND_ERROR_ALREADY_STOPPED;
 
-	if (syscall (__NR_tkill, handle->inferior->pid, SIGSTOP)) {
+	if (use_ptrace_seize) {
+		g_static_mutex_lock (&new_thread_mutex);
+		g_hash_table_insert (interrupted_pids, GINT_TO_POINTER (handle->inferior->pid),
+				     GINT_TO_POINTER (1));
+		g_static_mutex_unlock (&new_thread_mutex);
+
+		ret = ptrace (PTRACE_INTERRUPT, handle->inferior->pid, NULL, 0);
+		if (ret) {
+			g_static_mutex_lock (&new_thread_mutex);
+			g_hash_table_remove (interrupted_pids, GINT_TO_POINTER (handle->inferior->pid));
+			g_static_mutex_unlock (&new_thread_mutex);
+		}
+	} else
+		ret = syscall (__NR_tkill, handle->inferior->pid, SIGSTOP);
+
+	if (ret) {
 		/*
 		 * It's already dead.
 		 */
@@ -440,6 +951,8 @@ server_ptrace_stop_and_wait (ServerHandle *handle, guint32 *status)
 			   handle->inferior->pid, ret, status);
 #endif
 	} while (ret == 0);
+	if (ret > 0)
+		check_new_thread_stop (ret, *status);
 	g_static_mutex_unlock (&wait_mutex);
 	g_static_mutex_unlock (&wait_mutex_3);
 
@@ -452,6 +965,103 @@ server_ptrace_stop_and_wait (ServerHandle *handle, guint32 *status)
 	return COMMAND_ERROR_NONE;
 }
 
+static ServerCommandError
+server_ptrace_stop_all (ServerHandle **handles, guint32 count, ServerCommandError *results,
+			guint32 *status_ret)
+{
+	gboolean *already_stopped, *done;
+	guint32 *pids;
+	guint32 i;
+
+	already_stopped = g_new0 (gboolean, count);
+	done = g_new0 (gboolean, count);
+	pids = g_new0 (guint32, count);
+
+	/*
+	 * Send all the signals first, so the threads stop in parallel.
+	 */
+	g_static_mutex_lock (&wait_mutex_2);
+	for (i = 0; i < count; i++) {
+		pids [i] = handles [i]->inferior->pid;
+		status_ret [i] = 0;
+
+		/*
+		 * The global wait only needs to look out for the threads we're
+		 * actually stopping; the others are collected below.
+		 */
+		results [i] = server_ptrace_stop (handles [i]);
+		if (results [i] == COMMAND_ERROR_ALREADY_STOPPED) {
+			already_stopped [i] = TRUE;
+			results [i] = COMMAND_ERROR_NONE;
+			done [i] = TRUE;
+		} else if (results [i] != COMMAND_ERROR_NONE)
+			done [i] = TRUE;
+	}
+
+	/*
+	 * Like in server_ptrace_stop_and_wait(), the global wait may be sleeping
+	 * in waitpid() and collect some of the stops for us.
+	 */
+	g_static_mutex_lock (&wait_mutex_3);
+
+	stop_all_count = count;
+	stop_all_pids = pids;
+	stop_all_status = status_ret;
+	stop_all_done = done;
+	g_static_mutex_unlock (&wait_mutex_2);
+
+	g_static_mutex_lock (&wait_mutex);
+
+	g_static_mutex_lock (&wait_mutex_2);
+	stop_all_count = 0;
+	stop_all_pids = NULL;
+	stop_all_status = NULL;
+	stop_all_done = NULL;
+	g_static_mutex_unlock (&wait_mutex_2);
+
+	for (i = 0; i < count; i++) {
+		int ret;
+
+		if (results [i] != COMMAND_ERROR_NONE)
+			continue;
+
+		/*
+		 * An already stopped thread may or may not have a status pending; don't
+		 * block on it.
+		 */
+		if (already_stopped [i]) {
+			if (do_wait (pids [i], &status_ret [i], TRUE) > 0)
+				check_new_thread_stop (pids [i], status_ret [i]);
+			else
+				status_ret [i] = 0;
+			continue;
+		}
+
+		/* The global wait already got it. */
+		if (done [i])
+			continue;
+
+		do {
+			ret = do_wait (pids [i], &status_ret [i], FALSE);
+		} while (ret == 0);
+
+		if (ret > 0)
+			check_new_thread_stop (ret, status_ret [i]);
+
+		if (ret < 0)
+			results [i] = COMMAND_ERROR_NO_TARGET;
+	}
+
+	g_static_mutex_unlock (&wait_mutex);
+	g_static_mutex_unlock (&wait_mutex_3);
+
+	g_free (already_stopped);
+	g_free (done);
+	g_free (pids);
+
+	return COMMAND_ERROR_NONE;
+}
+
 static ServerCommandError
 _server_ptrace_setup_inferior (ServerHandle *handle)
 {
@@ -459,7 +1069,15 @@ _server_ptrace_setup_inferior (ServerHandle *handle)
 
 	x86_arch_remove_hardware_breakpoints (handle);
 
-	handle->inferior->os.mem_fd = open64 (filename, O_RDONLY);
+	/*
+	 * Open it read-write if we can, so server_ptrace_write_memory() can use pwrite();
+	 * some kernels don't allow writing to /proc/pid/mem.
+	 */
+	handle->inferior->os.mem_fd = open64 (filename, O_RDWR);
+	handle->inferior->os.mem_fd_writable = handle->inferior->os.mem_fd >= 0;
+
+	if (handle->inferior->os.mem_fd < 0)
+		handle->inferior->os.mem_fd = open64 (filename, O_RDONLY);
 
 	if (handle->inferior->os.mem_fd < 0) {
 		if (errno == EACCES)
@@ -483,10 +1101,7 @@ _server_ptrace_finalize_inferior (ServerHandle *handle)
 static ServerCommandError
 server_ptrace_initialize_process (ServerHandle *handle)
 {
-	int flags = PTRACE_O_TRACECLONE | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK |
-		PTRACE_O_TRACEEXEC;
-
-	if (ptrace (PTRACE_SETOPTIONS, handle->inferior->pid, 0, flags)) {
+	if (ptrace (PTRACE_SETOPTIONS, handle->inferior->pid, 0, PTRACE_TRACE_OPTIONS)) {
 		g_warning (G_STRLOC ": Can't PTRACE_SETOPTIONS %d: %s",
 			   handle->inferior->pid, g_strerror (errno));
 		return COMMAND_ERROR_UNKNOWN_ERROR;
@@ -528,11 +1143,54 @@ server_ptrace_get_signal_info (ServerHandle *handle, SignalInfo **sinfo_out)
 	return COMMAND_ERROR_NONE;
 }
 
+/*
+ * The only reliable way of finding out whether the kernel supports PTRACE_SEIZE is
+ * trying it: ptrace() doesn't have a feature query and the kernel version doesn't
+ * tell us about backports or security modules.  So we fork a child which just sleeps
+ * in pause(), seize it and kill it again.
+ */
+static gboolean
+check_ptrace_seize (void)
+{
+	gboolean supported;
+	int pid, ret, status;
+
+	pid = fork ();
+	if (pid < 0)
+		return FALSE;
+	else if (pid == 0) {
+		for (;;)
+			pause ();
+	}
+
+	supported = ptrace (PTRACE_SEIZE, pid, NULL, 0) == 0;
+
+	kill (pid, SIGKILL);
+	do {
+		ret = waitpid (pid, &status, __WALL);
+	} while (((ret < 0) && (errno == EINTR)) ||
+		 ((ret == pid) && !WIFEXITED (status) && !WIFSIGNALED (status)));
+
+	return supported;
+}
+
 static void
 server_ptrace_global_init (void)
 {
 	stop_requested = 0;
 	stop_status = 0;
+
+	/*
+	 * This forks a probe child, see check_ptrace_seize().  It's done once here and
+	 * not on each launch/attach because we need to know the mode before any thread
+	 * is created.
+	 */
+	use_ptrace_seize = check_ptrace_seize ();
+
+	if (!interrupted_pids)
+		interrupted_pids = g_hash_table_new (NULL, NULL);
+	if (!new_thread_stops)
+		new_thread_stops = g_hash_table_new (NULL, NULL);
 }
 
 static ServerCommandError
@@ -677,7 +1335,7 @@ server_ptrace_detach_after_fork (ServerHandle *handle)
 	if (result != COMMAND_ERROR_NONE)
 		return result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
 
 	breakpoints = mono_debugger_breakpoint_manager_get_breakpoints (handle->bpm);
 	for (i = 0; i < breakpoints->len; i++) {
@@ -686,7 +1344,7 @@ server_ptrace_detach_after_fork (ServerHandle *handle)
 		x86_arch_disable_breakpoint (handle, info);
 	}
 
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
 
 	if (ptrace (PT_DETACH, handle->inferior->pid, NULL, NULL) != 0)
 		return _server_ptrace_check_errno (handle->inferior);
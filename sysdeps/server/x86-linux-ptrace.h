@@ -3,9 +3,16 @@
 
 #include "x86-arch.h"
 
+#if defined(HAVE_PROCESS_VM_READV) || defined(HAVE_PROCESS_VM_WRITEV)
+#include <sys/uio.h>
+#include <limits.h>
+#endif
+
 struct OSData
 {
 	int mem_fd;
+	gboolean mem_fd_writable;
+	gboolean group_stop;
 };
 
 #include "x86-ptrace.h"
@@ -51,6 +51,567 @@ struct IOThreadData
 	int output_fd, error_fd;
 };
 
+/*
+ * The runtime's breakpoint table and executable code buffer slots are tracked in
+ * word-packed bitmaps; a set bit means the slot is in use.
+ */
+
+#define SLOT_BITMAP_WORDS(size)		(((size) + 31) / 32)
+
+static guint32 *
+slot_bitmap_resize (guint32 *bitmap, guint32 old_size, guint32 new_size)
+{
+	guint32 old_words = SLOT_BITMAP_WORDS (old_size);
+	guint32 new_words = SLOT_BITMAP_WORDS (new_size);
+
+	if (bitmap && (new_words <= old_words))
+		return bitmap;
+
+	bitmap = g_renew (guint32, bitmap, new_words);
+	memset (bitmap + old_words, 0, (new_words - old_words) * sizeof (guint32));
+	return bitmap;
+}
+
+static int
+slot_bitmap_alloc (guint32 *bitmap, guint32 size, guint32 start)
+{
+	guint32 words = SLOT_BITMAP_WORDS (size);
+	guint32 i;
+
+	for (i = start / 32; i < words; i++) {
+		guint32 available = ~bitmap [i];
+		int slot;
+
+		if (i == start / 32)
+			available &= ~0U << (start % 32);
+		if (!available)
+			continue;
+
+		slot = i * 32 + g_bit_nth_lsf (available, -1);
+		if (slot >= size)
+			return -1;
+
+		bitmap [i] |= 1U << (slot % 32);
+		return slot;
+	}
+
+	return -1;
+}
+
+static void
+runtime_free_breakpoint_slot (MonoRuntimeInfo *runtime, int slot)
+{
+	runtime->breakpoint_table_bitfield [slot / 32] &= ~(1U << (slot % 32));
+	if (slot < runtime->breakpoint_table_first_free)
+		runtime->breakpoint_table_first_free = slot;
+}
+
+static int
+runtime_alloc_breakpoint_slot (MonoRuntimeInfo *runtime)
+{
+	int slot;
+
+	/* Every slot below `breakpoint_table_first_free' is in use. */
+	slot = slot_bitmap_alloc (runtime->breakpoint_table_bitfield, runtime->breakpoint_table_size,
+				  runtime->breakpoint_table_first_free);
+	if (slot >= 0)
+		runtime->breakpoint_table_first_free = slot + 1;
+	return slot;
+}
+
+static void
+runtime_free_code_buffer_slot (MonoRuntimeInfo *runtime, int slot)
+{
+	runtime->executable_code_bitfield [slot / 32] &= ~(1U << (slot % 32));
+}
+
+static int
+runtime_alloc_code_buffer_slot (MonoRuntimeInfo *runtime)
+{
+	int slot;
+
+	/* Hand out slots round-robin so that a chunk isn't reused right after it's been freed. */
+	slot = slot_bitmap_alloc (runtime->executable_code_bitfield, runtime->executable_code_total_chunks,
+				  runtime->executable_code_last_slot + 1);
+	if (slot < 0)
+		slot = slot_bitmap_alloc (runtime->executable_code_bitfield,
+					  runtime->executable_code_total_chunks, 0);
+	if (slot >= 0)
+		runtime->executable_code_last_slot = slot;
+	return slot;
+}
+
+static int
+runtime_alloc_code_buffer_range (MonoRuntimeInfo *runtime, guint32 count)
+{
+	guint32 *bitmap = runtime->executable_code_bitfield;
+	guint32 start = 0, i;
+
+	while (start + count <= runtime->executable_code_total_chunks) {
+		for (i = 0; i < count; i++) {
+			if (bitmap [(start + i) / 32] & (1U << ((start + i) % 32)))
+				break;
+		}
+
+		if (i < count) {
+			start += i + 1;
+			continue;
+		}
+
+		for (i = 0; i < count; i++)
+			bitmap [(start + i) / 32] |= 1U << ((start + i) % 32);
+		return start;
+	}
+
+	return -1;
+}
+
+static void
+runtime_free_code_buffer_range (MonoRuntimeInfo *runtime, int slot, guint32 count)
+{
+	guint32 i;
+
+	for (i = 0; i < count; i++)
+		runtime_free_code_buffer_slot (runtime, slot + i);
+}
+
+/*
+ * A breakpoint condition's trampoline holds a copy of the original instruction followed
+ * by a jump back; it needs more room than a single code buffer chunk.
+ */
+
+#define BREAKPOINT_TRAMPOLINE_CHUNKS	2
+
+static gboolean
+breakpoint_condition_is_valid (const guint8 *code, guint32 size)
+{
+	guint32 pos = 0, regnum;
+	int depth = 0;
+
+	while (pos < size) {
+		switch (code [pos++]) {
+		case BREAKPOINT_CONDITION_REGISTER:
+			if (pos + 4 > size)
+				return FALSE;
+			memcpy (&regnum, code + pos, 4);
+			if (regnum >= DEBUGGER_REG_LAST)
+				return FALSE;
+			pos += 4;
+			depth++;
+			break;
+
+		case BREAKPOINT_CONDITION_CONSTANT:
+			if (pos + 8 > size)
+				return FALSE;
+			pos += 8;
+			depth++;
+			break;
+
+		case BREAKPOINT_CONDITION_LOAD:
+			if ((pos + 1 > size) || (depth < 1))
+				return FALSE;
+			switch (code [pos++] & ~BREAKPOINT_CONDITION_SIGN_EXTEND) {
+			case 1: case 2: case 4: case 8:
+				break;
+			default:
+				return FALSE;
+			}
+			break;
+
+		case BREAKPOINT_CONDITION_NOT:
+			if (depth < 1)
+				return FALSE;
+			break;
+
+		case BREAKPOINT_CONDITION_ADD:
+		case BREAKPOINT_CONDITION_EQ:
+		case BREAKPOINT_CONDITION_NE:
+		case BREAKPOINT_CONDITION_LT:
+		case BREAKPOINT_CONDITION_LE:
+		case BREAKPOINT_CONDITION_GT:
+		case BREAKPOINT_CONDITION_GE:
+		case BREAKPOINT_CONDITION_AND:
+		case BREAKPOINT_CONDITION_OR:
+			if (depth < 2)
+				return FALSE;
+			depth--;
+			break;
+
+		default:
+			return FALSE;
+		}
+
+		if (depth > BREAKPOINT_CONDITION_STACK_SIZE)
+			return FALSE;
+	}
+
+	return depth == 1;
+}
+
+/*
+ * The bytecode has already been checked by breakpoint_condition_is_valid().
+ */
+static ServerCommandError
+evaluate_breakpoint_condition (ServerHandle *handle, BreakpointInfo *info, gboolean *result)
+{
+	gint64 stack [BREAKPOINT_CONDITION_STACK_SIZE];
+	guint64 regs [DEBUGGER_REG_LAST];
+	const guint8 *code = info->condition;
+	guint32 pos = 0, regnum;
+	ServerCommandError error;
+	int sp = 0;
+
+	error = server_ptrace_get_registers (handle, regs);
+	if (error != COMMAND_ERROR_NONE)
+		return error;
+
+	/*
+	 * We're stopped right behind the breakpoint instruction; hardware breakpoints
+	 * and watchpoints are reported with the real IP.
+	 */
+	if (!info->is_hardware_bpt)
+		regs [DEBUGGER_REG_RIP] = info->address;
+
+	while (pos < info->condition_size) {
+		guint8 opcode = code [pos++];
+		gint64 a, b;
+
+		switch (opcode) {
+		case BREAKPOINT_CONDITION_REGISTER:
+			memcpy (&regnum, code + pos, 4);
+			pos += 4;
+			stack [sp++] = regs [regnum];
+			continue;
+
+		case BREAKPOINT_CONDITION_CONSTANT:
+			memcpy (&stack [sp++], code + pos, 8);
+			pos += 8;
+			continue;
+
+		case BREAKPOINT_CONDITION_LOAD: {
+			guint8 size = code [pos] & ~BREAKPOINT_CONDITION_SIGN_EXTEND;
+			gboolean sign_extend = (code [pos] & BREAKPOINT_CONDITION_SIGN_EXTEND) != 0;
+			guint64 value = 0;
+
+			pos++;
+			error = server_ptrace_read_memory (handle, stack [sp - 1], size, &value);
+			if (error != COMMAND_ERROR_NONE)
+				return error;
+
+			if (sign_extend && (size < 8) && (value & (1ULL << (size * 8 - 1))))
+				value |= ~0ULL << (size * 8);
+			stack [sp - 1] = value;
+			continue;
+		}
+
+		case BREAKPOINT_CONDITION_NOT:
+			stack [sp - 1] = !stack [sp - 1];
+			continue;
+		}
+
+		b = stack [--sp];
+		a = stack [sp - 1];
+
+		switch (opcode) {
+		case BREAKPOINT_CONDITION_ADD:
+			a += b;
+			break;
+		case BREAKPOINT_CONDITION_EQ:
+			a = a == b;
+			break;
+		case BREAKPOINT_CONDITION_NE:
+			a = a != b;
+			break;
+		case BREAKPOINT_CONDITION_LT:
+			a = a < b;
+			break;
+		case BREAKPOINT_CONDITION_LE:
+			a = a <= b;
+			break;
+		case BREAKPOINT_CONDITION_GT:
+			a = a > b;
+			break;
+		case BREAKPOINT_CONDITION_GE:
+			a = a >= b;
+			break;
+		case BREAKPOINT_CONDITION_AND:
+			a = a && b;
+			break;
+		case BREAKPOINT_CONDITION_OR:
+			a = a || b;
+			break;
+		}
+
+		stack [sp - 1] = a;
+	}
+
+	*result = stack [0] != 0;
+	return COMMAND_ERROR_NONE;
+}
+
+/*
+ * Runs the tracepoint actions of `info' and appends the collected data to the trace
+ * buffer.  Must be called with the lock held.
+ */
+static void
+collect_trace_frame (ServerHandle *handle, BreakpointInfo *info)
+{
+	guint64 regs [DEBUGGER_REG_LAST];
+	guint8 data [TRACEPOINT_MAX_MEMORY_SIZE];
+	const guint8 *code = info->actions;
+	TraceFrameHeader header;
+	GByteArray *frame;
+	guint32 pos = 0;
+
+	if (server_ptrace_get_registers (handle, regs) != COMMAND_ERROR_NONE)
+		return;
+
+	/* We're stopped right behind the breakpoint instruction. */
+	regs [DEBUGGER_REG_RIP] = info->address;
+
+	frame = g_byte_array_new ();
+
+	header.size = 0;
+	header.breakpoint = info->id;
+	header.thread = handle->inferior->pid;
+	header.reserved = 0;
+	g_byte_array_append (frame, (guint8 *) &header, sizeof (header));
+
+	while (pos < info->actions_size) {
+		guint8 opcode = code [pos++];
+
+		if (opcode == TRACEPOINT_ACTION_REGISTERS) {
+			guint32 count = DEBUGGER_REG_LAST;
+
+			g_byte_array_append (frame, &opcode, 1);
+			g_byte_array_append (frame, (guint8 *) &count, 4);
+			g_byte_array_append (frame, (guint8 *) regs, sizeof (regs));
+		} else if (opcode == TRACEPOINT_ACTION_MEMORY) {
+			gint32 regnum;
+			gint64 offset;
+			guint32 size;
+			guint64 address;
+
+			memcpy (&regnum, code + pos, 4);
+			memcpy (&offset, code + pos + 4, 8);
+			memcpy (&size, code + pos + 12, 4);
+			pos += 16;
+
+			address = offset;
+			if ((regnum >= 0) && (regnum < DEBUGGER_REG_LAST))
+				address += regs [regnum];
+
+			if (server_ptrace_read_memory (handle, address, size, data) != COMMAND_ERROR_NONE)
+				size = 0;
+
+			g_byte_array_append (frame, &opcode, 1);
+			g_byte_array_append (frame, (guint8 *) &address, 8);
+			g_byte_array_append (frame, (guint8 *) &size, 4);
+			g_byte_array_append (frame, data, size);
+		}
+	}
+
+	((TraceFrameHeader *) frame->data)->size = frame->len;
+	mono_debugger_breakpoint_manager_add_trace_frame (handle->bpm, frame->data, frame->len);
+	g_byte_array_free (frame, TRUE);
+}
+
+/*
+ * Called when we hit the breakpoint at `address'.  Evaluates its thread filter and
+ * condition and updates its hit count.  If this thread doesn't stop there, the condition
+ * is false or the hit is to be ignored, returns the address of its trampoline, where the
+ * target can just continue.  Returns 0 if the breakpoint must be reported.
+ *
+ * Tracepoints collect their data and always continue.
+ *
+ * While single-stepping or being stopped, the breakpoint is always reported, so the
+ * caller sees the stop it is waiting for.
+ */
+static guint64
+check_breakpoint_condition (ServerHandle *handle, guint64 address)
+{
+	BreakpointInfo *info;
+	guint64 trampoline = 0;
+	gboolean hit = TRUE;
+
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
+	info = mono_debugger_breakpoint_manager_lookup (handle->bpm, address);
+	if (!info || !info->enabled)
+		goto out;
+
+	/* We're going to count the hit. */
+	if (mono_debugger_breakpoint_manager_unshare (handle->bpm))
+		info = mono_debugger_breakpoint_manager_lookup (handle->bpm, address);
+
+	if (!mono_debugger_breakpoint_info_stops_thread (info, handle->inferior->pid))
+		hit = FALSE;
+	else if (info->condition &&
+		 (evaluate_breakpoint_condition (handle, info, &hit) != COMMAND_ERROR_NONE))
+		hit = TRUE;
+
+	if (hit) {
+		info->hit_count++;
+		if (info->actions)
+			collect_trace_frame (handle, info);
+		else if (info->hit_count > info->ignore_count)
+			goto out;
+	}
+
+	if (!handle->inferior->stepping && !handle->inferior->stop_pending)
+		trampoline = info->trampoline;
+
+ out:
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
+	return trampoline;
+}
+
+/*
+ * Hardware watchpoint `id' triggered; the access has already been done.  Returns FALSE
+ * if the target may just continue because the watched value didn't change or the
+ * condition is false for the new value.
+ *
+ * While single-stepping or being stopped, the watchpoint is always reported.
+ */
+static gboolean
+check_watch_value (ServerHandle *handle, BreakpointManager *hw_bpm, guint32 id)
+{
+	BreakpointInfo *info;
+	guint64 value = 0;
+	gboolean hit = TRUE;
+
+	mono_debugger_breakpoint_manager_lock (hw_bpm);
+	info = mono_debugger_breakpoint_manager_lookup_by_id (hw_bpm, id);
+	if (!info || !info->enabled)
+		goto out;
+
+	if (info->watch_size) {
+		/* We're about to modify `watch_value'. */
+		if (mono_debugger_breakpoint_manager_unshare (hw_bpm))
+			info = mono_debugger_breakpoint_manager_lookup_by_id (hw_bpm, id);
+
+		if (server_ptrace_read_memory (handle, info->address, info->watch_size, &value) != COMMAND_ERROR_NONE)
+			goto out;
+
+		if (value == info->watch_value)
+			hit = FALSE;
+		info->watch_value = value;
+	}
+
+	if (hit && info->condition &&
+	    (evaluate_breakpoint_condition (handle, info, &hit) != COMMAND_ERROR_NONE))
+		hit = TRUE;
+
+	if (handle->inferior->stepping || handle->inferior->stop_pending)
+		hit = TRUE;
+
+ out:
+	mono_debugger_breakpoint_manager_unlock (hw_bpm);
+	return hit;
+}
+
+/*
+ * Check whether a SIGSEGV comes from one of the pages the debugger protected for its
+ * page-protection watchpoints.  If so, `retval' is the id of the watch range which has
+ * been hit (zero if the access was just somewhere else on the same page) and `retval2'
+ * the faulting address; the debugger re-executes the access with the page unprotected.
+ *
+ * We can't tell reads from writes, so a read from a page which also has a read watch
+ * may be reported as a write to a write watch on that page.
+ */
+static gboolean
+check_watch_fault (ServerHandle *handle, guint64 *retval, guint64 *retval2)
+{
+	BreakpointManager *bpm = handle->bpm;
+	WatchRange *range;
+	guint64 address, page;
+	gboolean found = FALSE;
+
+	if (_server_ptrace_get_fault_address (handle->inferior, &address) != COMMAND_ERROR_NONE)
+		return FALSE;
+
+	mono_debugger_breakpoint_manager_lock (bpm);
+	if (!bpm->table->watch_ranges->len || bpm->watch_suspended)
+		goto out;
+
+	page = address & ~((guint64) bpm->page_size - 1);
+	if (!mono_debugger_breakpoint_manager_lookup_watch_range (bpm, page, page + bpm->page_size))
+		goto out;
+
+	range = mono_debugger_breakpoint_manager_lookup_watch_range (bpm, address, address + 1);
+	*retval = range ? range->id : 0;
+	*retval2 = address;
+	found = TRUE;
+
+ out:
+	mono_debugger_breakpoint_manager_unlock (bpm);
+	return found;
+}
+
+static void
+clear_breakpoint_condition (BreakpointInfo *info)
+{
+	g_free (info->condition);
+	info->condition = NULL;
+	info->condition_size = 0;
+	info->ignore_count = 0;
+}
+
+/*
+ * Another thread may still be inside the trampoline when its breakpoint is removed, so
+ * its code buffer chunks are only retired here; server_ptrace_free_retired_trampolines()
+ * frees them once we know that no thread's IP is inside.
+ */
+static void
+free_breakpoint_condition (ServerHandle *handle, BreakpointInfo *info)
+{
+	MonoRuntimeInfo *runtime = handle->mono_runtime;
+
+	if (info->trampoline && runtime) {
+		if (!runtime->retired_trampolines)
+			runtime->retired_trampolines = g_array_new (FALSE, FALSE, sizeof (gint32));
+		g_array_append_val (runtime->retired_trampolines, info->trampoline_slot);
+	}
+
+	clear_breakpoint_condition (info);
+	info->trampoline = 0;
+	info->trampoline_slot = -1;
+}
+
+static ServerCommandError
+server_ptrace_free_retired_trampolines (ServerHandle *handle, const guint64 *ips, guint32 count)
+{
+	MonoRuntimeInfo *runtime = handle->mono_runtime;
+	guint64 start, end;
+	guint32 trampoline_size, i, j;
+	gint32 slot;
+
+	if (!runtime || !runtime->retired_trampolines)
+		return COMMAND_ERROR_NONE;
+
+	trampoline_size = BREAKPOINT_TRAMPOLINE_CHUNKS * runtime->executable_code_chunk_size;
+
+	for (i = 0; i < runtime->retired_trampolines->len; ) {
+		slot = g_array_index (runtime->retired_trampolines, gint32, i);
+		start = runtime->executable_code_buffer + slot * runtime->executable_code_chunk_size;
+		end = start + trampoline_size;
+
+		for (j = 0; j < count; j++) {
+			if ((ips [j] >= start) && (ips [j] < end))
+				break;
+		}
+
+		if (j < count) {
+			i++;
+			continue;
+		}
+
+		runtime_free_code_buffer_range (runtime, slot, BREAKPOINT_TRAMPOLINE_CHUNKS);
+		g_array_remove_index_fast (runtime->retired_trampolines, i);
+	}
+
+	return COMMAND_ERROR_NONE;
+}
+
 MonoRuntimeInfo *
 mono_debugger_server_initialize_mono_runtime (guint32 address_size,
 					      guint64 notification_address,
@@ -73,8 +634,12 @@ mono_debugger_server_initialize_mono_runtime (guint32 address_size,
 	runtime->breakpoint_table = breakpoint_table;
 	runtime->breakpoint_table_size = breakpoint_table_size;
 
-	runtime->breakpoint_table_bitfield = g_malloc0 (breakpoint_table_size);
-	runtime->executable_code_bitfield = g_malloc0 (runtime->executable_code_total_chunks);
+	/* Slot 0 of the breakpoint table is never used. */
+	runtime->breakpoint_table_first_free = 1;
+
+	runtime->breakpoint_table_bitfield = slot_bitmap_resize (NULL, 0, breakpoint_table_size);
+	runtime->executable_code_bitfield = slot_bitmap_resize (
+		NULL, 0, runtime->executable_code_total_chunks);
 
 	return runtime;
 }
@@ -84,10 +649,15 @@ mono_debugger_server_initialize_code_buffer (MonoRuntimeInfo *runtime,
 					     guint64 executable_code_buffer,
 					     guint32 executable_code_buffer_size)
 {
+	guint32 total_chunks = executable_code_buffer_size / EXECUTABLE_CODE_CHUNK_SIZE;
+
+	runtime->executable_code_bitfield = slot_bitmap_resize (
+		runtime->executable_code_bitfield, runtime->executable_code_total_chunks, total_chunks);
+
 	runtime->executable_code_buffer = executable_code_buffer;
 	runtime->executable_code_buffer_size = executable_code_buffer_size;
 	runtime->executable_code_chunk_size = EXECUTABLE_CODE_CHUNK_SIZE;
-	runtime->executable_code_total_chunks = executable_code_buffer_size / EXECUTABLE_CODE_CHUNK_SIZE;
+	runtime->executable_code_total_chunks = total_chunks;
 }
 
 void
@@ -124,6 +694,12 @@ static ServerCommandError
 server_ptrace_detach (ServerHandle *handle)
 {
 	InferiorHandle *inferior = handle->inferior;
+	ServerCommandError result;
+
+	result = x86_arch_flush_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+	x86_arch_invalidate_registers (handle);
 
 	if (ptrace (PT_DETACH, inferior->pid, NULL, 0)) {
 		g_message (G_STRLOC ": %d - %s", inferior->pid, g_strerror (errno));
@@ -139,11 +715,32 @@ server_ptrace_peek_word (ServerHandle *handle, guint64 start, guint64 *retval)
 	return server_ptrace_read_memory (handle, start, sizeof (gsize), retval);
 }
 
+static ServerCommandError
+server_ptrace_set_stop_pending (ServerHandle *handle)
+{
+	handle->inferior->stop_pending = TRUE;
+	return COMMAND_ERROR_NONE;
+}
+
 static ServerStatusMessageType
 server_ptrace_dispatch_event (ServerHandle *handle, guint32 status, guint64 *arg,
 			      guint64 *data1, guint64 *data2, guint32 *opt_data_size,
 			      gpointer *opt_data)
 {
+#ifdef __linux__
+	if ((status >> 16) == PTRACE_EVENT_STOP) {
+		int stopsig = WSTOPSIG (status);
+
+		/*
+		 * PTRACE_SEIZE mode: this is either a group-stop or the result of a
+		 * PTRACE_INTERRUPT.  Report both like the SIGSTOP we'd otherwise use.
+		 */
+		handle->inferior->os.group_stop = (stopsig == SIGSTOP) || (stopsig == SIGTSTP) ||
+			(stopsig == SIGTTIN) || (stopsig == SIGTTOU);
+		status = (SIGSTOP << 8) | 0x7f;
+	}
+#endif
+
 	#ifdef PTRACE_EVENT_CLONE
 	if (status >> 16) {
 		switch (status >> 16) {
@@ -260,6 +857,17 @@ server_ptrace_dispatch_event (ServerHandle *handle, guint32 status, guint64 *arg
 
 		case STOP_ACTION_INTERNAL_ERROR:
 			return MESSAGE_INTERNAL_ERROR;
+
+		case STOP_ACTION_RESUME:
+			if (server_ptrace_continue (handle) != COMMAND_ERROR_NONE)
+				return MESSAGE_INTERNAL_ERROR;
+			*arg = 0;
+			return MESSAGE_CHILD_RESUMED;
+
+		case STOP_ACTION_WATCH_FAULT:
+			*arg = retval;
+			*data1 = retval2;
+			return MESSAGE_CHILD_WATCH_FAULT;
 		}
 
 		g_assert_not_reached ();
@@ -283,7 +891,10 @@ server_ptrace_dispatch_event (ServerHandle *handle, guint32 status, guint64 *arg
 static ServerStatusMessageType
 server_ptrace_dispatch_simple (guint32 status, guint32 *arg)
 {
-	if (status >> 16)
+	if ((status >> 16) == PTRACE_EVENT_STOP) {
+		*arg = 0;
+		return MESSAGE_CHILD_STOPPED;
+	} else if (status >> 16)
 		return MESSAGE_UNKNOWN_ERROR;
 
 	if (WIFSTOPPED (status)) {
@@ -332,6 +943,14 @@ server_ptrace_create_inferior (BreakpointManager *bpm)
 static void
 child_setup_func (InferiorHandle *inferior)
 {
+#ifdef __linux__
+	if (_server_ptrace_using_seize ()) {
+		/*
+		 * Wait for the debugger to PTRACE_SEIZE us.
+		 */
+		raise (SIGSTOP);
+	} else
+#endif
 	if (ptrace (PT_TRACE_ME, getpid (), NULL, 0))
 		g_error (G_STRLOC ": Can't PT_TRACEME: %s", g_strerror (errno));
 
@@ -410,6 +1029,15 @@ server_ptrace_spawn (ServerHandle *handle, const gchar *working_directory,
 	}
 	close (fd [1]);
 
+#ifdef __linux__
+	/*
+	 * In PTRACE_SEIZE mode, the child stops itself before calling execve() and we
+	 * need to seize it and let it exec before checking for an error.
+	 */
+	if (_server_ptrace_using_seize ())
+		result = _server_ptrace_seize_new_child (handle, *child_pid);
+#endif
+
 	ret = read (fd [0], &len, sizeof (len));
 
 	if (ret != 0) {
@@ -429,6 +1057,12 @@ server_ptrace_spawn (ServerHandle *handle, const gchar *working_directory,
 
 	inferior->pid = *child_pid;
 
+#ifdef __linux__
+	if (_server_ptrace_using_seize ()) {
+		if (result != COMMAND_ERROR_NONE)
+			return result;
+	} else
+#endif
 #ifndef __MACH__
 	if (!_server_ptrace_wait_for_new_thread (handle))
 		return COMMAND_ERROR_INTERNAL_ERROR;
@@ -473,8 +1107,16 @@ static ServerCommandError
 server_ptrace_attach (ServerHandle *handle, guint32 pid)
 {
 	InferiorHandle *inferior = handle->inferior;
+	int ret;
+
+#ifdef __linux__
+	if (_server_ptrace_using_seize ())
+		ret = _server_ptrace_seize_attach (pid);
+	else
+#endif
+		ret = ptrace (PT_ATTACH, pid, NULL, 0);
 
-	if (ptrace (PT_ATTACH, pid, NULL, 0) != 0) {
+	if (ret != 0) {
 		g_warning (G_STRLOC ": Can't attach to %d - %s", pid,
 			   g_strerror (errno));
 		return COMMAND_ERROR_CANNOT_START_TARGET;
@@ -491,25 +1133,111 @@ server_ptrace_attach (ServerHandle *handle, guint32 pid)
 	return _server_ptrace_setup_inferior (handle);
 }
 
+/*
+ * The target's output is collected in a buffer and handed to managed code in large
+ * chunks, either when the buffer is full or `flush_latency' milliseconds after the
+ * first byte arrived.  The buffer only ever holds data from one stream, so switching
+ * between stdout and stderr flushes it to preserve the ordering.
+ */
+
+#define OUTPUT_BUFFER_SIZE	65536
+
+typedef struct
+{
+	char data [OUTPUT_BUFFER_SIZE + 1];
+	guint32 count;
+	gboolean is_stderr;
+	GTimeVal first_output;
+	ChildOutputFunc func;
+	int tee_fd;
+} OutputBuffer;
+
 static void
-process_output (int fd, gboolean is_stderr, ChildOutputFunc func)
+flush_output (OutputBuffer *buffer)
+{
+	if (!buffer->count)
+		return;
+
+	buffer->data [buffer->count] = 0;
+	buffer->func (buffer->is_stderr, buffer->data);
+	buffer->count = 0;
+}
+
+static void
+tee_output (int fd, const char *data, int count)
+{
+	int ret;
+
+	while (count > 0) {
+		ret = write (fd, data, count);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+
+		data += ret;
+		count -= ret;
+	}
+}
+
+static int
+process_output (OutputBuffer *buffer, int fd, gboolean is_stderr)
 {
-	char buffer [BUFSIZ + 2];
 	int count;
 
-	count = read (fd, buffer, BUFSIZ);
-	if (count < 0)
-		return;
+	if (buffer->count && (buffer->is_stderr != is_stderr))
+		flush_output (buffer);
+
+	count = read (fd, buffer->data + buffer->count, OUTPUT_BUFFER_SIZE - buffer->count);
+	if (count <= 0)
+		return count;
 
-	buffer [count] = 0;
-	func (is_stderr, buffer);
+	if (buffer->tee_fd >= 0)
+		tee_output (buffer->tee_fd, buffer->data + buffer->count, count);
+
+	if (!buffer->count)
+		g_get_current_time (&buffer->first_output);
+
+	buffer->count += count;
+	buffer->is_stderr = is_stderr;
+
+	if (buffer->count == OUTPUT_BUFFER_SIZE)
+		flush_output (buffer);
+
+	return count;
+}
+
+static int
+output_flush_timeout (OutputBuffer *buffer, guint32 flush_latency)
+{
+	GTimeVal now;
+	gint64 elapsed;
+
+	if (!buffer->count)
+		return -1;
+
+	g_get_current_time (&now);
+	elapsed = (gint64) (now.tv_sec - buffer->first_output.tv_sec) * 1000 +
+		(now.tv_usec - buffer->first_output.tv_usec) / 1000;
+
+	if (elapsed >= flush_latency)
+		return 0;
+
+	return flush_latency - elapsed;
 }
 
 void
-server_ptrace_io_thread_main (IOThreadData *io_data, ChildOutputFunc func)
+server_ptrace_io_thread_main (IOThreadData *io_data, ChildOutputFunc func,
+			      guint32 flush_latency, gint32 tee_fd)
 {
+	OutputBuffer *buffer;
 	struct pollfd fds [2];
-	int ret;
+	int ret, timeout;
+
+	buffer = g_new0 (OutputBuffer, 1);
+	buffer->func = func;
+	buffer->tee_fd = tee_fd;
 
 	fds [0].fd = io_data->output_fd;
 	fds [0].events = POLLIN | POLLHUP | POLLERR;
@@ -519,21 +1247,42 @@ server_ptrace_io_thread_main (IOThreadData *io_data, ChildOutputFunc func)
 	fds [1].revents = 0;
 
 	while (1) {
-		ret = poll (fds, 2, -1);
+		timeout = output_flush_timeout (buffer, flush_latency);
+		if (timeout == 0) {
+			flush_output (buffer);
+			timeout = -1;
+		}
+
+		ret = poll (fds, 2, timeout);
 
 		if ((ret < 0) && (errno != EINTR))
 			break;
+		else if (ret <= 0)
+			continue;
 
 		if (fds [0].revents & POLLIN)
-			process_output (io_data->output_fd, FALSE, func);
+			process_output (buffer, io_data->output_fd, FALSE);
 		if (fds [1].revents & POLLIN)
-			process_output (io_data->error_fd, TRUE, func);
+			process_output (buffer, io_data->error_fd, TRUE);
 
 		if ((fds [0].revents & (POLLHUP | POLLERR))
-		    || (fds [1].revents & (POLLHUP | POLLERR)))
+		    || (fds [1].revents & (POLLHUP | POLLERR))) {
+			/*
+			 * Drain whatever is left in the pipe which has been closed.
+			 */
+			if (fds [0].revents & POLLHUP)
+				while (process_output (buffer, io_data->output_fd, FALSE) > 0)
+					;
+			if (fds [1].revents & POLLHUP)
+				while (process_output (buffer, io_data->error_fd, TRUE) > 0)
+					;
 			break;
+		}
 	}
 
+	flush_output (buffer);
+	g_free (buffer);
+
 	close (io_data->output_fd);
 	close (io_data->error_fd);
 	g_free (io_data);
@@ -597,6 +1346,356 @@ extern void GC_end_blocking (void);
 #error "Unknown architecture"
 #endif
 
+#define BREAKPOINT_PAGE_SIZE 4096
+
+static int
+compare_breakpoint_address (gconstpointer a, gconstpointer b)
+{
+	const BreakpointInfo *info_a = * (BreakpointInfo * const *) a;
+	const BreakpointInfo *info_b = * (BreakpointInfo * const *) b;
+
+	if (info_a->address < info_b->address)
+		return -1;
+	else if (info_a->address > info_b->address)
+		return 1;
+	return 0;
+}
+
+/*
+ * Insert the `int 3' instructions of the software breakpoints in `breakpoints' (which
+ * must be sorted by address), or restore the original instructions if `enable' is FALSE.
+ * The original instructions of all breakpoints on the same page are read at once, but
+ * only the opcode bytes themselves are written: the runtime may be patching other code
+ * on that page in the meantime.
+ */
+static ServerCommandError
+write_breakpoint_opcodes (ServerHandle *handle, BreakpointInfo **breakpoints, guint32 count,
+			  gboolean enable)
+{
+	guint32 first = 0;
+
+	while (first < count) {
+		guint64 start = breakpoints [first]->address;
+		guint64 page = start / BREAKPOINT_PAGE_SIZE;
+		ServerCommandError result = COMMAND_ERROR_NONE;
+		guint32 last = first, enabled = first, written = first, size, i;
+		guint8 *buffer;
+		guint8 opcode;
+
+		while ((last + 1 < count) &&
+		       (breakpoints [last + 1]->address / BREAKPOINT_PAGE_SIZE == page))
+			last++;
+
+		if (enable) {
+			size = (guint32) (breakpoints [last]->address - start) + 1;
+			buffer = g_malloc (size);
+
+			result = _server_ptrace_read_memory (handle, start, size, buffer);
+			if (result == COMMAND_ERROR_NONE) {
+				/*
+				 * Other breakpoints on this page may already be inserted.
+				 */
+				x86_arch_remove_breakpoints_from_target_memory (handle, start, size, buffer);
+				for (i = first; i <= last; i++)
+					breakpoints [i]->saved_insn = buffer [breakpoints [i]->address - start];
+			}
+
+			g_free (buffer);
+
+			while ((result == COMMAND_ERROR_NONE) && (enabled <= last) && handle->mono_runtime) {
+				result = runtime_info_enable_breakpoint (handle, breakpoints [enabled]);
+				if (result == COMMAND_ERROR_NONE)
+					enabled++;
+			}
+		}
+
+		while ((result == COMMAND_ERROR_NONE) && (written <= last)) {
+			opcode = enable ? 0xcc : breakpoints [written]->saved_insn;
+			result = server_ptrace_write_memory (handle, breakpoints [written]->address, 1, &opcode);
+			if (result == COMMAND_ERROR_NONE)
+				written++;
+		}
+
+		for (i = first; (result == COMMAND_ERROR_NONE) && !enable && (i <= last) &&
+			     handle->mono_runtime; i++)
+			result = runtime_info_disable_breakpoint (handle, breakpoints [i]);
+
+		if ((result != COMMAND_ERROR_NONE) && enable) {
+			/*
+			 * Don't leave anything half-done: roll back this page's opcodes and
+			 * runtime table slots, then the pages we already did.
+			 */
+			for (i = first; i < written; i++)
+				server_ptrace_write_memory (handle, breakpoints [i]->address, 1,
+							    &breakpoints [i]->saved_insn);
+			for (i = first; i < enabled; i++)
+				runtime_info_disable_breakpoint (handle, breakpoints [i]);
+
+			write_breakpoint_opcodes (handle, breakpoints, first, FALSE);
+		}
+
+		if (result != COMMAND_ERROR_NONE)
+			return result;
+
+		first = last + 1;
+	}
+
+	return COMMAND_ERROR_NONE;
+}
+
+static ServerCommandError
+server_ptrace_insert_breakpoints (ServerHandle *handle, guint32 count, const guint64 *addresses,
+				  guint32 *bhandles)
+{
+	BreakpointInfo **infos, **added;
+	ServerCommandError result;
+	GHashTable *pending;
+	guint32 nadded = 0, i;
+
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
+	mono_debugger_breakpoint_manager_unshare (handle->bpm);
+
+	infos = g_new0 (BreakpointInfo *, count);
+	added = g_new0 (BreakpointInfo *, count);
+	pending = g_hash_table_new (NULL, NULL);
+
+	for (i = 0; i < count; i++) {
+		BreakpointInfo *breakpoint;
+
+		breakpoint = mono_debugger_breakpoint_manager_lookup (handle->bpm, addresses [i]);
+		if (!breakpoint)
+			breakpoint = g_hash_table_lookup (pending, GSIZE_TO_POINTER (addresses [i]));
+
+		if (!breakpoint) {
+			breakpoint = g_new0 (BreakpointInfo, 1);
+			breakpoint->address = addresses [i];
+			breakpoint->is_hardware_bpt = FALSE;
+			breakpoint->id = mono_debugger_breakpoint_manager_get_next_id ();
+			breakpoint->dr_index = -1;
+
+			g_hash_table_insert (pending, GSIZE_TO_POINTER (addresses [i]), breakpoint);
+			added [nadded++] = breakpoint;
+		}
+
+		infos [i] = breakpoint;
+	}
+
+	qsort (added, nadded, sizeof (BreakpointInfo *), compare_breakpoint_address);
+
+	result = write_breakpoint_opcodes (handle, added, nadded, TRUE);
+	if (result != COMMAND_ERROR_NONE) {
+		for (i = 0; i < nadded; i++)
+			g_free (added [i]);
+		goto out;
+	}
+
+	for (i = 0; i < nadded; i++)
+		added [i]->enabled = TRUE;
+	mono_debugger_breakpoint_manager_insert_many (handle->bpm, added, nadded);
+
+	for (i = 0; i < count; i++) {
+		infos [i]->refcount++;
+		bhandles [i] = infos [i]->id;
+	}
+
+ out:
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
+
+	g_hash_table_destroy (pending);
+	g_free (infos);
+	g_free (added);
+	return result;
+}
+
+static ServerCommandError
+server_ptrace_set_breakpoint_condition (ServerHandle *handle, guint32 bhandle,
+					const guint8 *condition, guint32 condition_size,
+					guint32 ignore_count, const guint8 *instruction,
+					guint32 insn_size, gint32 displacement_offset)
+{
+	MonoRuntimeInfo *runtime = handle->mono_runtime;
+	BreakpointInfo *breakpoint;
+	ServerCommandError result;
+	guint32 trampoline_size;
+	guint64 trampoline;
+	int slot;
+
+	if (condition_size && !breakpoint_condition_is_valid (condition, condition_size))
+		return COMMAND_ERROR_INTERNAL_ERROR;
+
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
+	mono_debugger_breakpoint_manager_unshare (handle->bpm);
+
+	breakpoint = mono_debugger_breakpoint_manager_lookup_by_id (handle->bpm, bhandle);
+	if (!breakpoint) {
+		result = COMMAND_ERROR_NO_SUCH_BREAKPOINT;
+		goto out;
+	}
+
+	clear_breakpoint_condition (breakpoint);
+
+	if (condition_size) {
+		breakpoint->condition = g_memdup (condition, condition_size);
+		breakpoint->condition_size = condition_size;
+	}
+	breakpoint->ignore_count = ignore_count;
+
+	if (!condition_size && !ignore_count && !breakpoint->threads && !breakpoint->actions) {
+		result = COMMAND_ERROR_NONE;
+		goto out;
+	}
+
+	if (!insn_size || !runtime || !runtime->executable_code_buffer) {
+		result = COMMAND_ERROR_NOT_IMPLEMENTED;
+		goto out;
+	}
+
+	/*
+	 * The trampoline is allocated once per breakpoint and rewritten in place.  Its
+	 * content only depends on the breakpoint's address and instruction, so a thread
+	 * that's currently inside it isn't disturbed.
+	 */
+	if (breakpoint->trampoline)
+		slot = breakpoint->trampoline_slot;
+	else
+		slot = runtime_alloc_code_buffer_range (runtime, BREAKPOINT_TRAMPOLINE_CHUNKS);
+	if (slot < 0) {
+		result = COMMAND_ERROR_NOT_IMPLEMENTED;
+		goto out;
+	}
+
+	trampoline = runtime->executable_code_buffer + slot * runtime->executable_code_chunk_size;
+	trampoline_size = BREAKPOINT_TRAMPOLINE_CHUNKS * runtime->executable_code_chunk_size;
+
+	result = x86_arch_write_trampoline (handle, trampoline, trampoline_size, breakpoint->address,
+					    instruction, insn_size, displacement_offset);
+	if (result != COMMAND_ERROR_NONE) {
+		if (!breakpoint->trampoline)
+			runtime_free_code_buffer_range (runtime, slot, BREAKPOINT_TRAMPOLINE_CHUNKS);
+		goto out;
+	}
+
+	breakpoint->trampoline = trampoline;
+	breakpoint->trampoline_slot = slot;
+
+ out:
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
+	return result;
+}
+
+static ServerCommandError
+server_ptrace_set_watch_filter (ServerHandle *handle, guint32 bhandle, guint32 value_size,
+				const guint8 *condition, guint32 condition_size)
+{
+	BreakpointInfo *breakpoint;
+	ServerCommandError result = COMMAND_ERROR_NONE;
+	guint64 value = 0;
+
+	if (value_size > sizeof (value))
+		return COMMAND_ERROR_INTERNAL_ERROR;
+	if (condition_size && !breakpoint_condition_is_valid (condition, condition_size))
+		return COMMAND_ERROR_INTERNAL_ERROR;
+
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
+
+	breakpoint = lookup_breakpoint (handle, bhandle, NULL);
+	if (!breakpoint || !breakpoint->is_hardware_bpt ||
+	    (breakpoint->type == HARDWARE_BREAKPOINT_EXECUTE)) {
+		result = COMMAND_ERROR_NO_SUCH_BREAKPOINT;
+		goto out;
+	}
+
+	if (value_size) {
+		result = server_ptrace_read_memory (handle, breakpoint->address, value_size, &value);
+		if (result != COMMAND_ERROR_NONE)
+			goto out;
+	}
+
+	breakpoint->watch_size = value_size;
+	breakpoint->watch_value = value;
+
+	g_free (breakpoint->condition);
+	breakpoint->condition = condition_size ? g_memdup (condition, condition_size) : NULL;
+	breakpoint->condition_size = condition_size;
+
+ out:
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
+	return result;
+}
+
+static ServerCommandError
+server_ptrace_set_breakpoints_enabled (ServerHandle *handle, guint32 count, const guint32 *bhandles,
+				       gboolean enabled)
+{
+	BreakpointInfo **infos, **software;
+	ServerCommandError result = COMMAND_ERROR_NONE;
+	guint32 nsoftware = 0, i;
+
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
+	mono_debugger_breakpoint_manager_unshare (handle->bpm);
+
+	infos = g_new0 (BreakpointInfo *, count);
+	software = g_new0 (BreakpointInfo *, count);
+
+	for (i = 0; i < count; i++) {
+		infos [i] = lookup_breakpoint (handle, bhandles [i], NULL);
+		if (!infos [i]) {
+			result = COMMAND_ERROR_NO_SUCH_BREAKPOINT;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		BreakpointInfo *breakpoint = infos [i];
+
+		if (breakpoint->enabled == enabled)
+			continue;
+
+		if (breakpoint->dr_index < 0) {
+			software [nsoftware++] = breakpoint;
+			continue;
+		}
+
+		if (enabled)
+			result = x86_arch_enable_breakpoint (handle, breakpoint);
+		else
+			result = x86_arch_disable_breakpoint (handle, breakpoint);
+		if (result != COMMAND_ERROR_NONE)
+			goto out;
+
+		breakpoint->enabled = enabled;
+	}
+
+	qsort (software, nsoftware, sizeof (BreakpointInfo *), compare_breakpoint_address);
+
+	/*
+	 * The same handle may have been passed more than once.
+	 */
+	if (nsoftware > 1) {
+		guint32 j = 1;
+
+		for (i = 1; i < nsoftware; i++) {
+			if (software [i] != software [j - 1])
+				software [j++] = software [i];
+		}
+		nsoftware = j;
+	}
+
+	result = write_breakpoint_opcodes (handle, software, nsoftware, enabled);
+	if (result != COMMAND_ERROR_NONE)
+		goto out;
+
+	for (i = 0; i < nsoftware; i++)
+		software [i]->enabled = enabled;
+
+ out:
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
+
+	g_free (infos);
+	g_free (software);
+	return result;
+}
+
 InferiorVTable i386_ptrace_inferior = {
 	server_ptrace_global_init,
 	server_ptrace_get_server_type,
@@ -611,7 +1710,10 @@ InferiorVTable i386_ptrace_inferior = {
 	server_ptrace_detach,
 	server_ptrace_finalize,
 	server_ptrace_global_wait,
+	server_ptrace_global_wait_many,
 	server_ptrace_stop_and_wait,
+	server_ptrace_stop_all,
+	server_ptrace_set_stop_pending,
 	server_ptrace_dispatch_event,
 	server_ptrace_dispatch_simple,
 	server_ptrace_get_target_info,
@@ -622,6 +1724,7 @@ InferiorVTable i386_ptrace_inferior = {
 	server_ptrace_current_insn_is_bpt,
 	server_ptrace_peek_word,
 	server_ptrace_read_memory,
+	server_ptrace_read_memory_vector,
 	server_ptrace_write_memory,
 	server_ptrace_call_method,
 	server_ptrace_call_method_1,
@@ -629,13 +1732,19 @@ InferiorVTable i386_ptrace_inferior = {
 	server_ptrace_call_method_3,
 	server_ptrace_call_method_invoke,
 	server_ptrace_execute_instruction,
+	server_ptrace_execute_displaced_instruction,
 	server_ptrace_mark_rti_frame,
 	server_ptrace_abort_invoke,
 	server_ptrace_insert_breakpoint,
+	server_ptrace_insert_breakpoints,
 	server_ptrace_insert_hw_breakpoint,
 	server_ptrace_remove_breakpoint,
 	server_ptrace_enable_breakpoint,
 	server_ptrace_disable_breakpoint,
+	server_ptrace_set_breakpoints_enabled,
+	server_ptrace_set_breakpoint_condition,
+	server_ptrace_free_retired_trampolines,
+	server_ptrace_set_watch_filter,
 	server_ptrace_get_breakpoints,
 	server_ptrace_get_registers,
 	server_ptrace_set_registers,
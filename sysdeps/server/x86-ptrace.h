@@ -13,6 +13,7 @@ struct InferiorHandle
 	int redirect_fds;
 	int output_fd [2], error_fd [2];
 	int is_thread;
+	int stop_pending;
 };
 
 #ifndef PTRACE_SETOPTIONS
@@ -21,6 +22,14 @@ struct InferiorHandle
 #ifndef PTRACE_GETEVENTMSG
 #define PTRACE_GETEVENTMSG	0x4201
 #endif
+#ifndef PTRACE_SEIZE
+#define PTRACE_SEIZE		0x4206
+#define PTRACE_INTERRUPT	0x4207
+#define PTRACE_LISTEN		0x4208
+#endif
+#ifndef PTRACE_EVENT_STOP
+#define PTRACE_EVENT_STOP	128
+#endif
 
 #ifndef PTRACE_EVENT_FORK
 
@@ -68,6 +77,10 @@ _server_ptrace_read_memory (ServerHandle *handle, guint64 start,
 static ServerCommandError
 server_ptrace_read_memory (ServerHandle *handle, guint64 start, guint32 size, gpointer buffer);
 
+static ServerCommandError
+server_ptrace_read_memory_vector (ServerHandle *handle, guint32 count, const guint64 *addresses,
+				  const guint32 *sizes, gpointer buffer);
+
 static ServerCommandError
 server_ptrace_write_memory (ServerHandle *handle, guint64 start,
 			    guint32 size, gconstpointer buffer);
@@ -75,12 +88,18 @@ server_ptrace_write_memory (ServerHandle *handle, guint64 start,
 static ServerCommandError
 server_ptrace_poke_word (ServerHandle *handle, guint64 addr, gsize value);
 
+static ServerCommandError
+server_ptrace_get_registers (ServerHandle *handle, guint64 *values);
+
 static ServerCommandError
 _server_ptrace_set_dr (InferiorHandle *handle, int regnum, guint64 value);
 
 static ServerCommandError
 _server_ptrace_get_dr (InferiorHandle *handle, int regnum, guint64 *value);
 
+static ServerCommandError
+_server_ptrace_get_fault_address (InferiorHandle *inferior, guint64 *address);
+
 static ServerCommandError
 server_ptrace_continue (ServerHandle *handle);
 
@@ -108,4 +127,15 @@ server_ptrace_get_signal_info (ServerHandle *handle, SignalInfo **sinfo);
 static gboolean
 _server_ptrace_wait_for_new_thread (ServerHandle *handle);
 
+#ifdef __linux__
+static gboolean
+_server_ptrace_using_seize (void);
+
+static int
+_server_ptrace_seize_attach (guint32 pid);
+
+static ServerCommandError
+_server_ptrace_seize_new_child (ServerHandle *handle, int pid);
+#endif
+
 #endif
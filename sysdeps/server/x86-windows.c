@@ -1266,27 +1266,25 @@ void
 x86_arch_remove_breakpoints_from_target_memory (ServerHandle *handle, guint64 start,
 						guint32 size, gpointer buffer)
 {
-	GPtrArray *breakpoints;
+	BreakpointInfo **breakpoints;
 	guint8 *ptr = buffer;
-	int i;
+	guint32 count, i;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_begin_read (handle->bpm);
 
-	breakpoints = mono_debugger_breakpoint_manager_get_breakpoints (handle->bpm);
-	for (i = 0; i < breakpoints->len; i++) {
-		BreakpointInfo *info = g_ptr_array_index (breakpoints, i);
+	count = mono_debugger_breakpoint_manager_lookup_range (handle->bpm, start, size, &breakpoints);
+	for (i = 0; i < count; i++) {
+		BreakpointInfo *info = breakpoints [i];
 		guint32 offset;
 
 		if (info->is_hardware_bpt || !info->enabled)
 			continue;
-		if ( (info->address < start) || (info->address >= start+size))
-			continue;
 
 		offset = (guint32) info->address - start;
 		ptr [offset] = info->saved_insn;
 	}
 
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_end_read (handle->bpm);
 }
 
 
@@ -1709,7 +1707,9 @@ BreakpointInfo * find_breakpoint_by_address (DWORD address)
 		BreakpointManager *bpm = m_debug_info.server_handle->bpm;
 		BreakpointInfo *result;
 	    g_assert (NULL != bpm);
+		mono_debugger_breakpoint_manager_lock (bpm);
 		result = mono_debugger_breakpoint_manager_lookup (bpm, address);
+		mono_debugger_breakpoint_manager_unlock (bpm);
 		return result;
 	
 	}
@@ -1901,7 +1901,7 @@ server_win32_insert_breakpoint (ServerHandle *handle, guint64 address, guint32 *
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
 	breakpoint = (BreakpointInfo *) mono_debugger_breakpoint_manager_lookup (handle->bpm, address);
 	if (breakpoint) {
 		/*
@@ -1909,7 +1909,7 @@ server_win32_insert_breakpoint (ServerHandle *handle, guint64 address, guint32 *
 		 * instruction.
 		 */
 		if (breakpoint->is_hardware_bpt) {
-			mono_debugger_breakpoint_manager_unlock ();
+			mono_debugger_breakpoint_manager_unlock (handle->bpm);
 			return COMMAND_ERROR_DR_OCCUPIED;
 		}
 
@@ -1927,7 +1927,7 @@ server_win32_insert_breakpoint (ServerHandle *handle, guint64 address, guint32 *
 
 	result = x86_arch_enable_breakpoint (handle, breakpoint);
 	if (result != COMMAND_ERROR_NONE) {
-		mono_debugger_breakpoint_manager_unlock ();
+		mono_debugger_breakpoint_manager_unlock (handle->bpm);
 		g_free (breakpoint);
 		return result;
 	}
@@ -1936,7 +1936,7 @@ server_win32_insert_breakpoint (ServerHandle *handle, guint64 address, guint32 *
 	mono_debugger_breakpoint_manager_insert (handle->bpm, (BreakpointInfo *) breakpoint);
  done:
 	*bhandle = breakpoint->id;
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
 
 	return COMMAND_ERROR_NONE;
 }
@@ -1947,7 +1947,7 @@ server_win32_remove_breakpoint (ServerHandle *handle, guint32 bhandle)
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
 	breakpoint = (BreakpointInfo *) mono_debugger_breakpoint_manager_lookup_by_id (handle->bpm, bhandle);
 	if (!breakpoint) {
 		result = COMMAND_ERROR_NO_SUCH_BREAKPOINT;
@@ -1967,7 +1967,7 @@ server_win32_remove_breakpoint (ServerHandle *handle, guint32 bhandle)
 	mono_debugger_breakpoint_manager_remove (handle->bpm, (BreakpointInfo *) breakpoint);
 
  out:
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
 	return result;
 }
 
@@ -2133,7 +2133,8 @@ server_win32_spawn (ServerHandle *handle, const gchar *working_directory,
 }
 
 void
-server_win32_io_thread_main (IOThreadData *io_data, ChildOutputFunc func)
+server_win32_io_thread_main (IOThreadData *io_data, ChildOutputFunc func,
+			     guint32 flush_latency, gint32 tee_fd)
 {
 	Sleep (600000);
 }
@@ -2347,7 +2348,7 @@ server_win32_get_breakpoints (ServerHandle *handle, guint32 *count, guint32 **re
 	int i;
 	GPtrArray *breakpoints;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
 	breakpoints = mono_debugger_breakpoint_manager_get_breakpoints (handle->bpm);
 	*count = breakpoints->len;
 	*retval = g_new0 (guint32, breakpoints->len);
@@ -2357,7 +2358,7 @@ server_win32_get_breakpoints (ServerHandle *handle, guint32 *count, guint32 **re
 
 		 (*retval) [i] = info->id;
 	}
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
 
 	return COMMAND_ERROR_NONE;	
 }
@@ -2390,7 +2391,10 @@ InferiorVTable i386_windows_inferior = {
 	NULL,					 			/*detach, */
 	NULL,					 			/*finalize, */
 	server_win32_global_wait,			/*global_wait, */
+	NULL,					 			/*global_wait_many, */
 	NULL,					 			/*stop_and_wait, */
+	NULL,					 			/*stop_all, */
+	NULL,					 			/*set_stop_pending, */
 	server_win32_dispatch_event,		/*dispatch_event, */
 	server_win32_dispatch_simple,								/*dispatch_simple, */
 	server_win32_get_target_info,		/*get_target_info, */
@@ -2401,6 +2405,7 @@ InferiorVTable i386_windows_inferior = {
 	NULL,					 			/*current_insn_is_bpt, */
 	NULL,					 			/*peek_word, */
 	server_win32_read_memory,			/*read_memory, */
+	NULL,								/*read_memory_vector, */
 	server_win32_write_memory,		/*write_memory, */
 	NULL,					 			/*call_method, */
 	NULL,					 			/*call_method_1, */
@@ -2408,13 +2413,19 @@ InferiorVTable i386_windows_inferior = {
 	NULL,					 			/*call_method_3, */
 	NULL,					 			/*call_method_invoke, */
 	NULL,					 			/*execute_instruction, */
+	NULL,					 			/*execute_displaced_instruction, */
 	NULL,					 			/*mark_rti_frame, */
 	NULL,					 			/*abort_invoke, */
 	server_win32_insert_breakpoint,					 			/*insert_breakpoint, */
+	NULL,					 			/*insert_breakpoints, */
 	NULL,					 			/*insert_hw_breakpoint, */
 	server_win32_remove_breakpoint,					 			/*remove_breakpoint, */
 	NULL,					 			/*enable_breakpoint, */
 	NULL,					 			/*disable_breakpoint, */
+	NULL,					 			/*set_breakpoints_enabled, */
+	NULL,					 			/*set_breakpoint_condition, */
+	NULL,					 			/*free_retired_trampolines, */
+	NULL,					 			/*set_watch_filter, */
 	server_win32_get_breakpoints,		/*get_breakpoints, */
 	server_win32_get_registers,					 			/*get_registers, */
 	server_win32_set_registers,					 			/*set_registers, */
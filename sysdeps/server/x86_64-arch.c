@@ -20,6 +20,7 @@ typedef struct
 	int slot;
 	int insn_size;
 	gboolean update_ip;
+	gboolean displaced;
 	guint64 code_address;
 	guint64 original_rip;
 } CodeBufferData;
@@ -28,6 +29,7 @@ struct ArchInfo
 {
 	INFERIOR_REGS_TYPE current_regs;
 	INFERIOR_FPREGS_TYPE current_fpregs;
+	gboolean regs_valid, regs_dirty, fpregs_valid;
 	GPtrArray *callback_stack;
 	CodeBufferData *code_buffer;
 	guint64 dr_control, dr_status;
@@ -72,16 +74,34 @@ x86_arch_finalize (ArchInfo *arch)
 	g_free (arch);
 }
 
+/*
+ * The hardware breakpoints have their own BreakpointManager; lock it after
+ * `handle->bpm' whenever we look at both of them.
+ */
+static void
+lock_breakpoints (ServerHandle *handle)
+{
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
+	mono_debugger_breakpoint_manager_lock (handle->arch->hw_bpm);
+}
+
+static void
+unlock_breakpoints (ServerHandle *handle)
+{
+	mono_debugger_breakpoint_manager_unlock (handle->arch->hw_bpm);
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
+}
+
 static ServerCommandError
 server_ptrace_current_insn_is_bpt (ServerHandle *handle, guint32 *is_breakpoint)
 {
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
 	if (mono_debugger_breakpoint_manager_lookup (handle->arch->hw_bpm, INFERIOR_REG_RIP (handle->arch->current_regs)) ||
 	    mono_debugger_breakpoint_manager_lookup (handle->bpm, INFERIOR_REG_RIP (handle->arch->current_regs)))
 		*is_breakpoint = TRUE;
 	else
 		*is_breakpoint = FALSE;
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 
 	return COMMAND_ERROR_NONE;
 }
@@ -90,27 +110,25 @@ void
 x86_arch_remove_breakpoints_from_target_memory (ServerHandle *handle, guint64 start,
 						guint32 size, gpointer buffer)
 {
-	GPtrArray *breakpoints;
+	BreakpointInfo **breakpoints;
 	guint8 *ptr = buffer;
-	int i;
+	guint32 count, i;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_begin_read (handle->bpm);
 
-	breakpoints = mono_debugger_breakpoint_manager_get_breakpoints (handle->bpm);
-	for (i = 0; i < breakpoints->len; i++) {
-		BreakpointInfo *info = g_ptr_array_index (breakpoints, i);
+	count = mono_debugger_breakpoint_manager_lookup_range (handle->bpm, start, size, &breakpoints);
+	for (i = 0; i < count; i++) {
+		BreakpointInfo *info = breakpoints [i];
 		guint64 offset;
 
 		if (info->is_hardware_bpt || !info->enabled)
 			continue;
-		if ((info->address < start) || (info->address >= start+size))
-			continue;
 
 		offset = (guint64) info->address - start;
 		ptr [offset] = info->saved_insn;
 	}
 
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_end_read (handle->bpm);
 }
 
 static ServerCommandError
@@ -118,9 +136,11 @@ server_ptrace_get_frame (ServerHandle *handle, StackFrame *frame)
 {
 	ServerCommandError result;
 
-	result = x86_arch_get_registers (handle);
-	if (result != COMMAND_ERROR_NONE)
-		return result;
+	if (!handle->arch->regs_valid) {
+		result = x86_arch_get_registers (handle);
+		if (result != COMMAND_ERROR_NONE)
+			return result;
+	}
 
 	frame->address = (guint64) INFERIOR_REG_RIP (handle->arch->current_regs);
 	frame->stack_pointer = (guint64) INFERIOR_REG_RSP (handle->arch->current_regs);
@@ -133,15 +153,15 @@ check_breakpoint (ServerHandle *handle, guint64 address, guint64 *retval)
 {
 	BreakpointInfo *info;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
 	info = (BreakpointInfo *) mono_debugger_breakpoint_manager_lookup (handle->bpm, address);
 	if (!info || !info->enabled) {
-		mono_debugger_breakpoint_manager_unlock ();
+		mono_debugger_breakpoint_manager_unlock (handle->bpm);
 		return FALSE;
 	}
 
 	*retval = info->id;
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
 	return TRUE;
 }
 
@@ -150,12 +170,12 @@ lookup_breakpoint (ServerHandle *handle, guint32 idx, BreakpointManager **out_bp
 {
 	BreakpointInfo *info;
 
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
 	info = (BreakpointInfo *) mono_debugger_breakpoint_manager_lookup_by_id (handle->arch->hw_bpm, idx);
 	if (info) {
 		if (out_bpm)
 			*out_bpm = handle->arch->hw_bpm;
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		return info;
 	}
 
@@ -163,14 +183,14 @@ lookup_breakpoint (ServerHandle *handle, guint32 idx, BreakpointManager **out_bp
 	if (info) {
 		if (out_bpm)
 			*out_bpm = handle->bpm;
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		return info;
 	}
 
 	if (out_bpm)
 		*out_bpm = NULL;
 
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 	return info;
 }
 
@@ -183,23 +203,82 @@ get_callback_data (ArchInfo *arch)
 	return g_ptr_array_index (arch->callback_stack, arch->callback_stack->len - 1);
 }
 
+/*
+ * Write back registers which have been modified with server_ptrace_set_registers();
+ * this must be done before the target is resumed.
+ */
+static ServerCommandError
+x86_arch_flush_registers (ServerHandle *handle)
+{
+	ArchInfo *arch = handle->arch;
+	ServerCommandError result;
+
+	if (!arch->regs_dirty)
+		return COMMAND_ERROR_NONE;
+
+	result = _server_ptrace_set_registers (handle->inferior, &arch->current_regs);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
+	arch->regs_dirty = FALSE;
+	return COMMAND_ERROR_NONE;
+}
+
+static void
+x86_arch_invalidate_registers (ServerHandle *handle)
+{
+	handle->arch->regs_valid = FALSE;
+	handle->arch->fpregs_valid = FALSE;
+}
+
 static ServerCommandError
 x86_arch_get_registers (ServerHandle *handle)
 {
+	ArchInfo *arch = handle->arch;
 	ServerCommandError result;
 
-	result = _server_ptrace_get_registers (handle->inferior, &handle->arch->current_regs);
+	result = x86_arch_flush_registers (handle);
 	if (result != COMMAND_ERROR_NONE)
 		return result;
 
-	result = _server_ptrace_get_fp_registers (handle->inferior, &handle->arch->current_fpregs);
+	result = _server_ptrace_get_registers (handle->inferior, &arch->current_regs);
 	if (result != COMMAND_ERROR_NONE)
 		return result;
 
-	result = _server_ptrace_get_dr (handle->inferior, DR_STATUS, &handle->arch->dr_status);
+	/*
+	 * The FP registers are only needed when calling a method in the target, so we
+	 * fetch them lazily in x86_arch_get_fp_registers().
+	 */
+	arch->fpregs_valid = FALSE;
+
+	/*
+	 * DR_STATUS can't report anything interesting without any hardware breakpoints.
+	 */
+	if (arch->dr_control) {
+		result = _server_ptrace_get_dr (handle->inferior, DR_STATUS, &arch->dr_status);
+		if (result != COMMAND_ERROR_NONE)
+			return result;
+	} else
+		arch->dr_status = 0;
+
+	arch->regs_valid = TRUE;
+	return COMMAND_ERROR_NONE;
+}
+
+static ServerCommandError
+x86_arch_get_fp_registers (ServerHandle *handle)
+{
+	ArchInfo *arch = handle->arch;
+	ServerCommandError result;
+
+	if (arch->fpregs_valid)
+		return COMMAND_ERROR_NONE;
+
+	result = _server_ptrace_get_fp_registers (handle->inferior, &arch->current_fpregs);
 	if (result != COMMAND_ERROR_NONE)
 		return result;
 
+	arch->fpregs_valid = TRUE;
 	return COMMAND_ERROR_NONE;
 }
 
@@ -298,6 +377,9 @@ x86_arch_child_stopped (ServerHandle *handle, int stopsig,
 		return STOP_ACTION_CALLBACK;
 	}
 
+	if ((stopsig == SIGSEGV) && check_watch_fault (handle, retval, retval2))
+		return STOP_ACTION_WATCH_FAULT;
+
 #if defined(__linux__) || defined(__FreeBSD__)
 	if (stopsig != SIGTRAP)
 		return STOP_ACTION_STOPPED;
@@ -319,12 +401,23 @@ x86_arch_child_stopped (ServerHandle *handle, int stopsig,
 		if (X86_DR_WATCH_HIT (arch, i)) {
 			_server_ptrace_set_dr (inferior, DR_STATUS, 0);
 			arch->dr_status = 0;
+			if (!check_watch_value (handle, arch->hw_bpm, arch->dr_regs [i]))
+				return STOP_ACTION_RESUME;
 			*retval = arch->dr_regs [i];
 			return STOP_ACTION_BREAKPOINT_HIT;
 		}
 	}
 
 	if (check_breakpoint (handle, INFERIOR_REG_RIP (arch->current_regs) - 1, retval)) {
+		guint64 trampoline;
+
+		trampoline = check_breakpoint_condition (handle, INFERIOR_REG_RIP (arch->current_regs) - 1);
+		if (trampoline) {
+			INFERIOR_REG_RIP (arch->current_regs) = trampoline;
+			_server_ptrace_set_registers (inferior, &arch->current_regs);
+			return STOP_ACTION_RESUME;
+		}
+
 		INFERIOR_REG_RIP (arch->current_regs)--;
 		_server_ptrace_set_registers (inferior, &arch->current_regs);
 		return STOP_ACTION_BREAKPOINT_HIT;
@@ -332,9 +425,16 @@ x86_arch_child_stopped (ServerHandle *handle, int stopsig,
 
 	cbuffer = arch->code_buffer;
 	if (cbuffer) {
-		handle->mono_runtime->executable_code_bitfield [cbuffer->slot] = 0;
-
-		if (cbuffer->code_address + cbuffer->insn_size != INFERIOR_REG_RIP (arch->current_regs)) {
+		runtime_free_code_buffer_slot (handle->mono_runtime, cbuffer->slot);
+
+		if (cbuffer->displaced) {
+			/*
+			 * A relative branch which was taken landed relative to the code buffer,
+			 * everything else stopped right behind the copied instruction.
+			 */
+			INFERIOR_REG_RIP (arch->current_regs) = cbuffer->original_rip +
+				INFERIOR_REG_RIP (arch->current_regs) - cbuffer->code_address;
+		} else if (cbuffer->code_address + cbuffer->insn_size != INFERIOR_REG_RIP (arch->current_regs)) {
 			char buffer [1024];
 
 			g_warning (G_STRLOC ": %d - %Lx,%d - %Lx - %Lx", cbuffer->slot,
@@ -348,11 +448,12 @@ x86_arch_child_stopped (ServerHandle *handle, int stopsig,
 				   buffer [5], buffer [6], buffer [7]);
 
 			return STOP_ACTION_INTERNAL_ERROR;
+		} else {
+			INFERIOR_REG_RIP (arch->current_regs) = cbuffer->original_rip;
+			if (cbuffer->update_ip)
+				INFERIOR_REG_RIP (arch->current_regs) += cbuffer->insn_size;
 		}
 
-		INFERIOR_REG_RIP (arch->current_regs) = cbuffer->original_rip;
-		if (cbuffer->update_ip)
-			INFERIOR_REG_RIP (arch->current_regs) += cbuffer->insn_size;
 		if (_server_ptrace_set_registers (inferior, &arch->current_regs) != COMMAND_ERROR_NONE) {
 			g_error (G_STRLOC ": Can't restore registers");
 		}
@@ -454,7 +555,11 @@ server_ptrace_set_registers (ServerHandle *handle, guint64 *values)
 	INFERIOR_REG_FS (arch->current_regs) = values [DEBUGGER_REG_FS];
 	INFERIOR_REG_GS (arch->current_regs) = values [DEBUGGER_REG_GS];
 
-	return _server_ptrace_set_registers (handle->inferior, &arch->current_regs);
+	/*
+	 * Written back by x86_arch_flush_registers() before the target is resumed.
+	 */
+	arch->regs_dirty = TRUE;
+	return COMMAND_ERROR_NONE;
 }
 
 static ServerCommandError
@@ -471,9 +576,12 @@ server_ptrace_push_registers (ServerHandle *handle, guint64 *new_rsp)
 	INFERIOR_REG_RSP (arch->current_regs) -= AMD64_RED_ZONE_SIZE + sizeof (arch->current_regs) + 16;
 	INFERIOR_REG_RSP (arch->current_regs) &= 0xfffffffffffffff0L;
 
-	result = _server_ptrace_set_registers (handle->inferior, &arch->current_regs);
-	if (result != COMMAND_ERROR_NONE)
-		return result;
+	/*
+	 * Only the cached copy is changed; when pushing the registers of all threads
+	 * for a global thread lock, this saves a PT_SETREGS per thread and the one
+	 * from the matching pop_registers() is merged into it.
+	 */
+	arch->regs_dirty = TRUE;
 
 	*new_rsp = INFERIOR_REG_RSP (arch->current_regs);
 
@@ -489,7 +597,6 @@ static ServerCommandError
 server_ptrace_pop_registers (ServerHandle *handle)
 {
 	ArchInfo *arch = handle->arch;
-	ServerCommandError result;
 
 	if (!arch->pushed_regs_rsp)
 		return COMMAND_ERROR_INTERNAL_ERROR;
@@ -497,10 +604,7 @@ server_ptrace_pop_registers (ServerHandle *handle)
 	INFERIOR_REG_RSP (arch->current_regs) = arch->pushed_regs_rsp;
 	arch->pushed_regs_rsp = 0;
 
-	result = _server_ptrace_set_registers (handle->inferior, &arch->current_regs);
-	if (result != COMMAND_ERROR_NONE)
-		return result;
-
+	arch->regs_dirty = TRUE;
 	return COMMAND_ERROR_NONE;
 }
 
@@ -541,17 +645,7 @@ server_ptrace_get_registers_from_core_file (guint64 *values, const guint8 *buffe
 static int
 find_breakpoint_table_slot (MonoRuntimeInfo *runtime)
 {
-	int i;
-
-	for (i = 1; i < runtime->breakpoint_table_size; i++) {
-		if (runtime->breakpoint_table_bitfield [i])
-			continue;
-
-		runtime->breakpoint_table_bitfield [i] = 1;
-		return i;
-	}
-
-	return -1;
+	return runtime_alloc_breakpoint_slot (runtime);
 }
 
 static ServerCommandError
@@ -609,7 +703,7 @@ runtime_info_disable_breakpoint (ServerHandle *handle, BreakpointInfo *breakpoin
 	if (result != COMMAND_ERROR_NONE)
 		return result;
 
-	runtime->breakpoint_table_bitfield [slot] = 0;
+	runtime_free_breakpoint_slot (runtime, slot);
 
 	return COMMAND_ERROR_NONE;
 }
@@ -719,7 +813,8 @@ server_ptrace_insert_breakpoint (ServerHandle *handle, guint64 address, guint32
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
+	mono_debugger_breakpoint_manager_unshare (handle->bpm);
 	breakpoint = (BreakpointInfo *) mono_debugger_breakpoint_manager_lookup (handle->bpm, address);
 	if (breakpoint) {
 		breakpoint->refcount++;
@@ -736,7 +831,7 @@ server_ptrace_insert_breakpoint (ServerHandle *handle, guint64 address, guint32
 
 	result = x86_arch_enable_breakpoint (handle, breakpoint);
 	if (result != COMMAND_ERROR_NONE) {
-		mono_debugger_breakpoint_manager_unlock ();
+		mono_debugger_breakpoint_manager_unlock (handle->bpm);
 		g_free (breakpoint);
 		return result;
 	}
@@ -745,7 +840,7 @@ server_ptrace_insert_breakpoint (ServerHandle *handle, guint64 address, guint32
 	mono_debugger_breakpoint_manager_insert (handle->bpm, (BreakpointInfo *) breakpoint);
  done:
 	*bhandle = breakpoint->id;
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
 
 	return COMMAND_ERROR_NONE;
 }
@@ -757,7 +852,8 @@ server_ptrace_remove_breakpoint (ServerHandle *handle, guint32 idx)
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
+	mono_debugger_breakpoint_manager_unshare (handle->bpm);
 	breakpoint = lookup_breakpoint (handle, idx, &bpm);
 	if (!breakpoint) {
 		result = COMMAND_ERROR_NO_SUCH_BREAKPOINT;
@@ -774,10 +870,11 @@ server_ptrace_remove_breakpoint (ServerHandle *handle, guint32 idx)
 		goto out;
 
 	breakpoint->enabled = FALSE;
+	free_breakpoint_condition (handle, breakpoint);
 	mono_debugger_breakpoint_manager_remove (bpm, breakpoint);
 
  out:
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 	return result;
 }
 
@@ -803,11 +900,11 @@ server_ptrace_insert_hw_breakpoint (ServerHandle *handle, guint32 type, guint32
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
 
 	result = find_free_hw_register (handle, idx);
 	if (result != COMMAND_ERROR_NONE) {
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		return result;
 	}
 
@@ -821,7 +918,7 @@ server_ptrace_insert_hw_breakpoint (ServerHandle *handle, guint32 type, guint32
 
 	result = x86_arch_enable_breakpoint (handle, breakpoint);
 	if (result != COMMAND_ERROR_NONE) {
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		g_free (breakpoint);
 		return result;
 	}
@@ -831,7 +928,7 @@ server_ptrace_insert_hw_breakpoint (ServerHandle *handle, guint32 type, guint32
 
  done:
 	*bhandle = breakpoint->id;
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 
 	return COMMAND_ERROR_NONE;
 }
@@ -842,16 +939,17 @@ server_ptrace_enable_breakpoint (ServerHandle *handle, guint32 idx)
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
+	mono_debugger_breakpoint_manager_unshare (handle->bpm);
 	breakpoint = lookup_breakpoint (handle, idx, NULL);
 	if (!breakpoint) {
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		return COMMAND_ERROR_NO_SUCH_BREAKPOINT;
 	}
 
 	result = x86_arch_enable_breakpoint (handle, breakpoint);
 	breakpoint->enabled = TRUE;
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 	return result;
 }
 
@@ -861,16 +959,17 @@ server_ptrace_disable_breakpoint (ServerHandle *handle, guint32 idx)
 	BreakpointInfo *breakpoint;
 	ServerCommandError result;
 
-	mono_debugger_breakpoint_manager_lock ();
+	lock_breakpoints (handle);
+	mono_debugger_breakpoint_manager_unshare (handle->bpm);
 	breakpoint = lookup_breakpoint (handle, idx, NULL);
 	if (!breakpoint) {
-		mono_debugger_breakpoint_manager_unlock ();
+		unlock_breakpoints (handle);
 		return COMMAND_ERROR_NO_SUCH_BREAKPOINT;
 	}
 
 	result = x86_arch_disable_breakpoint (handle, breakpoint);
 	breakpoint->enabled = FALSE;
-	mono_debugger_breakpoint_manager_unlock ();
+	unlock_breakpoints (handle);
 	return result;
 }
 
@@ -880,7 +979,7 @@ server_ptrace_get_breakpoints (ServerHandle *handle, guint32 *count, guint32 **r
 	int i;
 	GPtrArray *breakpoints;
 
-	mono_debugger_breakpoint_manager_lock ();
+	mono_debugger_breakpoint_manager_lock (handle->bpm);
 	breakpoints = mono_debugger_breakpoint_manager_get_breakpoints (handle->bpm);
 	*count = breakpoints->len;
 	*retval = g_new0 (guint32, breakpoints->len);
@@ -890,7 +989,7 @@ server_ptrace_get_breakpoints (ServerHandle *handle, guint32 *count, guint32 **r
 
 		(*retval) [i] = info->id;
 	}
-	mono_debugger_breakpoint_manager_unlock ();
+	mono_debugger_breakpoint_manager_unlock (handle->bpm);
 
 	return COMMAND_ERROR_NONE;	
 }
@@ -925,6 +1024,10 @@ server_ptrace_call_method (ServerHandle *handle, guint64 method_address,
 			  0xcc, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
 	int size = sizeof (code);
 
+	result = x86_arch_get_fp_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
 	cdata = g_new0 (CallbackData, 1);
 
 	new_rsp = INFERIOR_REG_RSP (arch->current_regs) - AMD64_RED_ZONE_SIZE - size - 16;
@@ -985,6 +1088,10 @@ server_ptrace_call_method_1 (ServerHandle *handle, guint64 method_address,
 	memcpy (code, static_code, static_size);
 	strcpy (code + static_size, string_argument);
 
+	result = x86_arch_get_fp_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
 	cdata = g_new0 (CallbackData, 1);
 
 	new_rsp = INFERIOR_REG_RSP (arch->current_regs) - AMD64_RED_ZONE_SIZE - size - 16;
@@ -1054,6 +1161,10 @@ server_ptrace_call_method_2 (ServerHandle *handle, guint64 method_address,
 	*((guint64 *) (code+104)) = INFERIOR_REG_R15 (arch->current_regs);
 	*((guint8 *) (code+data_size+112)) = 0xcc;
 
+	result = x86_arch_get_fp_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
 	cdata = g_new0 (CallbackData, 1);
 	memcpy (&cdata->saved_regs, &arch->current_regs, sizeof (arch->current_regs));
 	memcpy (&cdata->saved_fpregs, &arch->current_fpregs, sizeof (arch->current_fpregs));
@@ -1125,6 +1236,10 @@ server_ptrace_call_method_3 (ServerHandle *handle, guint64 method_address,
 
 	effective_address = address_argument ? address_argument : blob_start;
 
+	result = x86_arch_get_fp_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
 	cdata = g_new0 (CallbackData, 1);
 	memcpy (&cdata->saved_regs, &arch->current_regs, sizeof (arch->current_regs));
 	memcpy (&cdata->saved_fpregs, &arch->current_fpregs, sizeof (arch->current_fpregs));
@@ -1194,6 +1309,10 @@ server_ptrace_call_method_invoke (ServerHandle *handle, guint64 invoke_method,
 	*((guint64 *) code) = new_rsp + 24;
 	*((guint64 *) (code+8)) = callback_argument;
 
+	result = x86_arch_get_fp_registers (handle);
+	if (result != COMMAND_ERROR_NONE)
+		return result;
+
 	cdata = g_new0 (CallbackData, 1);
 	memcpy (&cdata->saved_regs, &arch->current_regs, sizeof (arch->current_regs));
 	memcpy (&cdata->saved_fpregs, &arch->current_fpregs, sizeof (arch->current_fpregs));
@@ -1231,28 +1350,44 @@ server_ptrace_call_method_invoke (ServerHandle *handle, guint64 invoke_method,
 static int
 find_code_buffer_slot (MonoRuntimeInfo *runtime)
 {
-	int i;
+	return runtime_alloc_code_buffer_slot (runtime);
+}
 
-	for (i = runtime->executable_code_last_slot + 1; i < runtime->executable_code_total_chunks; i++) {
-		if (runtime->executable_code_bitfield [i])
-			continue;
+/*
+ * Single-step the instruction in `data', which has already been copied into its
+ * code buffer slot.  On error, the slot is released and the registers are left
+ * alone, so the caller may just try again.
+ */
+static ServerCommandError
+start_code_buffer (ServerHandle *handle, CodeBufferData *data)
+{
+	ArchInfo *arch = handle->arch;
+	ServerCommandError result;
+	guint64 saved_orig_rax;
 
-		runtime->executable_code_bitfield [i] = 1;
-		runtime->executable_code_last_slot = i;
-		return i;
-	}
+	saved_orig_rax = INFERIOR_REG_ORIG_RAX (arch->current_regs);
 
-	runtime->executable_code_last_slot = 0;
-	for (i = 0; i < runtime->executable_code_total_chunks; i++) {
-		if (runtime->executable_code_bitfield [i])
-			continue;
+	arch->code_buffer = data;
 
-		runtime->executable_code_bitfield [i] = 1;
-		runtime->executable_code_last_slot = i;
-		return i;
+	INFERIOR_REG_ORIG_RAX (arch->current_regs) = -1;
+	INFERIOR_REG_RIP (arch->current_regs) = data->code_address;
+
+	result = _server_ptrace_set_registers (handle->inferior, &arch->current_regs);
+	if (result == COMMAND_ERROR_NONE) {
+		result = server_ptrace_step (handle);
+		if (result == COMMAND_ERROR_NONE)
+			return COMMAND_ERROR_NONE;
 	}
 
-	return -1;
+	INFERIOR_REG_ORIG_RAX (arch->current_regs) = saved_orig_rax;
+	INFERIOR_REG_RIP (arch->current_regs) = data->original_rip;
+	_server_ptrace_set_registers (handle->inferior, &arch->current_regs);
+
+	runtime_free_code_buffer_slot (handle->mono_runtime, data->slot);
+	arch->code_buffer = NULL;
+	g_free (data);
+
+	return result;
 }
 
 static ServerCommandError
@@ -1270,16 +1405,15 @@ server_ptrace_execute_instruction (ServerHandle *handle, const guint8 *instructi
 
 	if (!runtime->executable_code_buffer)
 		return COMMAND_ERROR_INTERNAL_ERROR;
-
-	slot = find_code_buffer_slot (runtime);
-	if (slot < 0)
-		return COMMAND_ERROR_INTERNAL_ERROR;
-
 	if (size > runtime->executable_code_chunk_size)
 		return COMMAND_ERROR_INTERNAL_ERROR;
 	if (handle->arch->code_buffer)
 		return COMMAND_ERROR_INTERNAL_ERROR;
 
+	slot = find_code_buffer_slot (runtime);
+	if (slot < 0)
+		return COMMAND_ERROR_INTERNAL_ERROR;
+
 	code_address = runtime->executable_code_buffer + slot * runtime->executable_code_chunk_size;
 
 	data = g_new0 (CodeBufferData, 1);
@@ -1289,20 +1423,114 @@ server_ptrace_execute_instruction (ServerHandle *handle, const guint8 *instructi
 	data->original_rip = INFERIOR_REG_RIP (handle->arch->current_regs);
 	data->code_address = code_address;
 
-	handle->arch->code_buffer = data;
-
 	result = server_ptrace_write_memory (handle, code_address, size, instruction);
-	if (result != COMMAND_ERROR_NONE)
+	if (result != COMMAND_ERROR_NONE) {
+		runtime_free_code_buffer_slot (runtime, slot);
+		g_free (data);
 		return result;
+	}
 
-	INFERIOR_REG_ORIG_RAX (handle->arch->current_regs) = -1;
-	INFERIOR_REG_RIP (handle->arch->current_regs) = code_address;
+	return start_code_buffer (handle, data);
+}
 
-	result = _server_ptrace_set_registers (handle->inferior, &handle->arch->current_regs);
-	if (result != COMMAND_ERROR_NONE)
+static ServerCommandError
+x86_arch_write_trampoline (ServerHandle *handle, guint64 trampoline, guint32 trampoline_size,
+			   guint64 address, const guint8 *instruction, guint32 insn_size,
+			   gint32 displacement_offset)
+{
+	guint8 code [BREAKPOINT_TRAMPOLINE_CHUNKS * EXECUTABLE_CODE_CHUNK_SIZE];
+	guint64 return_address = address + insn_size;
+
+	/* The instruction, followed by `jmp *0(%rip)' and the absolute return address. */
+	if ((insn_size + 14 > trampoline_size) || (insn_size + 14 > sizeof (code)))
+		return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+	memcpy (code, instruction, insn_size);
+	if (displacement_offset >= 0) {
+		gint32 displacement;
+		gint64 relocated;
+
+		if (displacement_offset + 4 > insn_size)
+			return COMMAND_ERROR_INTERNAL_ERROR;
+
+		memcpy (&displacement, code + displacement_offset, 4);
+		relocated = (gint64) displacement + (gint64) (address - trampoline);
+		if ((relocated < G_MININT32) || (relocated > G_MAXINT32))
+			return COMMAND_ERROR_NOT_IMPLEMENTED;
+
+		displacement = (gint32) relocated;
+		memcpy (code + displacement_offset, &displacement, 4);
+	}
+
+	code [insn_size] = 0xff;
+	code [insn_size + 1] = 0x25;
+	memset (code + insn_size + 2, 0, 4);
+	memcpy (code + insn_size + 6, &return_address, 8);
+
+	return server_ptrace_write_memory (handle, trampoline, insn_size + 14, code);
+}
+
+static ServerCommandError
+server_ptrace_execute_displaced_instruction (ServerHandle *handle, const guint8 *instruction,
+					     guint32 size, gint32 displacement_offset)
+{
+	MonoRuntimeInfo *runtime;
+	ServerCommandError result;
+	CodeBufferData *data;
+	guint8 code [EXECUTABLE_CODE_CHUNK_SIZE];
+	guint64 code_address, original_rip;
+	int slot;
+
+	runtime = handle->mono_runtime;
+	g_assert (runtime);
+
+	if (!runtime->executable_code_buffer)
+		return COMMAND_ERROR_INTERNAL_ERROR;
+	if ((size > runtime->executable_code_chunk_size) || (size > sizeof (code)))
+		return COMMAND_ERROR_INTERNAL_ERROR;
+	if (handle->arch->code_buffer)
+		return COMMAND_ERROR_INTERNAL_ERROR;
+	if ((displacement_offset >= 0) && (displacement_offset + 4 > size))
+		return COMMAND_ERROR_INTERNAL_ERROR;
+
+	slot = find_code_buffer_slot (runtime);
+	if (slot < 0)
+		return COMMAND_ERROR_INTERNAL_ERROR;
+
+	code_address = runtime->executable_code_buffer + slot * runtime->executable_code_chunk_size;
+	original_rip = INFERIOR_REG_RIP (handle->arch->current_regs);
+
+	memcpy (code, instruction, size);
+	if (displacement_offset >= 0) {
+		gint32 displacement;
+		gint64 relocated;
+
+		/* The operand is relative to the end of the instruction, which moves with it. */
+		memcpy (&displacement, code + displacement_offset, 4);
+		relocated = (gint64) displacement + (gint64) (original_rip - code_address);
+		if ((relocated < G_MININT32) || (relocated > G_MAXINT32)) {
+			runtime_free_code_buffer_slot (runtime, slot);
+			return COMMAND_ERROR_NOT_IMPLEMENTED;
+		}
+
+		displacement = (gint32) relocated;
+		memcpy (code + displacement_offset, &displacement, 4);
+	}
+
+	result = server_ptrace_write_memory (handle, code_address, size, code);
+	if (result != COMMAND_ERROR_NONE) {
+		runtime_free_code_buffer_slot (runtime, slot);
 		return result;
+	}
+
+	data = g_new0 (CodeBufferData, 1);
+	data->slot = slot;
+	data->insn_size = size;
+	data->displaced = TRUE;
+	data->original_rip = original_rip;
+	data->code_address = code_address;
 
-	return server_ptrace_step (handle);
+	return start_code_buffer (handle, data);
 }
 
 static ServerCommandError
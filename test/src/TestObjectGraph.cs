@@ -0,0 +1,39 @@
+using System;
+
+public class Node
+{
+	public int Value;
+	public Node Next;
+
+	public Node (int value, Node next)
+	{
+		this.Value = value;
+		this.Next = next;
+	}
+}
+
+public class X
+{
+	public Node List;
+	public int[] Values;
+
+	public int Increment ()
+	{
+		int sum = 0;
+		int i = 0;
+		for (Node node = List; node != null; node = node.Next) {
+			node.Value++;
+			Values [i++] = node.Value;
+			sum += node.Value;
+		}
+		return sum;
+	}
+
+	public static void Main ()
+	{
+		X x = new X ();				// @MDB LINE: main
+		x.List = new Node (1, new Node (2, new Node (3, null)));
+		x.Values = new int [3];
+		Console.WriteLine ("Sum: {0}", x.Increment ());	// @MDB BREAKPOINT: graph
+	}
+}
@@ -0,0 +1,19 @@
+using System;
+
+class X
+{
+	static int counter = 0;
+
+	static void Traced (int value)
+	{
+		counter += value;				// @MDB LINE: traced
+	}
+
+	static void Main ()
+	{
+		for (int i = 0; i < 5; i++)			// @MDB LINE: main
+			Traced (i);
+
+		Console.WriteLine ("Counter: {0}", counter);	// @MDB BREAKPOINT: done
+	}
+}
@@ -0,0 +1,23 @@
+#include <stdio.h>
+
+int counter = 0;
+
+void
+count (void)
+{
+	counter++;				// @MDB LINE: count
+}
+
+int
+main (void)
+{
+	int i;
+
+	setbuf (stdout, NULL);			// @MDB LINE: main
+
+	for (i = 0; i < 10; i++)
+		count ();
+
+	printf ("Counter: %d\n", counter);
+	return 0;
+}
@@ -0,0 +1,33 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+int counter = 0;
+
+void
+count (void)
+{
+	counter++;				// @MDB LINE: count
+}
+
+int
+main (void)
+{
+	pid_t pid;
+	int status, i;
+
+	setbuf (stdout, NULL);			// @MDB LINE: main
+
+	pid = fork ();
+	if (pid == 0)
+		_exit (0);
+
+	waitpid (pid, &status, 0);
+
+	for (i = 0; i < 5; i++)
+		count ();
+
+	printf ("Counter: %d\n", counter);
+	return 0;
+}
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define LONG_STRING_SIZE	10000
+
+int numbers [5] = { 1, 2, 3, 4, 5 };
+char *long_string, *boundary;
+
+void
+test_strings (void)
+{
+	printf ("Strings: %d - %s\n", (int) strlen (long_string), boundary);	// @MDB BREAKPOINT: strings
+}
+
+void
+test_array (void)
+{
+	int i;
+
+	for (i = 0; i < 5; i++)
+		numbers [i] *= 2;
+
+	printf ("Array: %d\n", numbers [4]);			// @MDB BREAKPOINT: array
+}
+
+int
+main (void)
+{
+	long page_size = sysconf (_SC_PAGESIZE);
+	char *pages;
+	int i;
+
+	setbuf (stdout, NULL);					// @MDB LINE: main
+
+	long_string = malloc (LONG_STRING_SIZE + 1);
+	for (i = 0; i < LONG_STRING_SIZE; i++)
+		long_string [i] = 'a' + i % 26;
+	long_string [LONG_STRING_SIZE] = 0;
+
+	/*
+	 * The terminating NUL is the last byte of a readable page; the next page
+	 * can't be read.
+	 */
+	pages = mmap (NULL, 2 * page_size, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	mprotect (pages + page_size, page_size, PROT_NONE);
+	boundary = pages + page_size - 12;
+	strcpy (boundary, "Hello World");
+
+	test_strings ();
+	test_array ();
+
+	free (long_string);
+	return 0;
+}
@@ -0,0 +1,23 @@
+#include <stdio.h>
+
+int counter = 0;
+
+void
+traced (int value)
+{
+	counter += value;			// @MDB LINE: traced
+}
+
+int
+main (void)
+{
+	int i;
+
+	setbuf (stdout, NULL);			// @MDB LINE: main
+
+	for (i = 0; i < 5; i++)
+		traced (i);
+
+	printf ("Counter: %d\n", counter);	// @MDB BREAKPOINT: done
+	return 0;
+}
@@ -0,0 +1,23 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int
+main (void)
+{
+	char *buffer, *other;
+
+	setbuf (stdout, NULL);			// @MDB LINE: main
+
+	buffer = malloc (128);
+	memset (buffer, 0, 128);
+	other = buffer + 64;
+
+	other [0] = 'x';			// @MDB BREAKPOINT: watch
+	buffer [40] = 'y';
+	other [1] = 'z';			// @MDB LINE: write
+
+	printf ("Buffer: %c %c%c\n", buffer [40], other [0], other [1]);	// @MDB BREAKPOINT: done
+	free (buffer);
+	return 0;
+}
@@ -0,0 +1,53 @@
+using System;
+using NUnit.Framework;
+
+using Mono.Debugger;
+using Mono.Debugger.Languages;
+using Mono.Debugger.Frontend;
+using Mono.Debugger.Test.Framework;
+
+namespace Mono.Debugger.Tests
+{
+	[DebuggerTestFixture]
+	public class TestObjectGraph : DebuggerTestFixture
+	{
+		public TestObjectGraph ()
+			: base ("TestObjectGraph")
+		{ }
+
+		[Test]
+		[Category("ManagedTypes")]
+		public void Main ()
+		{
+			Process process = Start ();
+			Assert.IsTrue (process.IsManaged);
+			Assert.IsTrue (process.MainThread.IsStopped);
+			Thread thread = process.MainThread;
+
+			AssertStopped (thread, "main", "X.Main()");
+			AssertExecute ("continue");
+
+			AssertHitBreakpoint (thread, "graph", "X.Main()");
+
+			AssertPrint (thread, "x.List.Value", "(int) 1");
+			AssertPrint (thread, "x.List.Next.Value", "(int) 2");
+			AssertPrint (thread, "x.List.Next.Next", "(Node) { Value = 3, Next = null }");
+			AssertPrint (thread, "x.Values", "(int[]) [ 0, 0, 0 ]");
+
+			//
+			// The invocation modifies the objects we just printed; we must
+			// not see any of the old values.
+			//
+			AssertPrint (thread, "x.Increment ()", "(int) 9");
+
+			AssertPrint (thread, "x.List.Value", "(int) 2");
+			AssertPrint (thread, "x.List.Next.Value", "(int) 3");
+			AssertPrint (thread, "x.List.Next.Next", "(Node) { Value = 4, Next = null }");
+			AssertPrint (thread, "x.Values", "(int[]) [ 2, 3, 4 ]");
+
+			AssertExecute ("continue");
+			AssertTargetOutput ("Sum: 12");
+			AssertTargetExited (thread.Process);
+		}
+	}
+}
@@ -0,0 +1,64 @@
+using System;
+using NUnit.Framework;
+
+using Mono.Debugger;
+using Mono.Debugger.Languages;
+using Mono.Debugger.Frontend;
+using Mono.Debugger.Test.Framework;
+
+namespace Mono.Debugger.Tests
+{
+	[DebuggerTestFixture]
+	public class TestTracepoint : DebuggerTestFixture
+	{
+		public TestTracepoint ()
+			: base ("TestTracepoint")
+		{ }
+
+		[Test]
+		[Category("ManagedTypes")]
+		public void Main ()
+		{
+			Process process = Start ();
+			Assert.IsTrue (process.IsManaged);
+			Assert.IsTrue (process.MainThread.IsStopped);
+			Thread thread = process.MainThread;
+
+			AssertStopped (thread, "main", "X.Main()");
+
+			//
+			// Managed tracepoints continue through their trampoline.
+			//
+			int tracepoint = (int) AssertExecute (String.Format (
+				"trace {0}", GetLine ("traced")));
+
+			TraceStatus status = (TraceStatus) AssertExecute ("tstatus");
+			Assert.AreEqual (0, status.Frames);
+
+			AssertExecute ("continue");
+			AssertTargetOutput ("Counter: 10");
+			AssertHitBreakpoint (thread, "done", "X.Main()");
+
+			status = (TraceStatus) AssertExecute ("tstatus");
+			Assert.AreEqual (5, status.Frames);
+			Assert.AreEqual (0, status.Dropped);
+
+			TraceFrame[] frames = (TraceFrame[]) AssertExecute ("tdump");
+			Assert.AreEqual (5, frames.Length);
+
+			for (int i = 0; i < frames.Length; i++) {
+				Assert.AreEqual (tracepoint, frames [i].Tracepoint);
+				Assert.AreEqual (thread.PID, frames [i].ThreadLWP);
+				Assert.IsNotNull (frames [i].Registers);
+				Assert.AreEqual (frames [i].Registers.Length,
+						 frames [i].RegisterNames.Length);
+				foreach (string name in frames [i].RegisterNames)
+					Assert.IsNotNull (name);
+				Assert.AreEqual (0, frames [i].Memory.Length);
+			}
+
+			AssertExecute ("continue");
+			AssertTargetExited (thread.Process);
+		}
+	}
+}
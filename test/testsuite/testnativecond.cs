@@ -0,0 +1,75 @@
+using System;
+using NUnit.Framework;
+
+using Mono.Debugger;
+using Mono.Debugger.Languages;
+using Mono.Debugger.Frontend;
+using Mono.Debugger.Test.Framework;
+
+namespace Mono.Debugger.Tests
+{
+	[DebuggerTestFixture]
+	public class testnativecond : DebuggerTestFixture
+	{
+		public testnativecond ()
+			: base ("testnativecond", "testnativecond.c")
+		{ }
+
+		[Test]
+		[Category("Native")]
+		public void Main ()
+		{
+			Process process = Start ();
+			Assert.IsTrue (process.MainThread.IsStopped);
+
+			Thread thread = process.MainThread;
+
+			AssertStopped (thread, "main", "main");
+
+			TargetAddress counter = process.LookupSymbol ("counter");
+			Assert.IsFalse (counter.IsNull, "Can't find `counter'.");
+
+			//
+			// The condition is only true on the third and the seventh hit.
+			//
+			int bpt = (int) AssertExecute (String.Format (
+				"break {0}:{1} if mem4[0x{2:x}] == 2 || mem4[0x{2:x}] == 6",
+				FileName, GetLine ("count"), counter.Address));
+
+			AssertExecute ("continue");
+			AssertHitBreakpoint (thread, bpt, "count", GetLine ("count"));
+			AssertPrint (thread, "counter", "(int) 2");
+
+			AssertExecute ("continue");
+			AssertHitBreakpoint (thread, bpt, "count", GetLine ("count"));
+			AssertPrint (thread, "counter", "(int) 6");
+
+			AssertExecute ("delete " + bpt);
+
+			//
+			// `ignore' skips the next hit; the server still counts it.
+			//
+			bpt = AssertBreakpoint (String.Format ("{0}:{1}", FileName, GetLine ("count")));
+			Breakpoint breakpoint = (Breakpoint) Interpreter.GetEvent (bpt);
+
+			AssertExecute ("continue");
+			AssertHitBreakpoint (thread, bpt, "count", GetLine ("count"));
+			AssertPrint (thread, "counter", "(int) 7");
+
+			AssertExecute ("ignore " + bpt + " 1");
+			Assert.AreEqual (1, process.GetIgnoreCount (breakpoint));
+
+			AssertExecute ("continue");
+			AssertHitBreakpoint (thread, bpt, "count", GetLine ("count"));
+			AssertPrint (thread, "counter", "(int) 9");
+			Assert.AreEqual (3, process.GetHitCount (breakpoint));
+			Assert.AreEqual (0, process.GetIgnoreCount (breakpoint));
+
+			AssertExecute ("delete " + bpt);
+
+			AssertExecute ("continue");
+			AssertTargetOutput ("Counter: 10");
+			AssertTargetExited (thread.Process);
+		}
+	}
+}
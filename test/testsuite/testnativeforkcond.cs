@@ -0,0 +1,99 @@
+using System;
+using NUnit.Framework;
+
+using Mono.Debugger;
+using Mono.Debugger.Languages;
+using Mono.Debugger.Frontend;
+using Mono.Debugger.Test.Framework;
+
+namespace Mono.Debugger.Tests
+{
+	[DebuggerTestFixture]
+	public class testnativeforkcond : DebuggerTestFixture
+	{
+		public testnativeforkcond ()
+			: base ("testnativeforkcond", "testnativeforkcond.c")
+		{
+			Config.ThreadingModel = ThreadingModel.Single;
+		}
+
+		public override void SetUp ()
+		{
+			base.SetUp ();
+			Config.FollowFork = true;
+			Config.ThreadingModel = ThreadingModel.Single;
+		}
+
+		//
+		// The parent hits a conditional breakpoint after the child shared its
+		// breakpoints with it.
+		//
+		[Test]
+		[Category("Native")]
+		[Category("Fork")]
+		public void Main ()
+		{
+			Process process = Start ();
+			Assert.IsFalse (process.IsManaged);
+			Assert.IsTrue (process.MainThread.IsStopped);
+			Thread thread = process.MainThread;
+
+			AssertStopped (thread, "main", "main");
+
+			TargetAddress counter = process.LookupSymbol ("counter");
+			Assert.IsFalse (counter.IsNull, "Can't find `counter'.");
+
+			int bpt = (int) AssertExecute (String.Format (
+				"break -local {0}:{1} if mem4[0x{2:x}] == 3",
+				FileName, GetLine ("count"), counter.Address));
+
+			AssertExecute ("continue");
+
+			Thread child = AssertProcessCreated ();
+
+			bool child_exited = false;
+			bool thread_exited = false;
+			bool exited = false;
+			bool stopped = false;
+
+			while (!exited || !child_exited || !thread_exited || !stopped) {
+				DebuggerEvent e = AssertEvent ();
+
+				if (e.Type == DebuggerEventType.ProcessExited) {
+					if ((Process) e.Data == child.Process) {
+						child_exited = true;
+						continue;
+					}
+				} else if (e.Type == DebuggerEventType.ThreadExited) {
+					if ((Thread) e.Data == child) {
+						thread_exited = true;
+						continue;
+					}
+				} else if (e.Type == DebuggerEventType.TargetEvent) {
+					Thread e_thread = (Thread) e.Data;
+					TargetEventArgs args = (TargetEventArgs) e.Data2;
+
+					if ((e_thread == thread) &&
+					    (args.Type == TargetEventType.TargetHitBreakpoint) &&
+					    ((int) args.Data == bpt)) {
+						stopped = true;
+						continue;
+					} else if ((e_thread == child) &&
+						   (args.Type == TargetEventType.TargetExited)) {
+						exited = true;
+						continue;
+					}
+				}
+
+				Assert.Fail ("Received unexpected event {0}", e);
+			}
+
+			AssertFrame (thread, "count", GetLine ("count"));
+			AssertPrint (thread, "counter", "(int) 3");
+
+			AssertExecute ("continue");
+			AssertTargetOutput ("Counter: 5");
+			AssertTargetExited (thread.Process);
+		}
+	}
+}
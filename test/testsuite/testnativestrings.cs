@@ -0,0 +1,77 @@
+using System;
+using System.Text;
+using NUnit.Framework;
+
+using Mono.Debugger;
+using Mono.Debugger.Languages;
+using Mono.Debugger.Frontend;
+using Mono.Debugger.Test.Framework;
+
+namespace Mono.Debugger.Tests
+{
+	[DebuggerTestFixture]
+	public class testnativestrings : DebuggerTestFixture
+	{
+		public testnativestrings ()
+			: base ("testnativestrings", "testnativestrings.c")
+		{ }
+
+		[Test]
+		[Category("Native")]
+		[Category("NativeTypes")]
+		public void Main ()
+		{
+			Process process = Start ();
+			Assert.IsTrue (process.MainThread.IsStopped);
+
+			Thread thread = process.MainThread;
+
+			AssertStopped (thread, "main", "main");
+
+			AssertPrint (thread, "numbers", "(int []) [ 1, 2, 3, 4, 5 ]");
+
+			AssertExecute ("continue");
+			AssertHitBreakpoint (thread, "strings", "test_strings");
+
+			//
+			// Spans several pages.
+			//
+			StringBuilder sb = new StringBuilder ();
+			for (int i = 0; i < 10000; i++)
+				sb.Append ((char) ('a' + i % 26));
+			string expected = sb.ToString ();
+
+			TargetAddress long_string = GetAddress (thread, "long_string");
+			Assert.AreEqual (expected, thread.ReadString (long_string));
+			Assert.AreEqual (expected.Substring (0, 5000),
+					 thread.ReadString (long_string, 5000));
+
+			//
+			// Ends right before an unreadable page.
+			//
+			AssertPrint (thread, "boundary", "(char *) \"Hello World\"");
+			TargetAddress boundary = GetAddress (thread, "boundary");
+			Assert.AreEqual ("Hello World", thread.ReadString (boundary));
+
+			AssertExecute ("continue");
+			AssertTargetOutput ("Strings: 10000 - Hello World");
+			AssertHitBreakpoint (thread, "array", "test_array");
+
+			//
+			// We printed the array before the target modified it.
+			//
+			AssertPrint (thread, "numbers", "(int []) [ 2, 4, 6, 8, 10 ]");
+
+			AssertExecute ("continue");
+			AssertTargetOutput ("Array: 10");
+			AssertTargetExited (thread.Process);
+		}
+
+		TargetAddress GetAddress (Thread thread, string name)
+		{
+			TargetAddress symbol = thread.Process.LookupSymbol (name);
+			Assert.IsFalse (symbol.IsNull, "Can't find `{0}'.", name);
+			return thread.ReadAddress (symbol);
+		}
+	}
+}
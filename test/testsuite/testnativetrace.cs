@@ -0,0 +1,78 @@
+using System;
+using NUnit.Framework;
+
+using Mono.Debugger;
+using Mono.Debugger.Languages;
+using Mono.Debugger.Frontend;
+using Mono.Debugger.Test.Framework;
+
+namespace Mono.Debugger.Tests
+{
+	[DebuggerTestFixture]
+	public class testnativetrace : DebuggerTestFixture
+	{
+		public testnativetrace ()
+			: base ("testnativetrace", "testnativetrace.c")
+		{ }
+
+		[Test]
+		[Category("Native")]
+		public void Main ()
+		{
+			Process process = Start ();
+			Assert.IsTrue (process.MainThread.IsStopped);
+
+			Thread thread = process.MainThread;
+
+			AssertStopped (thread, "main", "main");
+
+			TargetAddress counter = process.LookupSymbol ("counter");
+			Assert.IsFalse (counter.IsNull, "Can't find `counter'.");
+
+			int tracepoint = (int) AssertExecute (String.Format (
+				"trace -memory 0x{0:x}:4 {1}", counter.Address, GetLine ("traced")));
+
+			TraceStatus status = (TraceStatus) AssertExecute ("tstatus");
+			Assert.AreEqual (0, status.Frames);
+
+			AssertExecute ("continue");
+			AssertTargetOutput ("Counter: 10");
+			AssertHitBreakpoint (thread, "done", "main");
+
+			status = (TraceStatus) AssertExecute ("tstatus");
+			Assert.AreEqual (5, status.Frames);
+			Assert.AreEqual (0, status.Dropped);
+			Assert.IsTrue (status.Used > 0);
+
+			//
+			// Each frame has the registers and `counter' from before the
+			// addition.
+			//
+			TraceFrame[] frames = (TraceFrame[]) AssertExecute ("tdump");
+			Assert.AreEqual (5, frames.Length);
+
+			int expected = 0;
+			for (int i = 0; i < frames.Length; i++) {
+				Assert.AreEqual (tracepoint, frames [i].Tracepoint);
+				Assert.AreEqual (thread.PID, frames [i].ThreadLWP);
+				Assert.IsNotNull (frames [i].Registers);
+				Assert.AreEqual (1, frames [i].Memory.Length);
+				Assert.AreEqual (counter.Address, frames [i].Memory [0].Address.Address);
+				Assert.AreEqual (expected, BitConverter.ToInt32 (frames [i].Memory [0].Data, 0));
+				expected += i;
+			}
+
+			//
+			// `tdump' removes the frames from the buffer.
+			//
+			frames = (TraceFrame[]) AssertExecute ("tdump");
+			Assert.AreEqual (0, frames.Length);
+
+			status = (TraceStatus) AssertExecute ("tstatus");
+			Assert.AreEqual (0, status.Frames);
+
+			AssertExecute ("continue");
+			AssertTargetExited (thread.Process);
+		}
+	}
+}
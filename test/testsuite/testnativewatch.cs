@@ -0,0 +1,52 @@
+using System;
+using NUnit.Framework;
+
+using Mono.Debugger;
+using Mono.Debugger.Languages;
+using Mono.Debugger.Frontend;
+using Mono.Debugger.Test.Framework;
+
+namespace Mono.Debugger.Tests
+{
+	[DebuggerTestFixture]
+	public class testnativewatch : DebuggerTestFixture
+	{
+		public testnativewatch ()
+			: base ("testnativewatch", "testnativewatch.c")
+		{ }
+
+		[Test]
+		[Category("Native")]
+		public void Main ()
+		{
+			Process process = Start ();
+			Assert.IsTrue (process.MainThread.IsStopped);
+
+			Thread thread = process.MainThread;
+
+			AssertStopped (thread, "main", "main");
+
+			AssertExecute ("continue");
+			AssertHitBreakpoint (thread, "watch", "main");
+
+			//
+			// 64 bytes don't fit into the debug registers, so this is a
+			// page-protection watchpoint.  The write to `other [0]' is on the
+			// same page, but outside the watched range.
+			//
+			int watch = (int) AssertExecute ("watch -size 64 *buffer");
+
+			AssertExecute ("continue");
+			AssertHitBreakpoint (thread, watch, "main", GetLine ("write"));
+
+			AssertExecute ("continue");
+			AssertHitBreakpoint (thread, "done", "main");
+
+			AssertExecute ("delete " + watch);
+
+			AssertExecute ("continue");
+			AssertTargetOutput ("Buffer: y xz");
+			AssertTargetExited (thread.Process);
+		}
+	}
+}